@@ -12,6 +12,8 @@ enum ModbusFunctions{
     ModbusWriteSingleRegister = 0x06,
     ModbusWriteMultipleCoils = 0x0F,
     ModbusWriteMultipleRegisters = 0x10,
+    ModbusMaskWriteRegister = 0x16,
+    ModbusReadWriteMultipleRegisters = 0x17,
     ModbusCoilStatus = ModbusReadCoils,
     ModbusInputStatus = ModbusReadDescreteInputs,
     ModbusHoldingRegisters = ModbusReadHoldingRegisters,
@@ -30,8 +32,8 @@ enum ModbusErrorCode{
     ModbusErrorCode_Slave_Device_Busy = 0x06,
     ModbusErrorCode_Negative_Acknowledgment = 0x07,
     ModbusErrorCode_Memory_Parity_Error = 0x08,
-    ModbusErrorCode_Gateway_Path_Unavailable = 0x10,
-    ModbusErrorCode_Gateway_Target_Device_Failed_To_Respond = 0x11,
+    ModbusErrorCode_Gateway_Path_Unavailable = 0x0A,
+    ModbusErrorCode_Gateway_Target_Device_Failed_To_Respond = 0x0B,
 };
 
 struct ModbusFrameInfo{
@@ -44,6 +46,10 @@ struct ModbusFrameInfo{
     //register or coil address
     int reg_addr{};
     int quantity{};
+    //read/write multiple registers: the block written, reg_addr and quantity are the block read
+    int write_addr{};
+    int write_quantity{};
+    //mask write register keeps the and mask in reg_values[0] and the or mask in reg_values[1]
     unsigned short reg_values[2000]{0};
 };
 
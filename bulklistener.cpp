@@ -0,0 +1,64 @@
+#include "bulklistener.h"
+#include "mytcpsocket.h"
+
+BulkListener::BulkListener(int protocol, bool is_master, QObject *parent)
+    : QObject{parent}, m_protocol(protocol), m_is_master(is_master), m_connection_thread(nullptr)
+{
+
+}
+
+BulkListener::~BulkListener()
+{
+    qDeleteAll(m_listeners);
+}
+
+void BulkListener::setConnectionThread(QThread *thread)
+{
+    m_connection_thread = thread;
+}
+
+int BulkListener::bind(const QHostAddress &first_address, int address_count, quint16 first_port, int port_count)
+{
+    quint32 ipv4 = first_address.toIPv4Address();
+    for(int i = 0; i < address_count; ++i)
+    {
+        QHostAddress address(ipv4 + i);
+        for(int j = 0; j < port_count && first_port + j <= 65535; ++j)
+        {
+            MyTcpSocket *listener = new MyTcpSocket(read_buffer_size);
+            connect(listener, &MyTcpSocket::socketErrorOccurred, this, &BulkListener::socketErrorOccurred);
+            listener->setConnectionThread(m_connection_thread);
+            //one accept in flight per endpoint is enough, hundreds of them share one io thread
+            if(!listener->bind(address, first_port + j, boost::asio::socket_base::max_listen_connections, 1))
+            {
+                delete listener;
+                continue;
+            }
+            connect(listener, &MyTcpSocket::newConnectionIncoming, this, &BulkListener::listenerConnectionIncoming);
+            m_listeners.append(listener);
+            m_endpoint_map[listener] = QString("%1:%2").arg(address.toString()).arg(first_port + j);
+        }
+    }
+    return m_listeners.size();
+}
+
+int BulkListener::protocol() const
+{
+    return m_protocol;
+}
+
+bool BulkListener::isMaster() const
+{
+    return m_is_master;
+}
+
+int BulkListener::endpointCount() const
+{
+    return m_listeners.size();
+}
+
+void BulkListener::listenerConnectionIncoming(MyTcpSocket *new_connection)
+{
+    MyTcpSocket *listener = qobject_cast<MyTcpSocket*>(sender());
+    emit newConnectionIncoming(new_connection, m_endpoint_map.value(listener));
+}
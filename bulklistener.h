@@ -0,0 +1,51 @@
+#ifndef BULKLISTENER_H
+#define BULKLISTENER_H
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QHostAddress>
+
+class MyTcpSocket;
+class QThread;
+
+/*
+ * A group of modbus-tcp listeners opened from one configuration, one per address and port.
+ * They all run on the shared asio thread and accept into small pooled read buffers,
+ * every accepted connection is reported with the endpoint it came in on.
+ */
+
+class BulkListener : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BulkListener(int protocol, bool is_master, QObject *parent = nullptr);
+    ~BulkListener();
+    //the thread accepted connections are handed over on, set before bind
+    void setConnectionThread(QThread *thread);
+    //binds every address/port combination, returns how many endpoints are listening
+    int bind(const QHostAddress &first_address, int address_count, quint16 first_port, int port_count);
+    int protocol() const;
+    bool isMaster() const;
+    int endpointCount() const;
+
+signals:
+    void newConnectionIncoming(MyTcpSocket *new_connection, QString endpoint);
+    void socketErrorOccurred(const std::error_code &ec);
+
+private slots:
+    void listenerConnectionIncoming(MyTcpSocket *new_connection);
+
+private:
+    //a modbus adu is at most 260 bytes, a listener farm does not need megabyte read buffers
+    static const quint64 read_buffer_size = 4 * 1024;
+
+    QList<MyTcpSocket*> m_listeners;
+    QHash<MyTcpSocket*, QString> m_endpoint_map;
+    int m_protocol;
+    bool m_is_master;
+    QThread *m_connection_thread;
+};
+
+#endif // BULKLISTENER_H
@@ -0,0 +1,63 @@
+#include "busbudgetdialog.h"
+#include "ui_busbudgetdialog.h"
+
+BusBudgetDialog::BusBudgetDialog(const ModbusBusBudget &budget, const QList<ModbusRegReadDefinitions> &reg_defs, QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::BusBudgetDialog), m_budget(budget), m_reg_defs(reg_defs)
+{
+    ui->setupUi(this);
+    ui->table_budget->setColumnCount(6);
+    ui->table_budget->setHorizontalHeaderLabels({tr("ID"), tr("Function"), tr("Address"), tr("Quantity"), tr("Scan Rate(ms)"), tr("Wire Time(ms)")});
+    ui->table_budget->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    updateTable();
+}
+
+BusBudgetDialog::~BusBudgetDialog()
+{
+    delete ui;
+}
+
+void BusBudgetDialog::on_button_fit_clicked()
+{
+    QList<quint32> scan_rates = m_budget.fittedScanRates(m_reg_defs, ui->box_target->value() / 100.0);
+    for(int i = 0; i < m_reg_defs.size(); ++i)
+    {
+        m_reg_defs[i].scan_rate = scan_rates[i];
+    }
+    updateTable();
+}
+
+void BusBudgetDialog::on_button_ok_clicked()
+{
+    QList<quint32> scan_rates;
+    for(const auto &x : m_reg_defs)
+    {
+        scan_rates.append(x.scan_rate);
+    }
+    emit scanRatesChanged(scan_rates);
+    deleteLater();
+}
+
+void BusBudgetDialog::on_button_cancel_clicked()
+{
+    deleteLater();
+}
+
+void BusBudgetDialog::updateTable()
+{
+    ui->table_budget->setRowCount(m_reg_defs.size());
+    for(int i = 0; i < m_reg_defs.size(); ++i)
+    {
+        const ModbusRegReadDefinitions &x = m_reg_defs[i];
+        ui->table_budget->setItem(i, 0, new QTableWidgetItem(QString::number(x.id)));
+        ui->table_budget->setItem(i, 1, new QTableWidgetItem(QString("%1").arg(x.function, 2, 10, QChar('0'))));
+        ui->table_budget->setItem(i, 2, new QTableWidgetItem(QString::number(x.reg_addr)));
+        ui->table_budget->setItem(i, 3, new QTableWidgetItem(QString::number(x.quantity)));
+        ui->table_budget->setItem(i, 4, new QTableWidgetItem(QString::number(x.scan_rate)));
+        ui->table_budget->setItem(i, 5, new QTableWidgetItem(QString::number(m_budget.transactionTime(x), 'f', 2)));
+    }
+    double load = m_budget.utilisation(m_reg_defs) * 100.0;
+    ui->label_utilisation->setText(tr("Bus Utilisation : %1 %").arg(load, 0, 'f', 1));
+    //past the target the polls fall behind their scan rates
+    ui->label_utilisation->setStyleSheet(load > ui->box_target->value() ? "color: red;" : "");
+}
@@ -0,0 +1,40 @@
+#ifndef BUSBUDGETDIALOG_H
+#define BUSBUDGETDIALOG_H
+
+#include <QDialog>
+#include "modbusbusbudget.h"
+#include "addregdialog.h"
+
+namespace Ui {
+class BusBudgetDialog;
+}
+
+class BusBudgetDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit BusBudgetDialog(const ModbusBusBudget &budget, const QList<ModbusRegReadDefinitions> &reg_defs, QWidget *parent = nullptr);
+    ~BusBudgetDialog();
+
+signals:
+    //in the order of the definitions the dialog was given
+    void scanRatesChanged(const QList<quint32> &scan_rates);
+
+private slots:
+    void on_button_fit_clicked();
+
+    void on_button_ok_clicked();
+
+    void on_button_cancel_clicked();
+
+private:
+    void updateTable();
+
+private:
+    Ui::BusBudgetDialog *ui;
+    ModbusBusBudget m_budget;
+    QList<ModbusRegReadDefinitions> m_reg_defs;
+};
+
+#endif // BUSBUDGETDIALOG_H
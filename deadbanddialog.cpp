@@ -0,0 +1,27 @@
+#include "deadbanddialog.h"
+#include "ui_deadbanddialog.h"
+
+DeadbandDialog::DeadbandDialog(double absolute, double percent, QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::DeadbandDialog)
+{
+    ui->setupUi(this);
+    ui->box_absolute->setValue(absolute);
+    ui->box_percent->setValue(percent);
+}
+
+DeadbandDialog::~DeadbandDialog()
+{
+    delete ui;
+}
+
+void DeadbandDialog::on_button_ok_clicked()
+{
+    emit deadbandSet(ui->box_absolute->value(), ui->box_percent->value());
+    deleteLater();
+}
+
+void DeadbandDialog::on_button_cancel_clicked()
+{
+    deleteLater();
+}
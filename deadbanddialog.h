@@ -0,0 +1,30 @@
+#ifndef DEADBANDDIALOG_H
+#define DEADBANDDIALOG_H
+
+#include <QDialog>
+
+namespace Ui {
+class DeadbandDialog;
+}
+
+class DeadbandDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DeadbandDialog(double absolute, double percent, QWidget *parent = nullptr);
+    ~DeadbandDialog();
+
+signals:
+    void deadbandSet(double absolute, double percent);
+
+private slots:
+    void on_button_ok_clicked();
+
+    void on_button_cancel_clicked();
+
+private:
+    Ui::DeadbandDialog *ui;
+};
+
+#endif // DEADBANDDIALOG_H
@@ -0,0 +1,46 @@
+#include "faultinjectiondialog.h"
+#include "ui_faultinjectiondialog.h"
+
+FaultInjectionDialog::FaultInjectionDialog(const ModbusFaultSettings &settings, QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::FaultInjectionDialog)
+{
+    ui->setupUi(this);
+    //in the order of ModbusFaultInjector::DelayDistribution
+    ui->box_distribution->addItems({tr("Fixed"), tr("Uniform"), tr("Normal"), tr("Exponential")});
+    ui->box_distribution->setCurrentIndex(settings.distribution);
+    ui->box_delay->setValue(settings.delay_ms);
+    ui->box_jitter->setValue(settings.jitter_ms);
+    ui->box_busy->setValue(settings.busy_rate);
+    ui->box_gateway->setValue(settings.gateway_rate);
+    ui->box_drop->setValue(settings.drop_rate);
+    ui->box_corrupt->setValue(settings.corrupt_rate);
+    ui->box_fragment->setValue(settings.fragment_rate);
+    ui->box_fragment_gap->setValue(settings.fragment_gap_ms);
+}
+
+FaultInjectionDialog::~FaultInjectionDialog()
+{
+    delete ui;
+}
+
+void FaultInjectionDialog::on_button_ok_clicked()
+{
+    ModbusFaultSettings settings;
+    settings.distribution = ui->box_distribution->currentIndex();
+    settings.delay_ms = ui->box_delay->value();
+    settings.jitter_ms = ui->box_jitter->value();
+    settings.busy_rate = ui->box_busy->value();
+    settings.gateway_rate = ui->box_gateway->value();
+    settings.drop_rate = ui->box_drop->value();
+    settings.corrupt_rate = ui->box_corrupt->value();
+    settings.fragment_rate = ui->box_fragment->value();
+    settings.fragment_gap_ms = ui->box_fragment_gap->value();
+    emit faultSettingsChanged(settings);
+    deleteLater();
+}
+
+void FaultInjectionDialog::on_button_cancel_clicked()
+{
+    deleteLater();
+}
@@ -0,0 +1,31 @@
+#ifndef FAULTINJECTIONDIALOG_H
+#define FAULTINJECTIONDIALOG_H
+
+#include <QDialog>
+#include "modbusfaultinjector.h"
+
+namespace Ui {
+class FaultInjectionDialog;
+}
+
+class FaultInjectionDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FaultInjectionDialog(const ModbusFaultSettings &settings, QWidget *parent = nullptr);
+    ~FaultInjectionDialog();
+
+signals:
+    void faultSettingsChanged(const ModbusFaultSettings &settings);
+
+private slots:
+    void on_button_ok_clicked();
+
+    void on_button_cancel_clicked();
+
+private:
+    Ui::FaultInjectionDialog *ui;
+};
+
+#endif // FAULTINJECTIONDIALOG_H
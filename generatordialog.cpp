@@ -0,0 +1,46 @@
+#include "generatordialog.h"
+#include "ui_generatordialog.h"
+
+GeneratorDialog::GeneratorDialog(const ModbusGenerator &generator, bool enabled, quint16 first_addr, QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::GeneratorDialog), m_first_addr(first_addr)
+{
+    ui->setupUi(this);
+    //the first entry switches the generator off, the others follow ModbusValueGenerator::GeneratorType
+    ui->box_type->addItems({tr("Off"), tr("Counter"), tr("Ramp"), tr("Sine"), tr("Square"), tr("Random"), tr("Derived")});
+    ui->box_type->setCurrentIndex(enabled ? generator.type + 1 : 0);
+    ui->box_base->setValue(generator.base);
+    ui->box_amplitude->setValue(generator.amplitude);
+    ui->box_period->setValue(generator.period_ms);
+    ui->box_source->setValue(generator.source + first_addr);
+    on_box_type_currentIndexChanged(ui->box_type->currentIndex());
+}
+
+GeneratorDialog::~GeneratorDialog()
+{
+    delete ui;
+}
+
+void GeneratorDialog::on_box_type_currentIndexChanged(int index)
+{
+    ui->box_source->setEnabled(index == ModbusValueGenerator::Generator_Derived + 1);
+    ui->box_period->setEnabled(index > 0 && index != ModbusValueGenerator::Generator_Random + 1 && index != ModbusValueGenerator::Generator_Derived + 1);
+}
+
+void GeneratorDialog::on_button_ok_clicked()
+{
+    ModbusGenerator generator;
+    int index = ui->box_type->currentIndex();
+    generator.type = qMax(0, index - 1);
+    generator.base = ui->box_base->value();
+    generator.amplitude = ui->box_amplitude->value();
+    generator.period_ms = ui->box_period->value();
+    generator.source = quint16(qMax(0, ui->box_source->value() - m_first_addr));
+    emit generatorSet(generator, index > 0);
+    deleteLater();
+}
+
+void GeneratorDialog::on_button_cancel_clicked()
+{
+    deleteLater();
+}
@@ -0,0 +1,36 @@
+#ifndef GENERATORDIALOG_H
+#define GENERATORDIALOG_H
+
+#include <QDialog>
+#include "modbusvaluegenerator.h"
+
+namespace Ui {
+class GeneratorDialog;
+}
+
+class GeneratorDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    //source is shown as a register address, first_addr is the address of the block's first register
+    explicit GeneratorDialog(const ModbusGenerator &generator, bool enabled, quint16 first_addr, QWidget *parent = nullptr);
+    ~GeneratorDialog();
+
+signals:
+    //enabled is false when the cells go back to plain values
+    void generatorSet(const ModbusGenerator &generator, bool enabled);
+
+private slots:
+    void on_box_type_currentIndexChanged(int index);
+
+    void on_button_ok_clicked();
+
+    void on_button_cancel_clicked();
+
+private:
+    Ui::GeneratorDialog *ui;
+    quint16 m_first_addr;
+};
+
+#endif // GENERATORDIALOG_H
@@ -0,0 +1,136 @@
+#include "mysharedmemorypipe.h"
+#include "mytcpsocket.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+/*
+ * Round trips of a Modbus TCP read request between two ends of a local route, once over a
+ * shared memory pipe and once over a loopback TCP connection. The far end echoes every frame,
+ * the near end sends the next one as soon as the echo is complete.
+ */
+
+namespace {
+const int round_trips = 10000;
+const quint16 tcp_port = 15020;
+const QByteArray request = QByteArray::fromHex("000100000006010300000010");
+
+void printResult(const QString &name, QVector<qint64> &samples)
+{
+    QTextStream out(stdout);
+    if(samples.isEmpty())
+    {
+        out << name << ": no round trips" << Qt::endl;
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    qint64 total = 0;
+    for(auto x : samples)
+    {
+        total += x;
+    }
+    out << QString("%1: %2 round trips, mean %3 us, p99 %4 us")
+               .arg(name).arg(samples.size())
+               .arg(total / samples.size() / 1000.0, 0, 'f', 1)
+               .arg(samples[samples.size() * 99 / 100] / 1000.0, 0, 'f', 1) << Qt::endl;
+}
+
+//near sends, far echoes, done runs once every round trip is back
+void runRoundTrips(const QString &name, QIODevice *near_end, QIODevice *far_end, std::function<void()> done)
+{
+    QObject::connect(far_end, &QIODevice::readyRead, far_end, [far_end](){
+        far_end->write(far_end->readAll());
+    });
+    auto samples = std::make_shared<QVector<qint64> >();
+    auto received = std::make_shared<QByteArray>();
+    auto timer = std::make_shared<QElapsedTimer>();
+    samples->reserve(round_trips);
+    QObject::connect(near_end, &QIODevice::readyRead, near_end, [=](){
+        received->append(near_end->readAll());
+        while(received->size() >= request.size())
+        {
+            received->remove(0, request.size());
+            samples->append(timer->nsecsElapsed());
+            if(samples->size() == round_trips)
+            {
+                QObject::disconnect(near_end, &QIODevice::readyRead, nullptr, nullptr);
+                QObject::disconnect(far_end, &QIODevice::readyRead, nullptr, nullptr);
+                printResult(name, *samples);
+                done();
+                return;
+            }
+            timer->start();
+            near_end->write(request);
+        }
+    });
+    timer->start();
+    near_end->write(request);
+}
+
+void runTcp(std::function<void()> done)
+{
+    MyTcpSocket *server = new MyTcpSocket();
+    MyTcpSocket *client = new MyTcpSocket();
+    auto finish = [=](){
+        client->deleteLater();
+        server->deleteLater();
+        done();
+    };
+    if(!server->bind(QHostAddress::LocalHost, tcp_port))
+    {
+        QTextStream(stdout) << "tcp: cannot listen on port " << tcp_port << Qt::endl;
+        finish();
+        return;
+    }
+    QObject::connect(server, &MyTcpSocket::newConnectionIncoming, server, [=](MyTcpSocket *connection){
+        connection->setParent(server);
+        runRoundTrips("tcp loopback", client, connection, finish);
+    });
+    QObject::connect(client, &MyTcpSocket::connectFinished, client, [=](bool connected){
+        if(!connected)
+        {
+            QTextStream(stdout) << "tcp: cannot connect to port " << tcp_port << Qt::endl;
+            finish();
+        }
+    });
+    client->connectToHost("127.0.0.1", tcp_port, 1000);
+}
+
+void runSharedMemory(std::function<void()> done)
+{
+    MySharedMemoryPipe *creator = new MySharedMemoryPipe();
+    MySharedMemoryPipe *attacher = new MySharedMemoryPipe();
+    auto finish = [=](){
+        attacher->deleteLater();
+        creator->deleteLater();
+        done();
+    };
+    QString key = QString("LocalRouteBench_%1").arg(QCoreApplication::applicationPid());
+    if(!creator->open(key, true) || !attacher->open(key, false))
+    {
+        QTextStream(stdout) << "shared memory: " << (creator->isOpen() ? attacher : creator)->errorString() << Qt::endl;
+        finish();
+        return;
+    }
+    runRoundTrips("shared memory", attacher, creator, finish);
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTimer::singleShot(0, &a, [](){
+        runSharedMemory([](){
+            runTcp([](){
+                QCoreApplication::quit();
+            });
+        });
+    });
+    return a.exec();
+}
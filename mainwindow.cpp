@@ -8,6 +8,7 @@
 #include <QHostAddress>
 #include <QMessageBox>
 #include "modbuswidget.h"
+#include "modbusgatewaywidget.h"
 #include "addregdialog.h"
 #include "mytcpsocket.h"
 
@@ -19,8 +20,12 @@ MainWindow::MainWindow(QWidget *parent)
     ui->setupUi(this);
     qRegisterMetaType<std::error_code>("std::error_code");
     qRegisterMetaType<ModbusRegReadDefinitions*>("ModbusRegReadDefinitions*");
+    qRegisterMetaType<ModbusEngineUpdates>("ModbusEngineUpdates");
     m_open_route_dialog = new OpenRouteDialog(this);
     connect(m_open_route_dialog, &OpenRouteDialog::createdRoute, this, &MainWindow::routeCreated);
+    connect(m_open_route_dialog, &OpenRouteDialog::createdPooledRoute, this, &MainWindow::pooledRouteCreated);
+    connect(m_open_route_dialog, &OpenRouteDialog::createdGatewayRoute, this, &MainWindow::gatewayRouteCreated);
+    connect(m_open_route_dialog, &OpenRouteDialog::createdEndpointRoute, this, &MainWindow::endpointRouteCreated);
     m_open_route_dialog->hide();
 }
 
@@ -48,3 +53,37 @@ void MainWindow::routeCreated(QIODevice *com, QString name, int protocol, bool i
     }
 }
 
+void MainWindow::pooledRouteCreated(QList<QIODevice*> coms, QString name, int protocol, int dispatch)
+{
+    ModbusWidget *modbus_widget = new ModbusWidget(true, coms.first(), protocol);
+    for(int i = 1; i < coms.size(); ++i)
+    {
+        modbus_widget->addChannel(coms[i]);
+    }
+    modbus_widget->setChannelDispatch(dispatch);
+    modbus_widget->setWindowTitle(name + QString(" - %1" ).arg(tr("Master")));
+    ui->mdi_area_modbus->addSubWindow(modbus_widget);
+    modbus_widget->show();
+}
+
+void MainWindow::gatewayRouteCreated(MyTcpSocket *server, QIODevice *com, QString name)
+{
+    ModbusGatewayWidget *gateway_widget = new ModbusGatewayWidget(server, com);
+    gateway_widget->setWindowTitle(name + QString(" - %1" ).arg(tr("Gateway")));
+    ui->mdi_area_modbus->addSubWindow(gateway_widget);
+    gateway_widget->show();
+}
+
+void MainWindow::endpointRouteCreated(QIODevice *com, QString endpoint, int protocol, bool is_master)
+{
+    QPointer<ModbusWidget> &modbus_widget = m_endpoint_widgets[endpoint];
+    if(modbus_widget)
+    {
+        modbus_widget->addChannel(com);
+        return;
+    }
+    modbus_widget = new ModbusWidget(is_master, com, protocol);
+    modbus_widget->setWindowTitle(endpoint + QString(" - %1" ).arg(is_master ? tr("Master") : tr("Slave")));
+    ui->mdi_area_modbus->addSubWindow(modbus_widget);
+    modbus_widget->show();
+}
@@ -5,8 +5,12 @@
 #include <QtSerialPort/QSerialPort>
 #include <QtSerialPort/QSerialPortInfo>
 #include <QList>
+#include <QMap>
+#include <QPointer>
 #include "openroutedialog.h"
 
+class ModbusWidget;
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
@@ -27,10 +31,15 @@ private slots:
     void on_actionOpen_Route_triggered();
 
     void routeCreated(QIODevice *com, QString name, int protocol, bool is_master);
+    void pooledRouteCreated(QList<QIODevice*> coms, QString name, int protocol, int dispatch);
+    void gatewayRouteCreated(MyTcpSocket *server, QIODevice *com, QString name);
+    void endpointRouteCreated(QIODevice *com, QString endpoint, int protocol, bool is_master);
 
 private:
     Ui::MainWindow *ui;
     OpenRouteDialog *m_open_route_dialog;
+    //one device model per bulk listener endpoint, later connections to it join the same widget
+    QMap<QString, QPointer<ModbusWidget> > m_endpoint_widgets;
 
 };
 #endif // MAINWINDOW_H
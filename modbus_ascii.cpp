@@ -15,7 +15,8 @@ QByteArray Modbus_ASCII::masterFrame2Pack(const ModbusFrameInfo &frame_info)
     ret.append(quint8(frame_info.reg_addr >> 8 & 0xFF));
     ret.append(quint8(frame_info.reg_addr & 0XFF));
     if(frame_info.function != ModbusWriteSingleCoil &&
-        frame_info.function != ModbusWriteSingleRegister)
+        frame_info.function != ModbusWriteSingleRegister &&
+        frame_info.function != ModbusMaskWriteRegister)
     {
         ret.append(quint8(frame_info.quantity >> 8 & 0xFF));
         ret.append(quint8(frame_info.quantity & 0xFF));
@@ -26,7 +27,15 @@ QByteArray Modbus_ASCII::masterFrame2Pack(const ModbusFrameInfo &frame_info)
         ret.append(quint8(frame_info.reg_values[0] >> 8 & 0xFF));
         ret.append(quint8(frame_info.reg_values[0] & 0xFF));
     }
-    if(frame_info.function == ModbusWriteMultipleCoils)
+    if(frame_info.function == ModbusMaskWriteRegister)
+    {
+        for(int i = 0;i < 2;++i)
+        {
+            ret.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            ret.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
+    else if(frame_info.function == ModbusWriteMultipleCoils)
     {
         quint8 byte_num = quint8(pageConvert(frame_info.quantity, 8));
         ret.append(byte_num);
@@ -45,6 +54,19 @@ QByteArray Modbus_ASCII::masterFrame2Pack(const ModbusFrameInfo &frame_info)
             ret.append(quint8(frame_info.reg_values[i] & 0xFF));
         }
     }
+    else if(frame_info.function == ModbusReadWriteMultipleRegisters)
+    {
+        ret.append(quint8(frame_info.write_addr >> 8 & 0xFF));
+        ret.append(quint8(frame_info.write_addr & 0xFF));
+        ret.append(quint8(frame_info.write_quantity >> 8 & 0xFF));
+        ret.append(quint8(frame_info.write_quantity & 0xFF));
+        ret.append(quint8(frame_info.write_quantity * 2));
+        for(int i = 0;i < frame_info.write_quantity;++i)
+        {
+            ret.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            ret.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
     ret.append(LRC(ret,ret.size()));
     return ret.toHex().toUpper().prepend(pack_start_character).append(pack_terminator);
 }
@@ -66,7 +88,8 @@ ModbusFrameInfo Modbus_ASCII::masterPack2Frame(const QByteArray &pack)
         }
     }
     else if(ret.function == ModbusReadHoldingRegisters ||
-             ret.function == ModbusReadInputRegisters)
+             ret.function == ModbusReadInputRegisters ||
+             ret.function == ModbusReadWriteMultipleRegisters)
     {
         ret.quantity = quint8(hex_pack[2]) / 2;
         unsigned char *coils = (unsigned char *)ret.reg_values;
@@ -86,7 +109,14 @@ ModbusFrameInfo Modbus_ASCII::masterPack2Frame(const QByteArray &pack)
     else if(ret.function == ModbusWriteMultipleCoils
              || ret.function == ModbusWriteMultipleRegisters)
     {
-        ret.quantity = hex_pack[4] << 8 | hex_pack[5];
+        ret.quantity = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
+    }
+    else if(ret.function == ModbusMaskWriteRegister)
+    {
+        ret.reg_addr = quint8(hex_pack[2]) << 8 | quint8(hex_pack[3]);
+        ret.quantity = 1;
+        ret.reg_values[0] = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
+        ret.reg_values[1] = quint8(hex_pack[6]) << 8 | quint8(hex_pack[7]);
     }
     else if(ret.function > ModbusFunctionError)
     {
@@ -116,7 +146,8 @@ QByteArray Modbus_ASCII::slaveFrame2Pack(const ModbusFrameInfo &frame_info)
         }
     }
     else if(frame_info.function == ModbusHoldingRegisters ||
-             frame_info.function == ModbusInputRegisters)
+             frame_info.function == ModbusInputRegisters ||
+             frame_info.function == ModbusReadWriteMultipleRegisters)
     {
         quint8 byte_num = quint8(frame_info.quantity << 1);
         ret.append(quint8(byte_num));
@@ -134,6 +165,16 @@ QByteArray Modbus_ASCII::slaveFrame2Pack(const ModbusFrameInfo &frame_info)
         ret.append(quint8(frame_info.reg_values[0] >> 8 & 0xFF));
         ret.append(quint8(frame_info.reg_values[0] & 0xFF));
     }
+    else if(frame_info.function == ModbusMaskWriteRegister)
+    {
+        ret.append(quint8(frame_info.reg_addr >> 8 & 0xFF));
+        ret.append(quint8(frame_info.reg_addr & 0xFF));
+        for(int i = 0;i < 2;++i)
+        {
+            ret.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            ret.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
     else if(frame_info.function == ModbusWriteMultipleCoils ||
              frame_info.function == ModbusWriteMultipleRegisters)
     {
@@ -161,20 +202,20 @@ ModbusFrameInfo Modbus_ASCII::slavePack2Frame(const QByteArray &pack)
         ret.function == ModbusReadHoldingRegisters ||
         ret.function == ModbusReadInputRegisters)
     {
-        ret.reg_addr = hex_pack[2] << 8 | hex_pack[3];
-        ret.quantity = hex_pack[4] << 8 | hex_pack[5];
+        ret.reg_addr = quint8(hex_pack[2]) << 8 | quint8(hex_pack[3]);
+        ret.quantity = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
     }
     else if(ret.function == ModbusWriteSingleCoil ||
              ret.function == ModbusWriteSingleRegister)
     {
-        ret.reg_addr = hex_pack[2] << 8 | hex_pack[3];
+        ret.reg_addr = quint8(hex_pack[2]) << 8 | quint8(hex_pack[3]);
         ret.quantity = 1;
-        ret.reg_values[0] = hex_pack[4] << 8 | hex_pack[5];
+        ret.reg_values[0] = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
     }
     else if(ret.function == ModbusWriteMultipleCoils)
     {
-        ret.reg_addr = hex_pack[2] << 8 | hex_pack[3];
-        ret.quantity = hex_pack[4] << 8 | hex_pack[5];
+        ret.reg_addr = quint8(hex_pack[2]) << 8 | quint8(hex_pack[3]);
+        ret.quantity = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
         int byte_num =  quint8(hex_pack[6]);
         unsigned char *coils = (unsigned char *)ret.reg_values;
         for(int i = 0;i < byte_num;++i)
@@ -184,8 +225,8 @@ ModbusFrameInfo Modbus_ASCII::slavePack2Frame(const QByteArray &pack)
     }
     else if(ret.function == ModbusWriteMultipleRegisters)
     {
-        ret.reg_addr = hex_pack[2] << 8 | hex_pack[3];
-        ret.quantity = hex_pack[4] << 8 | hex_pack[5];
+        ret.reg_addr = quint8(hex_pack[2]) << 8 | quint8(hex_pack[3]);
+        ret.quantity = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
         int byte_num =  quint8(hex_pack[6]);
         unsigned char *coils = (unsigned char *)ret.reg_values;
         for(int i = 0;i < byte_num; i+= 2)
@@ -194,6 +235,27 @@ ModbusFrameInfo Modbus_ASCII::slavePack2Frame(const QByteArray &pack)
             coils[i + 1] = hex_pack[i + 7];
         }
     }
+    else if(ret.function == ModbusMaskWriteRegister)
+    {
+        ret.reg_addr = quint8(hex_pack[2]) << 8 | quint8(hex_pack[3]);
+        ret.quantity = 1;
+        ret.reg_values[0] = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
+        ret.reg_values[1] = quint8(hex_pack[6]) << 8 | quint8(hex_pack[7]);
+    }
+    else if(ret.function == ModbusReadWriteMultipleRegisters)
+    {
+        ret.reg_addr = quint8(hex_pack[2]) << 8 | quint8(hex_pack[3]);
+        ret.quantity = quint8(hex_pack[4]) << 8 | quint8(hex_pack[5]);
+        ret.write_addr = quint8(hex_pack[6]) << 8 | quint8(hex_pack[7]);
+        ret.write_quantity = quint8(hex_pack[8]) << 8 | quint8(hex_pack[9]);
+        int byte_num =  quint8(hex_pack[10]);
+        unsigned char *coils = (unsigned char *)ret.reg_values;
+        for(int i = 0;i < byte_num; i+= 2)
+        {
+            coils[i] = hex_pack[i + 12];
+            coils[i + 1] = hex_pack[i + 11];
+        }
+    }
     return ret;
 }
 
@@ -203,6 +265,30 @@ bool Modbus_ASCII::validPack(const QByteArray &pack)
     return pack.startsWith(pack_start_character) && pack.endsWith(pack_terminator) && (LRC(hex_pack, hex_pack.size()) == 0);
 }
 
+qint64 Modbus_ASCII::masterPackLength(const char *data, qint64 size)
+{
+    if(size > 0 && data[0] != pack_start_character)
+    {
+        //whatever comes before the next start character is dropped
+        const char *start = static_cast<const char*>(memchr(data, pack_start_character, size));
+        return start ? -(start - data) : -size;
+    }
+    for(qint64 i = 1; i < size; ++i)
+    {
+        if(data[i - 1] == pack_terminator[0] && data[i] == pack_terminator[1])
+        {
+            return i + 1;
+        }
+    }
+    //513 characters is the longest ascii frame
+    return size > 513 ? -1 : 0;
+}
+
+qint64 Modbus_ASCII::slavePackLength(const char *data, qint64 size)
+{
+    return masterPackLength(data, size);
+}
+
 Modbus_ASCII::Modbus_ASCII(QObject *parent)
     : QObject{parent}
 {}
@@ -10,7 +10,8 @@ QByteArray Modbus_RTU::masterFrame2Pack(const ModbusFrameInfo &frame_info)
     ret.append(quint8(frame_info.reg_addr >> 8 & 0xFF));
     ret.append(quint8(frame_info.reg_addr & 0xFF));
     if(frame_info.function != ModbusWriteSingleCoil &&
-        frame_info.function != ModbusWriteSingleRegister)
+        frame_info.function != ModbusWriteSingleRegister &&
+        frame_info.function != ModbusMaskWriteRegister)
     {
         ret.append(quint8(frame_info.quantity >> 8 & 0xFF));
         ret.append(quint8(frame_info.quantity & 0xFF));
@@ -21,7 +22,15 @@ QByteArray Modbus_RTU::masterFrame2Pack(const ModbusFrameInfo &frame_info)
         ret.append(quint8(frame_info.reg_values[0] >> 8 & 0xFF));
         ret.append(quint8(frame_info.reg_values[0] & 0xFF));
     }
-    if(frame_info.function == ModbusWriteMultipleCoils)
+    if(frame_info.function == ModbusMaskWriteRegister)
+    {
+        for(int i = 0;i < 2;++i)
+        {
+            ret.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            ret.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
+    else if(frame_info.function == ModbusWriteMultipleCoils)
     {
         quint8 byte_num = quint8(pageConvert(frame_info.quantity, 8));
         ret.append(byte_num);
@@ -40,6 +49,19 @@ QByteArray Modbus_RTU::masterFrame2Pack(const ModbusFrameInfo &frame_info)
             ret.append(quint8(frame_info.reg_values[i] & 0xFF));
         }
     }
+    else if(frame_info.function == ModbusReadWriteMultipleRegisters)
+    {
+        ret.append(quint8(frame_info.write_addr >> 8 & 0xFF));
+        ret.append(quint8(frame_info.write_addr & 0xFF));
+        ret.append(quint8(frame_info.write_quantity >> 8 & 0xFF));
+        ret.append(quint8(frame_info.write_quantity & 0xFF));
+        ret.append(quint8(frame_info.write_quantity * 2));
+        for(int i = 0;i < frame_info.write_quantity;++i)
+        {
+            ret.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            ret.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
     quint16 crc_value = CRC_16(ret,ret.size());
     ret.append(quint8(crc_value & 0xFF));
     ret.append(quint8(crc_value >> 8 & 0xFF));
@@ -62,7 +84,8 @@ ModbusFrameInfo Modbus_RTU::masterPack2Frame(const QByteArray &pack)
         }
     }
     else if(ret.function == ModbusReadHoldingRegisters ||
-               ret.function == ModbusReadInputRegisters)
+               ret.function == ModbusReadInputRegisters ||
+               ret.function == ModbusReadWriteMultipleRegisters)
     {
         ret.quantity = quint8(pack[2]) / 2;
         unsigned char *coils = (unsigned char *)ret.reg_values;
@@ -82,7 +105,14 @@ ModbusFrameInfo Modbus_RTU::masterPack2Frame(const QByteArray &pack)
     else if(ret.function == ModbusWriteMultipleCoils
         || ret.function == ModbusWriteMultipleRegisters)
     {
-        ret.quantity = pack[4] << 8 | pack[5];
+        ret.quantity = quint8(pack[4]) << 8 | quint8(pack[5]);
+    }
+    else if(ret.function == ModbusMaskWriteRegister)
+    {
+        ret.reg_addr = quint8(pack[2]) << 8 | quint8(pack[3]);
+        ret.quantity = 1;
+        ret.reg_values[0] = quint8(pack[4]) << 8 | quint8(pack[5]);
+        ret.reg_values[1] = quint8(pack[6]) << 8 | quint8(pack[7]);
     }
     else if(ret.function > ModbusFunctionError)
     {
@@ -112,7 +142,8 @@ QByteArray Modbus_RTU::slaveFrame2Pack(const ModbusFrameInfo &frame_info)
         }
     }
     else if(frame_info.function == ModbusHoldingRegisters ||
-               frame_info.function == ModbusInputRegisters)
+               frame_info.function == ModbusInputRegisters ||
+               frame_info.function == ModbusReadWriteMultipleRegisters)
     {
         quint8 byte_num = quint8(frame_info.quantity << 1);
         ret.append(quint8(byte_num));
@@ -130,6 +161,16 @@ QByteArray Modbus_RTU::slaveFrame2Pack(const ModbusFrameInfo &frame_info)
         ret.append(quint8(frame_info.reg_values[0] >> 8 & 0xFF));
         ret.append(quint8(frame_info.reg_values[0] & 0xFF));
     }
+    else if(frame_info.function == ModbusMaskWriteRegister)
+    {
+        ret.append(quint8(frame_info.reg_addr >> 8 & 0xFF));
+        ret.append(quint8(frame_info.reg_addr & 0xFF));
+        for(int i = 0;i < 2;++i)
+        {
+            ret.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            ret.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
     else if(frame_info.function == ModbusWriteMultipleCoils ||
                frame_info.function == ModbusWriteMultipleRegisters)
     {
@@ -158,20 +199,20 @@ ModbusFrameInfo Modbus_RTU::slavePack2Frame(const QByteArray &pack)
         ret.function == ModbusReadHoldingRegisters ||
         ret.function == ModbusReadInputRegisters)
     {
-        ret.reg_addr = pack[2] << 8 | pack[3];
-        ret.quantity = pack[4] << 8 | pack[5];
+        ret.reg_addr = quint8(pack[2]) << 8 | quint8(pack[3]);
+        ret.quantity = quint8(pack[4]) << 8 | quint8(pack[5]);
     }
     else if(ret.function == ModbusWriteSingleCoil ||
                ret.function == ModbusWriteSingleRegister)
     {
-        ret.reg_addr = pack[2] << 8 | pack[3];
+        ret.reg_addr = quint8(pack[2]) << 8 | quint8(pack[3]);
         ret.quantity = 1;
-        ret.reg_values[0] = pack[4] << 8 | pack[5];
+        ret.reg_values[0] = quint8(pack[4]) << 8 | quint8(pack[5]);
     }
     else if(ret.function == ModbusWriteMultipleCoils)
     {
-        ret.reg_addr = pack[2] << 8 | pack[3];
-        ret.quantity = pack[4] << 8 | pack[5];
+        ret.reg_addr = quint8(pack[2]) << 8 | quint8(pack[3]);
+        ret.quantity = quint8(pack[4]) << 8 | quint8(pack[5]);
         int byte_num =  quint8(pack[6]);
         unsigned char *coils = (unsigned char *)ret.reg_values;
         for(int i = 0;i < byte_num;++i)
@@ -181,8 +222,8 @@ ModbusFrameInfo Modbus_RTU::slavePack2Frame(const QByteArray &pack)
     }
     else if(ret.function == ModbusWriteMultipleRegisters)
     {
-        ret.reg_addr = pack[2] << 8 | pack[3];
-        ret.quantity = pack[4] << 8 | pack[5];
+        ret.reg_addr = quint8(pack[2]) << 8 | quint8(pack[3]);
+        ret.quantity = quint8(pack[4]) << 8 | quint8(pack[5]);
         int byte_num =  quint8(pack[6]);
         unsigned char *coils = (unsigned char *)ret.reg_values;
         for(int i = 0;i < byte_num; i+= 2)
@@ -191,6 +232,27 @@ ModbusFrameInfo Modbus_RTU::slavePack2Frame(const QByteArray &pack)
             coils[i + 1] = pack[i + 7];
         }
     }
+    else if(ret.function == ModbusMaskWriteRegister)
+    {
+        ret.reg_addr = quint8(pack[2]) << 8 | quint8(pack[3]);
+        ret.quantity = 1;
+        ret.reg_values[0] = quint8(pack[4]) << 8 | quint8(pack[5]);
+        ret.reg_values[1] = quint8(pack[6]) << 8 | quint8(pack[7]);
+    }
+    else if(ret.function == ModbusReadWriteMultipleRegisters)
+    {
+        ret.reg_addr = quint8(pack[2]) << 8 | quint8(pack[3]);
+        ret.quantity = quint8(pack[4]) << 8 | quint8(pack[5]);
+        ret.write_addr = quint8(pack[6]) << 8 | quint8(pack[7]);
+        ret.write_quantity = quint8(pack[8]) << 8 | quint8(pack[9]);
+        int byte_num =  quint8(pack[10]);
+        unsigned char *coils = (unsigned char *)ret.reg_values;
+        for(int i = 0;i < byte_num; i+= 2)
+        {
+            coils[i] = pack[i + 12];
+            coils[i + 1] = pack[i + 11];
+        }
+    }
     return ret;
 }
 
@@ -199,6 +261,101 @@ bool Modbus_RTU::validPack(const QByteArray &pack)
     return CRC_16(pack,pack.size()) == 0;
 }
 
+qint64 Modbus_RTU::masterPackLength(const char *data, qint64 size)
+{
+    if(size < 3)
+    {
+        return 0;
+    }
+    qint64 pack_size{0};
+    quint8 function = quint8(data[1]);
+    if(function > ModbusFunctionError)
+    {
+        pack_size = 5;
+    }
+    else if(function == ModbusReadCoils ||
+             function == ModbusReadDescreteInputs ||
+             function == ModbusReadHoldingRegisters ||
+             function == ModbusReadInputRegisters ||
+             function == ModbusReadWriteMultipleRegisters)
+    {
+        pack_size = 5 + quint8(data[2]);
+    }
+    else if(function == ModbusWriteSingleCoil ||
+             function == ModbusWriteSingleRegister ||
+             function == ModbusWriteMultipleCoils ||
+             function == ModbusWriteMultipleRegisters)
+    {
+        pack_size = 8;
+    }
+    else if(function == ModbusMaskWriteRegister)
+    {
+        pack_size = 10;
+    }
+    return checkedPackLength(data, size, pack_size);
+}
+
+qint64 Modbus_RTU::slavePackLength(const char *data, qint64 size)
+{
+    if(size < 2)
+    {
+        return 0;
+    }
+    qint64 pack_size{0};
+    quint8 function = quint8(data[1]);
+    if(function == ModbusReadCoils ||
+        function == ModbusReadDescreteInputs ||
+        function == ModbusReadHoldingRegisters ||
+        function == ModbusReadInputRegisters ||
+        function == ModbusWriteSingleCoil ||
+        function == ModbusWriteSingleRegister)
+    {
+        pack_size = 8;
+    }
+    else if(function == ModbusMaskWriteRegister)
+    {
+        pack_size = 10;
+    }
+    else if(function == ModbusWriteMultipleCoils ||
+             function == ModbusWriteMultipleRegisters)
+    {
+        if(size < 7)
+        {
+            return 0;
+        }
+        pack_size = 9 + quint8(data[6]);
+    }
+    else if(function == ModbusReadWriteMultipleRegisters)
+    {
+        if(size < 11)
+        {
+            return 0;
+        }
+        pack_size = 13 + quint8(data[10]);
+    }
+    return checkedPackLength(data, size, pack_size);
+}
+
+qint64 Modbus_RTU::checkedPackLength(const char *data, qint64 size, qint64 pack_size)
+{
+    if(pack_size == 0)
+    {
+        //a function this tool does not know has no length to go by, the request is only taken
+        //when everything received so far is one frame, otherwise the search goes on one byte later
+        if(size < 4)
+        {
+            return 0;
+        }
+        return CRC_16(QByteArray::fromRawData(data, size), size) == 0 ? size : -1;
+    }
+    if(size < pack_size)
+    {
+        return 0;
+    }
+    //a frame with a broken checksum is not where a frame starts, the search goes on one byte later
+    return CRC_16(QByteArray::fromRawData(data, pack_size), pack_size) == 0 ? pack_size : -1;
+}
+
 Modbus_RTU::Modbus_RTU(QObject *parent)
     : QObject{parent}
 {}
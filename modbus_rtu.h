@@ -14,9 +14,14 @@ public:
     static QByteArray slaveFrame2Pack(const ModbusFrameInfo &frame_info);
     static ModbusFrameInfo slavePack2Frame(const QByteArray &pack);
     static bool validPack(const QByteArray &pack);
+    //the size of the frame at the head of data, 0 while it is incomplete,
+    //minus the number of bytes to drop when data does not start with a frame
+    static qint64 masterPackLength(const char *data, qint64 size);
+    static qint64 slavePackLength(const char *data, qint64 size);
 
 private:
     explicit Modbus_RTU(QObject *parent = nullptr);
+    static qint64 checkedPackLength(const char *data, qint64 size, qint64 pack_size);
 };
 
 #endif // MODBUS_RTU_H
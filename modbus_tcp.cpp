@@ -16,7 +16,8 @@ QByteArray Modbus_TCP::masterFrame2Pack(const ModbusFrameInfo &frame_info)
     data_pack.append(quint8(frame_info.reg_addr >> 8 & 0xFF));
     data_pack.append(quint8(frame_info.reg_addr & 0xFF));
     if(frame_info.function != ModbusWriteSingleCoil &&
-        frame_info.function != ModbusWriteSingleRegister)
+        frame_info.function != ModbusWriteSingleRegister &&
+        frame_info.function != ModbusMaskWriteRegister)
     {
         data_pack.append(quint8(frame_info.quantity >> 8 & 0xFF));
         data_pack.append(quint8(frame_info.quantity & 0xFF));
@@ -27,7 +28,15 @@ QByteArray Modbus_TCP::masterFrame2Pack(const ModbusFrameInfo &frame_info)
         data_pack.append(quint8(frame_info.reg_values[0] >> 8 & 0xFF));
         data_pack.append(quint8(frame_info.reg_values[0] & 0xFF));
     }
-    if(frame_info.function == ModbusWriteMultipleCoils)
+    if(frame_info.function == ModbusMaskWriteRegister)
+    {
+        for(int i = 0;i < 2;++i)
+        {
+            data_pack.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            data_pack.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
+    else if(frame_info.function == ModbusWriteMultipleCoils)
     {
         quint8 byte_num = quint8(pageConvert(frame_info.quantity, 8));
         data_pack.append(byte_num);
@@ -46,6 +55,19 @@ QByteArray Modbus_TCP::masterFrame2Pack(const ModbusFrameInfo &frame_info)
             data_pack.append(quint8(frame_info.reg_values[i] & 0xFF));
         }
     }
+    else if(frame_info.function == ModbusReadWriteMultipleRegisters)
+    {
+        data_pack.append(quint8(frame_info.write_addr >> 8 & 0xFF));
+        data_pack.append(quint8(frame_info.write_addr & 0xFF));
+        data_pack.append(quint8(frame_info.write_quantity >> 8 & 0xFF));
+        data_pack.append(quint8(frame_info.write_quantity & 0xFF));
+        data_pack.append(quint8(frame_info.write_quantity * 2));
+        for(int i = 0;i < frame_info.write_quantity;++i)
+        {
+            data_pack.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            data_pack.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
     quint16 data_pack_size = data_pack.size();
     ret.append(quint8(data_pack_size >> 8 & 0xFF));
     ret.append(quint8(data_pack_size & 0xFF));
@@ -56,7 +78,7 @@ QByteArray Modbus_TCP::masterFrame2Pack(const ModbusFrameInfo &frame_info)
 ModbusFrameInfo Modbus_TCP::masterPack2Frame(const QByteArray &pack)
 {
     ModbusFrameInfo ret{};
-    ret.trans_id = pack[0] << 8 | pack[1];
+    ret.trans_id = quint8(pack[0]) << 8 | quint8(pack[1]);
     QByteArray data_pack = pack.mid(6);
     ret.id = quint8(data_pack[0]);
     ret.function = quint8(data_pack[1]);
@@ -71,7 +93,8 @@ ModbusFrameInfo Modbus_TCP::masterPack2Frame(const QByteArray &pack)
         }
     }
     else if(ret.function == ModbusReadHoldingRegisters ||
-             ret.function == ModbusReadInputRegisters)
+             ret.function == ModbusReadInputRegisters ||
+             ret.function == ModbusReadWriteMultipleRegisters)
     {
         ret.quantity = quint8(data_pack[2]) / 2;
         unsigned char *coils = (unsigned char *)ret.reg_values;
@@ -91,7 +114,14 @@ ModbusFrameInfo Modbus_TCP::masterPack2Frame(const QByteArray &pack)
     else if(ret.function == ModbusWriteMultipleCoils
              || ret.function == ModbusWriteMultipleRegisters)
     {
-        ret.quantity = data_pack[4] << 8 | data_pack[5];
+        ret.quantity = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
+    }
+    else if(ret.function == ModbusMaskWriteRegister)
+    {
+        ret.reg_addr = quint8(data_pack[2]) << 8 | quint8(data_pack[3]);
+        ret.quantity = 1;
+        ret.reg_values[0] = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
+        ret.reg_values[1] = quint8(data_pack[6]) << 8 | quint8(data_pack[7]);
     }
     else if(ret.function > ModbusFunctionError)
     {
@@ -126,7 +156,8 @@ QByteArray Modbus_TCP::slaveFrame2Pack(const ModbusFrameInfo &frame_info)
         }
     }
     else if(frame_info.function == ModbusHoldingRegisters ||
-             frame_info.function == ModbusInputRegisters)
+             frame_info.function == ModbusInputRegisters ||
+             frame_info.function == ModbusReadWriteMultipleRegisters)
     {
         quint8 byte_num = quint8(frame_info.quantity << 1);
         data_pack.append(quint8(byte_num));
@@ -144,6 +175,16 @@ QByteArray Modbus_TCP::slaveFrame2Pack(const ModbusFrameInfo &frame_info)
         data_pack.append(quint8(frame_info.reg_values[0] >> 8 & 0xFF));
         data_pack.append(quint8(frame_info.reg_values[0] & 0xFF));
     }
+    else if(frame_info.function == ModbusMaskWriteRegister)
+    {
+        data_pack.append(quint8(frame_info.reg_addr >> 8 & 0xFF));
+        data_pack.append(quint8(frame_info.reg_addr & 0xFF));
+        for(int i = 0;i < 2;++i)
+        {
+            data_pack.append(quint8(frame_info.reg_values[i] >> 8 & 0xFF));
+            data_pack.append(quint8(frame_info.reg_values[i] & 0xFF));
+        }
+    }
     else if(frame_info.function == ModbusWriteMultipleCoils ||
              frame_info.function == ModbusWriteMultipleRegisters)
     {
@@ -166,7 +207,7 @@ QByteArray Modbus_TCP::slaveFrame2Pack(const ModbusFrameInfo &frame_info)
 ModbusFrameInfo Modbus_TCP::slavePack2Frame(const QByteArray &pack)
 {
     ModbusFrameInfo ret{};
-    ret.trans_id = pack[0] << 8 | pack[1];
+    ret.trans_id = quint8(pack[0]) << 8 | quint8(pack[1]);
     QByteArray data_pack = pack.mid(6);
     ret.id = quint8(data_pack[0]);
     ret.function = quint8(data_pack[1]);
@@ -175,20 +216,20 @@ ModbusFrameInfo Modbus_TCP::slavePack2Frame(const QByteArray &pack)
         ret.function == ModbusReadHoldingRegisters ||
         ret.function == ModbusReadInputRegisters)
     {
-        ret.reg_addr = data_pack[2] << 8 | data_pack[3];
-        ret.quantity = data_pack[4] << 8 | data_pack[5];
+        ret.reg_addr = quint8(data_pack[2]) << 8 | quint8(data_pack[3]);
+        ret.quantity = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
     }
     else if(ret.function == ModbusWriteSingleCoil ||
              ret.function == ModbusWriteSingleRegister)
     {
-        ret.reg_addr = data_pack[2] << 8 | data_pack[3];
+        ret.reg_addr = quint8(data_pack[2]) << 8 | quint8(data_pack[3]);
         ret.quantity = 1;
-        ret.reg_values[0] = data_pack[4] << 8 | data_pack[5];
+        ret.reg_values[0] = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
     }
     else if(ret.function == ModbusWriteMultipleCoils)
     {
-        ret.reg_addr = data_pack[2] << 8 | data_pack[3];
-        ret.quantity = data_pack[4] << 8 | data_pack[5];
+        ret.reg_addr = quint8(data_pack[2]) << 8 | quint8(data_pack[3]);
+        ret.quantity = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
         int byte_num =  quint8(data_pack[6]);
         unsigned char *coils = (unsigned char *)ret.reg_values;
         for(int i = 0;i < byte_num;++i)
@@ -198,8 +239,8 @@ ModbusFrameInfo Modbus_TCP::slavePack2Frame(const QByteArray &pack)
     }
     else if(ret.function == ModbusWriteMultipleRegisters)
     {
-        ret.reg_addr = data_pack[2] << 8 | data_pack[3];
-        ret.quantity = data_pack[4] << 8 | data_pack[5];
+        ret.reg_addr = quint8(data_pack[2]) << 8 | quint8(data_pack[3]);
+        ret.quantity = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
         int byte_num =  quint8(data_pack[6]);
         unsigned char *coils = (unsigned char *)ret.reg_values;
         for(int i = 0;i < byte_num; i+= 2)
@@ -208,15 +249,58 @@ ModbusFrameInfo Modbus_TCP::slavePack2Frame(const QByteArray &pack)
             coils[i + 1] = data_pack[i + 7];
         }
     }
+    else if(ret.function == ModbusMaskWriteRegister)
+    {
+        ret.reg_addr = quint8(data_pack[2]) << 8 | quint8(data_pack[3]);
+        ret.quantity = 1;
+        ret.reg_values[0] = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
+        ret.reg_values[1] = quint8(data_pack[6]) << 8 | quint8(data_pack[7]);
+    }
+    else if(ret.function == ModbusReadWriteMultipleRegisters)
+    {
+        ret.reg_addr = quint8(data_pack[2]) << 8 | quint8(data_pack[3]);
+        ret.quantity = quint8(data_pack[4]) << 8 | quint8(data_pack[5]);
+        ret.write_addr = quint8(data_pack[6]) << 8 | quint8(data_pack[7]);
+        ret.write_quantity = quint8(data_pack[8]) << 8 | quint8(data_pack[9]);
+        int byte_num =  quint8(data_pack[10]);
+        unsigned char *coils = (unsigned char *)ret.reg_values;
+        for(int i = 0;i < byte_num; i+= 2)
+        {
+            coils[i] = data_pack[i + 12];
+            coils[i + 1] = data_pack[i + 11];
+        }
+    }
     return ret;
 }
 
 bool Modbus_TCP::validPack(const QByteArray &pack)
 {
-    quint16 data_pack_size = pack[4] << 8 | pack[5];
+    quint16 data_pack_size = quint8(pack[4]) << 8 | quint8(pack[5]);
     return data_pack_size == pack.size() - 6;
 }
 
+qint64 Modbus_TCP::masterPackLength(const char *data, qint64 size)
+{
+    if(size < 6)
+    {
+        return 0;
+    }
+    quint16 protocol_id = quint8(data[2]) << 8 | quint8(data[3]);
+    quint16 length = quint8(data[4]) << 8 | quint8(data[5]);
+    //no modbus adu is longer than 260 bytes, a header that says otherwise is not one
+    if(protocol_id != 0 || length < 2 || length > 254)
+    {
+        return -1;
+    }
+    qint64 pack_size = 6 + length;
+    return size >= pack_size ? pack_size : 0;
+}
+
+qint64 Modbus_TCP::slavePackLength(const char *data, qint64 size)
+{
+    return masterPackLength(data, size);
+}
+
 Modbus_TCP::Modbus_TCP(QObject *parent)
     : QObject{parent}
 {}
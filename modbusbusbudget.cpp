@@ -0,0 +1,92 @@
+#include "modbusbusbudget.h"
+#include <QSerialPort>
+#include <QtMath>
+#include "addregdialog.h"
+#include "openroutedialog.h"
+#include "ModbusFrameInfo.h"
+
+ModbusBusBudget::ModbusBusBudget(int protocol, const ModbusLineSettings &line_settings)
+    : m_protocol(protocol), m_line_settings(line_settings)
+{
+}
+
+bool ModbusBusBudget::lineSettings(QIODevice *com, ModbusLineSettings &line_settings)
+{
+    QSerialPort *serial_port = qobject_cast<QSerialPort*>(com);
+    if(!serial_port)
+    {
+        return false;
+    }
+    line_settings.baud_rate = serial_port->baudRate();
+    line_settings.data_bits = serial_port->dataBits();
+    line_settings.parity_bits = serial_port->parity() == QSerialPort::NoParity ? 0 : 1;
+    switch(serial_port->stopBits())
+    {
+    case QSerialPort::OneAndHalfStop:
+        line_settings.stop_bits = 1.5;
+        break;
+    case QSerialPort::TwoStop:
+        line_settings.stop_bits = 2;
+        break;
+    default:
+        line_settings.stop_bits = 1;
+        break;
+    }
+    return true;
+}
+
+double ModbusBusBudget::characterTime() const
+{
+    double bits = 1 + m_line_settings.data_bits + m_line_settings.parity_bits + m_line_settings.stop_bits;
+    return bits * 1000.0 / qMax(1, m_line_settings.baud_rate);
+}
+
+double ModbusBusBudget::transactionTime(const ModbusRegReadDefinitions &reg_def) const
+{
+    int response_size{0};
+    if(reg_def.function == ModbusReadCoils || reg_def.function == ModbusReadDescreteInputs)
+    {
+        response_size = 5 + (reg_def.quantity + 7) / 8;
+    }
+    else
+    {
+        response_size = 5 + reg_def.quantity * 2;
+    }
+    return frameTime(8) + frameTime(response_size);
+}
+
+double ModbusBusBudget::utilisation(const QList<ModbusRegReadDefinitions> &reg_defs) const
+{
+    double load{0};
+    for(const auto &x : reg_defs)
+    {
+        load += transactionTime(x) / qMax<quint32>(x.scan_rate, 1);
+    }
+    return load;
+}
+
+QList<quint32> ModbusBusBudget::fittedScanRates(const QList<ModbusRegReadDefinitions> &reg_defs, double target) const
+{
+    QList<quint32> scan_rates;
+    double load = utilisation(reg_defs);
+    //the ratios between the blocks are kept, a fast block stays faster than a slow one
+    double factor = target > 0 && load > target ? load / target : 1.0;
+    for(const auto &x : reg_defs)
+    {
+        scan_rates.append(quint32(qCeil(qMax<quint32>(x.scan_rate, 1) * factor)));
+    }
+    return scan_rates;
+}
+
+double ModbusBusBudget::frameTime(int rtu_size) const
+{
+    double char_time = characterTime();
+    if(m_protocol == MODBUS_ASCII)
+    {
+        //every byte is two characters, the crc becomes a one byte lrc, plus ':' and CR LF
+        return (3 + (rtu_size - 1) * 2) * char_time;
+    }
+    //a frame is followed by 3.5 silent characters, fixed at 1.75 ms above 19200 baud
+    double silent_time = m_line_settings.baud_rate > 19200 ? 1.75 : 3.5 * char_time;
+    return rtu_size * char_time + silent_time;
+}
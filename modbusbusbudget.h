@@ -0,0 +1,47 @@
+#ifndef MODBUSBUSBUDGET_H
+#define MODBUSBUSBUDGET_H
+
+#include <QList>
+
+class QIODevice;
+struct ModbusRegReadDefinitions;
+
+//character framing of a serial line
+struct ModbusLineSettings
+{
+    int baud_rate{9600};
+    int data_bits{8};
+    int parity_bits{0};
+    double stop_bits{1};
+};
+
+/*
+ * Works out how much of a serial line the polls of a master route take. A poll costs the
+ * wire time of its request and response plus the silent intervals around them, and a block
+ * scanned every scan_rate ms takes that share of the bus. Turnaround inside the slaves is not
+ * known here, so the figures are the least the schedule needs.
+ */
+
+class ModbusBusBudget
+{
+public:
+    ModbusBusBudget(int protocol, const ModbusLineSettings &line_settings);
+    //false when the connection is not a serial port
+    static bool lineSettings(QIODevice *com, ModbusLineSettings &line_settings);
+    double characterTime() const;
+    //request and response of one poll, in ms
+    double transactionTime(const ModbusRegReadDefinitions &reg_def) const;
+    //the share of the bus the polls take, 1.0 is a saturated line
+    double utilisation(const QList<ModbusRegReadDefinitions> &reg_defs) const;
+    //the scan rates stretched by one common factor so the polls take at most target of the bus
+    QList<quint32> fittedScanRates(const QList<ModbusRegReadDefinitions> &reg_defs, double target) const;
+
+private:
+    double frameTime(int rtu_size) const;
+
+private:
+    int m_protocol;
+    ModbusLineSettings m_line_settings;
+};
+
+#endif // MODBUSBUSBUDGET_H
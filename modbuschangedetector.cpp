@@ -0,0 +1,131 @@
+#include "modbuschangedetector.h"
+#include <QtMath>
+#include <cstring>
+#include "modbusvaluecodec.h"
+
+void ModbusChangeDetector::reset(const QVector<quint16> &image)
+{
+    m_reported = image;
+    buildDeadbandIndex();
+}
+
+void ModbusChangeDetector::setDeadbands(const QList<ModbusDeadband> &deadbands)
+{
+    m_deadbands = deadbands;
+    buildDeadbandIndex();
+}
+
+QList<ModbusValueChange> ModbusChangeDetector::detect(const QVector<quint16> &image)
+{
+    QList<ModbusValueChange> changes;
+    if(image.size() != m_reported.size())
+    {
+        reset(image);
+        changes.append(ModbusValueChange{0, image});
+        return changes;
+    }
+    const int size = image.size();
+    const quint16 *new_values = image.constData();
+    const quint16 *old_values = m_reported.constData();
+    QVector<bool> changed(size, false);
+    int last_deadband = -1;
+    bool last_deadband_exceeded = false;
+    for(int i = 0; i < size; ++i)
+    {
+        //unchanged blocks of four registers are skipped with one compare
+        if(i % 4 == 0 && i + 4 <= size)
+        {
+            quint64 new_block, old_block;
+            memcpy(&new_block, &new_values[i], sizeof(new_block));
+            memcpy(&old_block, &old_values[i], sizeof(old_block));
+            if(new_block == old_block)
+            {
+                i += 3;
+                continue;
+            }
+        }
+        if(new_values[i] == old_values[i])
+        {
+            continue;
+        }
+        int deadband = m_deadband_index[i];
+        if(deadband < 0)
+        {
+            changed[i] = true;
+            continue;
+        }
+        //a value spanning several registers is judged once and reported as a whole
+        if(deadband != last_deadband)
+        {
+            last_deadband = deadband;
+            last_deadband_exceeded = exceedsDeadband(m_deadbands[deadband], new_values);
+            if(last_deadband_exceeded)
+            {
+                const ModbusDeadband &x = m_deadbands[deadband];
+                int width = ModbusValueCodec::valueWidth(x.format);
+                for(int j = x.offset; j < x.offset + width; ++j)
+                {
+                    changed[j] = true;
+                }
+            }
+        }
+    }
+    for(int i = 0; i < size; ++i)
+    {
+        if(!changed[i])
+        {
+            continue;
+        }
+        int first = i;
+        while(i < size && changed[i])
+        {
+            ++i;
+        }
+        ModbusValueChange change;
+        change.offset = first;
+        change.values = image.mid(first, i - first);
+        memcpy(&m_reported[first], &new_values[first], (i - first) * sizeof(quint16));
+        changes.append(change);
+    }
+    return changes;
+}
+
+void ModbusChangeDetector::accept(int offset, const QVector<quint16> &values)
+{
+    if(offset < 0 || offset + values.size() > m_reported.size())
+    {
+        return;
+    }
+    memcpy(&m_reported[offset], values.constData(), values.size() * sizeof(quint16));
+}
+
+void ModbusChangeDetector::buildDeadbandIndex()
+{
+    m_deadband_index = QVector<int>(m_reported.size(), -1);
+    for(int i = 0; i < m_deadbands.size(); ++i)
+    {
+        const ModbusDeadband &x = m_deadbands[i];
+        int width = ModbusValueCodec::valueWidth(x.format);
+        if(x.offset + width > m_reported.size() || (x.absolute <= 0 && x.percent <= 0))
+        {
+            continue;
+        }
+        for(int j = x.offset; j < x.offset + width; ++j)
+        {
+            m_deadband_index[j] = i;
+        }
+    }
+}
+
+bool ModbusChangeDetector::exceedsDeadband(const ModbusDeadband &deadband, const quint16 *image) const
+{
+    double new_value = ModbusValueCodec::decodeValue(deadband.format, &image[deadband.offset]);
+    double old_value = ModbusValueCodec::decodeValue(deadband.format, &m_reported[deadband.offset]);
+    //a value that stops being a number, or becomes one again, is always worth reporting
+    if(qIsNaN(new_value) != qIsNaN(old_value))
+    {
+        return true;
+    }
+    double band = qMax(deadband.absolute, qAbs(old_value) * deadband.percent / 100.0);
+    return qAbs(new_value - old_value) > band;
+}
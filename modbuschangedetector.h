@@ -0,0 +1,51 @@
+#ifndef MODBUSCHANGEDETECTOR_H
+#define MODBUSCHANGEDETECTOR_H
+
+#include <QList>
+#include <QVector>
+
+//a deadband on one decoded value of a register block, format is a ModbusValueFormat
+struct ModbusDeadband
+{
+    quint16 offset{0};
+    int format{0};
+    double absolute{0};
+    //of the value last reported
+    double percent{0};
+};
+
+//a run of registers that changed, with their new values
+struct ModbusValueChange
+{
+    quint16 offset{0};
+    QVector<quint16> values;
+};
+
+/*
+ * Report by exception for one register block. It keeps the image last handed on and turns a
+ * new image into the runs of registers that really changed. The images are compared four
+ * registers at a time, and a value with a deadband only counts as changed once it moved
+ * further than the band away from the value last reported.
+ */
+
+class ModbusChangeDetector
+{
+public:
+    void reset(const QVector<quint16> &image);
+    void setDeadbands(const QList<ModbusDeadband> &deadbands);
+    QList<ModbusValueChange> detect(const QVector<quint16> &image);
+    //a run of registers the receiver already knows about
+    void accept(int offset, const QVector<quint16> &values);
+
+private:
+    void buildDeadbandIndex();
+    bool exceedsDeadband(const ModbusDeadband &deadband, const quint16 *image) const;
+
+private:
+    QVector<quint16> m_reported;
+    QList<ModbusDeadband> m_deadbands;
+    //the deadband covering each register, -1 where registers are compared exactly
+    QVector<int> m_deadband_index;
+};
+
+#endif // MODBUSCHANGEDETECTOR_H
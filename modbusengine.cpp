@@ -0,0 +1,1627 @@
+#include "modbusengine.h"
+#include <QIODevice>
+#include <QTimer>
+#include <QDebug>
+#include "modbus_ascii.h"
+#include "modbus_rtu.h"
+#include "modbus_tcp.h"
+#include "openroutedialog.h"
+#include "utils.h"
+#include "mytcpsocket.h"
+#include "modbusmasterengine.h"
+#include <memory>
+#include <mutex>
+
+#define PRINT_TRAFFIC 0
+
+namespace {
+//requests cut out on the io thread, waiting for the engine's thread to take them all at once
+struct IncomingRequests
+{
+    std::mutex mutex;
+    QByteArray data;
+    QVector<int> sizes;
+};
+}
+
+ModbusEngine::ModbusEngine(bool is_master, int protocol, QObject *parent)
+    : QObject{parent}, m_is_master(is_master), m_protocol(protocol), m_channel_dispatch(Dispatch_By_Load)
+    , m_image_change_sequence(0), m_route_id(0), m_next_generation(0), m_scan_phasing(Phasing_Spread), m_recv_timeout_ms(300)
+    , m_trans_id(0), m_paused(false), m_traffic_enabled(false)
+{
+    //the views are refreshed at most this often however fast the replies come in,
+    //the timer only runs while something is waiting to be handed over
+    m_flush_timer = new QTimer(this);
+    m_flush_timer->setSingleShot(true);
+    m_flush_timer->setInterval(50);
+    connect(m_flush_timer, &QTimer::timeout, this, &ModbusEngine::flushTimerTimeoutSlot);
+    m_combine_timer = new QTimer(this);
+    m_combine_timer->setSingleShot(true);
+    connect(m_combine_timer, &QTimer::timeout, this, &ModbusEngine::combineTimerTimeoutSlot);
+    //held back replies are due to the millisecond, a coarse timer would add its own jitter
+    m_reply_timer = new QTimer(this);
+    m_reply_timer->setSingleShot(true);
+    m_reply_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_reply_timer, &QTimer::timeout, this, &ModbusEngine::replyTimerTimeoutSlot);
+    m_image_timer = new QTimer(this);
+    m_image_timer->setInterval(50);
+    connect(m_image_timer, &QTimer::timeout, this, &ModbusEngine::imageTimerTimeoutSlot);
+}
+
+ModbusEngine::~ModbusEngine()
+{
+    //an engine deleted without being shut down first still closes its connections and leaves the master engine
+    shutdown();
+}
+
+void ModbusEngine::start()
+{
+    ModbusMasterEngine::instance()->attachEngine(this);
+    if(m_is_master && !m_route_id)
+    {
+        m_route_id = ModbusMasterEngine::instance()->registerRoute(this);
+        for(auto it = m_definitions.begin(); it != m_definitions.end(); ++it)
+        {
+            scheduleFirstScan(it.key());
+        }
+    }
+}
+
+void ModbusEngine::addChannel(QIODevice *com)
+{
+    if(m_is_master)
+    {
+        m_channels.append(createChannel(com));
+    }
+    else
+    {
+        addSlaveConnection(com);
+    }
+}
+
+void ModbusEngine::setChannelDispatch(int dispatch)
+{
+    m_channel_dispatch = dispatch;
+}
+
+void ModbusEngine::setRecvTimeout(int recv_timeout_ms)
+{
+    m_recv_timeout_ms = recv_timeout_ms;
+}
+
+void ModbusEngine::setSchedulerSettings(const ModbusSchedulerSettings &settings)
+{
+    m_scheduler.setSettings(settings);
+    //turning fusion on again gives units that refused FC23 another try
+    m_no_fuse_units.clear();
+    m_no_mask_write_units.clear();
+}
+
+void ModbusEngine::setScanPhasing(int phasing)
+{
+    if(m_scan_phasing == phasing)
+    {
+        return;
+    }
+    m_scan_phasing = phasing;
+    QList<quint32> scan_rates;
+    for(const auto &x : m_definitions)
+    {
+        if(!scan_rates.contains(x.reg_def.scan_rate))
+        {
+            scan_rates.append(x.reg_def.scan_rate);
+        }
+    }
+    for(auto x : scan_rates)
+    {
+        phaseScanGroup(x);
+    }
+}
+
+void ModbusEngine::addDefinition(quint32 def_handle, const ModbusRegReadDefinitions &reg_def)
+{
+    EngineDefinition &definition = m_definitions[def_handle];
+    definition.reg_def = reg_def;
+    definition.values = QVector<quint16>(reg_def.quantity, 0);
+    definition.change_detector.reset(definition.values);
+    layoutImage();
+    scheduleFirstScan(def_handle);
+}
+
+void ModbusEngine::modifyDefinition(quint32 def_handle, const ModbusRegReadDefinitions &reg_def)
+{
+    if(!m_definitions.contains(def_handle))
+    {
+        return;
+    }
+    //a poll of the old block still queued would land in the new one
+    m_scheduler.removeDefinition(def_handle);
+    for(auto x : m_channels)
+    {
+        if(x->request.def_handle == def_handle)
+        {
+            x->request.def_handle = 0;
+        }
+    }
+    EngineDefinition &definition = m_definitions[def_handle];
+    quint32 old_scan_rate = definition.reg_def.scan_rate;
+    definition.reg_def = reg_def;
+    definition.values = QVector<quint16>(reg_def.quantity, 0);
+    definition.change_detector.setDeadbands(QList<ModbusDeadband>());
+    definition.change_detector.reset(definition.values);
+    definition.generator.setGenerators(QList<ModbusGenerator>(), ModbusMasterEngine::instance()->now());
+    ++definition.version;
+    layoutImage();
+    scheduleFirstScan(def_handle);
+    if(old_scan_rate != reg_def.scan_rate)
+    {
+        phaseScanGroup(old_scan_rate);
+    }
+}
+
+void ModbusEngine::setScanRate(quint32 def_handle, quint32 scan_rate)
+{
+    auto it = m_definitions.find(def_handle);
+    if(it == m_definitions.end())
+    {
+        return;
+    }
+    quint32 old_scan_rate = it.value().reg_def.scan_rate;
+    if(old_scan_rate == scan_rate)
+    {
+        return;
+    }
+    //the block moves to another scan group, both groups are spread again
+    it.value().reg_def.scan_rate = scan_rate;
+    phaseScanGroup(old_scan_rate);
+    phaseScanGroup(scan_rate);
+}
+
+void ModbusEngine::removeDefinition(quint32 def_handle)
+{
+    m_scheduler.removeDefinition(def_handle);
+    for(auto x : m_channels)
+    {
+        if(x->request.def_handle == def_handle)
+        {
+            x->request.def_handle = 0;
+        }
+    }
+    auto it = m_definitions.find(def_handle);
+    if(it == m_definitions.end())
+    {
+        return;
+    }
+    quint32 scan_rate = it.value().reg_def.scan_rate;
+    m_definitions.erase(it);
+    m_pending_views.remove(def_handle);
+    layoutImage();
+    phaseScanGroup(scan_rate);
+}
+
+void ModbusEngine::writeValues(quint32 def_handle, int offset, const QVector<quint16> &values)
+{
+    auto it = m_definitions.find(def_handle);
+    if(it == m_definitions.end() || offset < 0 || values.isEmpty() || offset + values.size() > it.value().values.size())
+    {
+        return;
+    }
+    EngineDefinition &definition = it.value();
+    memcpy(definition.values.data() + offset, values.constData(), values.size() * sizeof(quint16));
+    ++definition.version;
+    publishValues(definition, offset, values.size());
+    //the view already shows what was edited there, changes to the other registers are still reported
+    definition.change_detector.accept(offset, values);
+}
+
+void ModbusEngine::setDeadbands(quint32 def_handle, const QList<ModbusDeadband> &deadbands)
+{
+    auto it = m_definitions.find(def_handle);
+    if(it != m_definitions.end())
+    {
+        it.value().change_detector.setDeadbands(deadbands);
+    }
+}
+
+void ModbusEngine::setGenerators(quint32 def_handle, const QList<ModbusGenerator> &generators)
+{
+    auto it = m_definitions.find(def_handle);
+    if(it != m_definitions.end())
+    {
+        it.value().generator.setGenerators(generators, ModbusMasterEngine::instance()->now());
+        ++it.value().version;
+    }
+}
+
+void ModbusEngine::setFaultSettings(const ModbusFaultSettings &settings)
+{
+    m_fault_injector.setSettings(settings);
+}
+
+void ModbusEngine::setSharedImage(const QString &file_name)
+{
+    m_image_timer->stop();
+    m_shared_image.close();
+    for(auto &x : m_definitions)
+    {
+        x.image_index = -1;
+    }
+    if(file_name.isEmpty())
+    {
+        return;
+    }
+    QString error;
+    if(!m_shared_image.open(file_name, error))
+    {
+        emit sharedImageFailed(error);
+        return;
+    }
+    layoutImage();
+}
+
+void ModbusEngine::write(const QByteArray &pack)
+{
+    ModbusFrameInfo frame_info = requestFrame(pack);
+    if(frame_info.function == ModbusMaskWriteRegister && m_no_mask_write_units.contains(frame_info.id))
+    {
+        QByteArray single_write = singleWriteForMask(frame_info);
+        if(!single_write.isEmpty())
+        {
+            write(single_write);
+            return;
+        }
+    }
+    int combine_ms = m_scheduler.settings().write_combine_ms;
+    if(combine_ms > 0 && m_write_combiner.add(pack, frame_info))
+    {
+        //the window starts with the first write, later ones do not push it back
+        if(!m_combine_timer->isActive())
+        {
+            m_combine_timer->start(combine_ms);
+        }
+        return;
+    }
+    //a write that is not combined must not overtake the ones still held in the window
+    if(!m_write_combiner.isEmpty())
+    {
+        m_combine_timer->stop();
+        enqueueCombinedWrites();
+    }
+    enqueueWrite(pack);
+    dispatchRequests();
+}
+
+void ModbusEngine::enqueueWrite(const QByteArray &pack)
+{
+    ModbusRequest request;
+    request.pack = pack;
+    request.id = requestUnitId(pack);
+    request.priority = m_scheduler.writePriority(requestFrame(pack).function);
+    m_scheduler.enqueue(request);
+}
+
+void ModbusEngine::setTrafficEnabled(bool enabled)
+{
+    m_traffic_enabled = enabled;
+}
+
+void ModbusEngine::pause()
+{
+    m_paused = true;
+    for(auto x : m_channels)
+    {
+        x->recv_timer->stop();
+        x->recv_buffer.clear();
+        requeueRequest(x);
+    }
+}
+
+void ModbusEngine::resume()
+{
+    m_paused = false;
+    for(auto x : m_channels)
+    {
+        x->com->readAll();
+    }
+    dispatchRequests();
+}
+
+void ModbusEngine::shutdown()
+{
+    ModbusMasterEngine::instance()->detachEngine(this);
+    if(m_route_id)
+    {
+        ModbusMasterEngine::instance()->unregisterRoute(m_route_id);
+        m_route_id = 0;
+    }
+    m_flush_timer->stop();
+    m_combine_timer->stop();
+    m_reply_timer->stop();
+    m_pending_replies.clear();
+    m_image_timer->stop();
+    m_shared_image.close();
+    //deleting a master connection would remove its channel from the list, the list is emptied first
+    QList<MasterChannel*> channels = m_channels;
+    m_channels.clear();
+    for(auto x : channels)
+    {
+        delete x->recv_timer;
+        delete x->com;
+    }
+    qDeleteAll(channels);
+    //deleting a slave connection removes it from the list, the list is emptied first
+    QList<QIODevice*> slave_coms = m_slave_coms;
+    m_slave_coms.clear();
+    m_slave_recv_buffers.clear();
+    qDeleteAll(slave_coms);
+}
+
+void ModbusEngine::scanDue(quint32 def_handle, quint32 generation)
+{
+    auto it = m_definitions.find(def_handle);
+    if(it == m_definitions.end() || it.value().generation != generation)
+    {
+        return;
+    }
+    EngineDefinition &definition = it.value();
+    ModbusMasterEngine *master_engine = ModbusMasterEngine::instance();
+    qint64 now_ms = master_engine->now();
+    qint64 scan_rate = qMax<qint64>(definition.reg_def.scan_rate, 1);
+    //the cadence follows the due times, a late wake up does not push every later scan back,
+    //and periods missed entirely are skipped without leaving the block's phase
+    definition.next_scan_ms += scan_rate;
+    if(definition.next_scan_ms <= now_ms)
+    {
+        definition.next_scan_ms += ((now_ms - definition.next_scan_ms) / scan_rate + 1) * scan_rate;
+    }
+    master_engine->scheduleScan(m_route_id, def_handle, generation, definition.next_scan_ms);
+    //a poll still waiting is not stacked up again, a slow class cannot build a backlog
+    if(isPollPending(def_handle))
+    {
+        definition.scan_overdue = true;
+        return;
+    }
+    enqueuePoll(def_handle);
+}
+
+void ModbusEngine::dispatchRequests()
+{
+    if(m_paused)
+    {
+        return;
+    }
+    for(auto x : m_channels)
+    {
+        if(!x->busy && x->link_up)
+        {
+            sendNextRequest(x);
+        }
+    }
+}
+
+void ModbusEngine::combineTimerTimeoutSlot()
+{
+    enqueueCombinedWrites();
+    dispatchRequests();
+}
+
+void ModbusEngine::enqueueCombinedWrites()
+{
+    for(const auto &x : m_write_combiner.take())
+    {
+        enqueueWrite(x.pack.isEmpty() ? masterPack(x.frame_info) : x.pack);
+    }
+}
+
+void ModbusEngine::flushTimerTimeoutSlot()
+{
+    if(m_pending_views.isEmpty() && m_pending_updates.write_results.isEmpty() &&
+        m_pending_updates.error_codes.isEmpty() && m_pending_updates.traffic.isEmpty())
+    {
+        return;
+    }
+    for(auto it = m_pending_views.begin(); it != m_pending_views.end(); ++it)
+    {
+        ModbusViewUpdate &view_update = it.value();
+        if(view_update.has_values)
+        {
+            //only the latest image is compared, replies in between are not queued up
+            EngineDefinition &definition = m_definitions[it.key()];
+            view_update.changes = definition.change_detector.detect(definition.values);
+            view_update.has_values = !view_update.changes.isEmpty();
+        }
+        if(!view_update.has_values && !view_update.send_count && !view_update.error_count && !view_update.has_error)
+        {
+            continue;
+        }
+        m_pending_updates.views.append(view_update);
+    }
+    m_pending_views.clear();
+    //a batch of images that stayed inside their deadbands is not handed over at all
+    if(!m_pending_updates.views.isEmpty() || !m_pending_updates.write_results.isEmpty() ||
+        !m_pending_updates.error_codes.isEmpty() || !m_pending_updates.traffic.isEmpty())
+    {
+        emit updatesReady(m_pending_updates);
+    }
+    m_pending_updates = ModbusEngineUpdates();
+}
+
+ModbusEngine::MasterChannel *ModbusEngine::createChannel(QIODevice *com)
+{
+    MasterChannel *channel = new MasterChannel;
+    channel->com = com;
+    channel->recv_timer = new QTimer(this);
+    channel->recv_timer->setSingleShot(true);
+    connect(channel->recv_timer, &QTimer::timeout, this, std::bind(&ModbusEngine::channelRecvTimeout, this, channel));
+    connect(com, &QIODevice::readyRead, this, std::bind(&ModbusEngine::channelReadyRead, this, channel));
+    //a client that drops for good is deleted by whoever opened it, its channel goes with it
+    connect(com, &QObject::destroyed, this, std::bind(&ModbusEngine::removeChannel, this, channel));
+    MyTcpSocket *tcp_socket = qobject_cast<MyTcpSocket*>(com);
+    if(tcp_socket)
+    {
+        connect(tcp_socket, &MyTcpSocket::disconnectedFromHost, this, &ModbusEngine::comDisconnectedSlot);
+        connect(tcp_socket, &MyTcpSocket::connectFinished, this, &ModbusEngine::comConnectFinishedSlot);
+    }
+    //a client still trying to connect joins the route down, it is only opened once connected
+    channel->link_up = com->isOpen();
+    return channel;
+}
+
+void ModbusEngine::removeChannel(MasterChannel *channel)
+{
+    if(!m_channels.removeOne(channel))
+    {
+        return;
+    }
+    //the request in flight is sent again on one of the remaining connections
+    requeueRequest(channel);
+    delete channel->recv_timer;
+    delete channel;
+    dispatchRequests();
+}
+
+ModbusEngine::MasterChannel *ModbusEngine::findChannel(QObject *com) const
+{
+    for(auto x : m_channels)
+    {
+        if(x->com == com)
+        {
+            return x;
+        }
+    }
+    return nullptr;
+}
+
+void ModbusEngine::addSlaveConnection(QIODevice *com)
+{
+    m_slave_coms.append(com);
+    connect(com, &QIODevice::readyRead, this, &ModbusEngine::comSlaveReadyReadSlot);
+    connect(com, &QObject::destroyed, this, [this, com](){
+        m_slave_coms.removeOne(com);
+        m_slave_recv_buffers.remove(com);
+    });
+    MyTcpSocket *tcp_socket = qobject_cast<MyTcpSocket*>(com);
+    if(tcp_socket)
+    {
+        connect(tcp_socket, &MyTcpSocket::disconnectedFromHost, this, &ModbusEngine::comDisconnectedSlot);
+        //requests are cut out on the io thread and collected in one buffer, only the first of a batch
+        //posts to the engine's thread, which then serves every request that came in meanwhile
+        int protocol = m_protocol;
+        QPointer<QIODevice> guarded_com(com);
+        auto incoming = std::make_shared<IncomingRequests>();
+        tcp_socket->setFrameHandler([protocol](const char *data, qint64 size){
+            return slavePackLength(protocol, data, size);
+        }, [this, guarded_com, incoming](const char *data, qint64 size){
+            std::unique_lock<std::mutex> lock(incoming->mutex);
+            bool first = incoming->sizes.isEmpty();
+            incoming->data.append(data, size);
+            incoming->sizes.append(int(size));
+            lock.unlock();
+            if(!first)
+            {
+                return;
+            }
+            QMetaObject::invokeMethod(this, [this, guarded_com, incoming](){
+                QByteArray data;
+                QVector<int> sizes;
+                std::unique_lock<std::mutex> lock(incoming->mutex);
+                data.swap(incoming->data);
+                sizes.swap(incoming->sizes);
+                lock.unlock();
+                int offset = 0;
+                for(auto x : sizes)
+                {
+                    if(!guarded_com)
+                    {
+                        return;
+                    }
+                    slaveRequestReceived(guarded_com, sizes.size() == 1 ? data : data.mid(offset, x));
+                    offset += x;
+                }
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+bool ModbusEngine::acceptsRequest(MasterChannel *channel, const ModbusRequest &request) const
+{
+    if(m_channel_dispatch != Dispatch_By_Unit_ID || m_channels.size() < 2)
+    {
+        return true;
+    }
+    //requests of one unit always share a connection, so a gateway still sees them in order
+    return m_channels.indexOf(channel) == request.id % m_channels.size();
+}
+
+bool ModbusEngine::isPollPending(quint32 def_handle) const
+{
+    for(auto x : m_channels)
+    {
+        if(x->busy && x->request.def_handle == def_handle)
+        {
+            return true;
+        }
+    }
+    return m_scheduler.contains(def_handle);
+}
+
+void ModbusEngine::scheduleFirstScan(quint32 def_handle)
+{
+    EngineDefinition &definition = m_definitions[def_handle];
+    definition.generation = ++m_next_generation;
+    definition.scan_overdue = false;
+    if(!m_route_id)
+    {
+        return;
+    }
+    //the view is filled right away, the block only waits for its slot from the second scan on
+    enqueuePoll(def_handle);
+    phaseScanGroup(definition.reg_def.scan_rate);
+    dispatchRequests();
+}
+
+void ModbusEngine::phaseScanGroup(quint32 scan_rate)
+{
+    if(!m_route_id)
+    {
+        return;
+    }
+    QList<quint32> group;
+    for(auto it = m_definitions.constBegin(); it != m_definitions.constEnd(); ++it)
+    {
+        if(it.value().reg_def.scan_rate == scan_rate)
+        {
+            group.append(it.key());
+        }
+    }
+    //the slots are laid on the master engine's clock, so synchronized blocks of different routes
+    //come due on the same tick, while spread blocks take turns evenly across the period
+    ModbusMasterEngine *master_engine = ModbusMasterEngine::instance();
+    qint64 now_ms = master_engine->now();
+    qint64 period = qMax<quint32>(scan_rate, 1);
+    for(int i = 0; i < group.size(); ++i)
+    {
+        EngineDefinition &definition = m_definitions[group[i]];
+        qint64 phase = m_scan_phasing == Phasing_Synchronized ? 0 : period * i / group.size();
+        qint64 elapsed = now_ms - phase;
+        definition.next_scan_ms = phase + (elapsed >= 0 ? (elapsed / period + 1) * period : 0);
+        definition.generation = ++m_next_generation;
+        master_engine->scheduleScan(m_route_id, group[i], definition.generation, definition.next_scan_ms);
+    }
+}
+
+void ModbusEngine::enqueuePoll(quint32 def_handle)
+{
+    const EngineDefinition &definition = m_definitions[def_handle];
+    ModbusRequest request;
+    request.pack = definition.reg_def.packet;
+    request.id = definition.reg_def.id;
+    request.priority = m_scheduler.pollPriority(definition.reg_def.scan_rate);
+    request.def_handle = def_handle;
+    m_scheduler.enqueue(request);
+}
+
+void ModbusEngine::pollFinished(quint32 def_handle)
+{
+    auto it = m_definitions.find(def_handle);
+    if(it == m_definitions.end() || !it.value().scan_overdue)
+    {
+        return;
+    }
+    it.value().scan_overdue = false;
+    enqueuePoll(def_handle);
+}
+
+void ModbusEngine::sendNextRequest(MasterChannel *channel)
+{
+    bool has_pack = m_scheduler.dequeue(channel->request, [this, channel](const ModbusRequest &request){
+        return acceptsRequest(channel, request);
+    });
+    if(!has_pack)
+    {
+        return;
+    }
+    channel->broadcast = isBroadcast(requestFrame(channel->request.pack));
+    if(!channel->broadcast)
+    {
+        fuseReadWrite(channel->request);
+    }
+    if(channel->request.def_handle)
+    {
+        ++pendingView(channel->request.def_handle).send_count;
+    }
+#if PRINT_TRAFFIC
+    qDebug()<<"Master Send: "<<channel->request.pack.toHex(' ').toUpper();
+#endif
+    if(m_protocol == MODBUS_TCP || m_protocol == MODBUS_UDP)
+    {
+        setModbusPacketTransID(channel->request.pack, m_trans_id);
+        ++m_trans_id;
+    }
+    channel->busy = true;
+    channel->recv_buffer.clear();
+    channel->com->write(channel->request.pack);
+    reportTraffic("Tx", channel->request.pack, false);
+    channel->recv_timer->start(channel->broadcast ? m_scheduler.settings().broadcast_turnaround_ms : m_recv_timeout_ms);
+}
+
+void ModbusEngine::fuseReadWrite(ModbusRequest &request)
+{
+    if(request.def_handle || request.keep_apart || !m_scheduler.settings().fuse_read_write || m_no_fuse_units.contains(request.id))
+    {
+        return;
+    }
+    ModbusFrameInfo write_frame = requestFrame(request.pack);
+    //a read/write request carries at most 121 registers to write
+    if(write_frame.function != ModbusWriteMultipleRegisters || write_frame.quantity > 121)
+    {
+        return;
+    }
+    auto is_holding_poll = [this](const ModbusRequest &x){
+        return x.def_handle && m_definitions.value(x.def_handle).reg_def.function == ModbusReadHoldingRegisters;
+    };
+    //a poll reading back what is written is preferred, the write is then verified in the same transaction
+    ModbusRequest poll;
+    bool has_poll = m_scheduler.take(request.id, poll, [this, &write_frame, &is_holding_poll](const ModbusRequest &x){
+        if(!is_holding_poll(x))
+        {
+            return false;
+        }
+        const ModbusRegReadDefinitions &reg_def = m_definitions.value(x.def_handle).reg_def;
+        return write_frame.reg_addr >= reg_def.reg_addr && write_frame.reg_addr + write_frame.quantity <= reg_def.reg_addr + reg_def.quantity;
+    });
+    if(!has_poll)
+    {
+        has_poll = m_scheduler.take(request.id, poll, is_holding_poll);
+    }
+    if(!has_poll)
+    {
+        return;
+    }
+    ModbusFrameInfo read_frame = requestFrame(poll.pack);
+    ModbusFrameInfo fused_frame = write_frame;
+    fused_frame.function = ModbusReadWriteMultipleRegisters;
+    fused_frame.write_addr = write_frame.reg_addr;
+    fused_frame.write_quantity = write_frame.quantity;
+    fused_frame.reg_addr = read_frame.reg_addr;
+    fused_frame.quantity = read_frame.quantity;
+    request.fused_write = request.pack;
+    request.pack = masterPack(fused_frame);
+    request.def_handle = poll.def_handle;
+}
+
+bool ModbusEngine::isBroadcast(const ModbusFrameInfo &frame_info) const
+{
+    //only a serial line has broadcasts, behind TCP unit 0 usually addresses the device itself
+    if(frame_info.id != 0 || (m_protocol != MODBUS_RTU && m_protocol != MODBUS_ASCII))
+    {
+        return false;
+    }
+    return frame_info.function == ModbusWriteSingleCoil ||
+           frame_info.function == ModbusWriteMultipleCoils ||
+           frame_info.function == ModbusWriteSingleRegister ||
+           frame_info.function == ModbusWriteMultipleRegisters ||
+           frame_info.function == ModbusMaskWriteRegister;
+}
+
+QByteArray ModbusEngine::masterPack(const ModbusFrameInfo &frame_info) const
+{
+    switch(m_protocol)
+    {
+    case MODBUS_ASCII:
+        return Modbus_ASCII::masterFrame2Pack(frame_info);
+    case MODBUS_TCP:
+    case MODBUS_UDP:
+        return Modbus_TCP::masterFrame2Pack(frame_info);
+    default:
+        return Modbus_RTU::masterFrame2Pack(frame_info);
+    }
+}
+
+QByteArray ModbusEngine::singleWriteForMask(const ModbusFrameInfo &frame_info) const
+{
+    ModbusErrorCode error_code;
+    quint32 def_handle = getSlaveDefinition(frame_info.id, ModbusMaskWriteRegister, frame_info.reg_addr, 1, error_code);
+    if(!def_handle)
+    {
+        return QByteArray();
+    }
+    const EngineDefinition &definition = m_definitions[def_handle];
+    quint16 value = definition.values[frame_info.reg_addr - definition.reg_def.reg_addr];
+    ModbusFrameInfo write_frame{};
+    write_frame.id = frame_info.id;
+    write_frame.function = ModbusWriteSingleRegister;
+    write_frame.reg_addr = frame_info.reg_addr;
+    write_frame.quantity = 1;
+    write_frame.reg_values[0] = (value & frame_info.reg_values[0]) | (frame_info.reg_values[1] & ~frame_info.reg_values[0]);
+    return masterPack(write_frame);
+}
+
+void ModbusEngine::requeueRequest(MasterChannel *channel)
+{
+    if(!channel->busy)
+    {
+        return;
+    }
+    //a poll whose definition was removed meanwhile is dropped, a write is always sent again
+    if(channel->request.priority <= ModbusScheduler::Priority_Normal_Write || channel->request.def_handle)
+    {
+        m_scheduler.requeue(channel->request);
+    }
+    channel->busy = false;
+    channel->broadcast = false;
+    channel->request.def_handle = 0;
+}
+
+void ModbusEngine::channelRecvTimeout(MasterChannel *channel)
+{
+    if(!channel->busy)
+    {
+        return;
+    }
+    channel->busy = false;
+    channel->recv_buffer.clear();
+    if(channel->broadcast)
+    {
+        //the turnaround is over, no slave answers a broadcast so it counts as done
+        channel->broadcast = false;
+        reportWriteResult(ModbusErrorCode_OK);
+        dispatchRequests();
+        return;
+    }
+    channel->last_send_frame = requestFrame(channel->request.pack);
+    if(channel->last_send_frame.function == ModbusWriteSingleCoil ||
+        channel->last_send_frame.function == ModbusWriteMultipleCoils ||
+        channel->last_send_frame.function == ModbusWriteSingleRegister ||
+        channel->last_send_frame.function == ModbusWriteMultipleRegisters ||
+        channel->last_send_frame.function == ModbusMaskWriteRegister ||
+        channel->last_send_frame.function == ModbusReadWriteMultipleRegisters)
+    {
+        reportWriteResult(ModbusErrorCode_Timeout);
+    }
+    reportError(channel->request.def_handle, ModbusErrorCode_Timeout);
+    pollFinished(channel->request.def_handle);
+    dispatchRequests();
+}
+
+void ModbusEngine::channelReadyRead(MasterChannel *channel)
+{
+    if(m_paused)
+    {
+        return;
+    }
+    channel->recv_buffer.append(channel->com->readAll());
+    if(!channel->busy || channel->broadcast)
+    {
+        //nothing was asked on this connection, the bytes can only be a late reply
+        channel->recv_buffer.clear();
+        return;
+    }
+    bool is_intact {false};
+    ModbusFrameInfo frame_info{};
+    switch(m_protocol)
+    {
+    case MODBUS_RTU:
+    {
+        is_intact = Modbus_RTU::validPack(channel->recv_buffer);
+        if(is_intact)
+        {
+            frame_info = Modbus_RTU::masterPack2Frame(channel->recv_buffer);
+        }
+        break;
+    }
+    case MODBUS_ASCII:
+    {
+        is_intact = Modbus_ASCII::validPack(channel->recv_buffer);
+        if(is_intact)
+        {
+            frame_info = Modbus_ASCII::masterPack2Frame(channel->recv_buffer);
+        }
+        break;
+    }
+    case MODBUS_TCP:
+    case MODBUS_UDP:
+    {
+        is_intact = Modbus_TCP::validPack(channel->recv_buffer);
+        if(is_intact)
+        {
+            frame_info = Modbus_TCP::masterPack2Frame(channel->recv_buffer);
+        }
+        break;
+    }
+    default:
+    {
+        break;
+    }
+    }
+    if(is_intact)
+    {
+#if PRINT_TRAFFIC
+        qDebug()<<"Master Recv: "<<channel->recv_buffer.toHex(' ').toUpper();
+#endif
+        channel->last_send_frame = requestFrame(channel->request.pack);
+        if(frame_info.id == channel->last_send_frame.id)
+        {
+            if(((m_protocol == MODBUS_TCP || m_protocol == MODBUS_UDP) && frame_info.trans_id == channel->last_send_frame.trans_id)
+                || (m_protocol != MODBUS_TCP && m_protocol != MODBUS_UDP))
+            {
+                reportTraffic("Rx", channel->recv_buffer, frame_info.function > ModbusFunctionError);
+                channel->recv_timer->stop();
+                channel->busy = false;
+                processMasterFrame(frame_info, channel);
+                pollFinished(channel->request.def_handle);
+                dispatchRequests();
+            }
+        }
+        channel->recv_buffer.clear();
+    }
+}
+
+int ModbusEngine::requestUnitId(const QByteArray &pack) const
+{
+    switch(m_protocol)
+    {
+    case MODBUS_RTU:
+        return quint8(pack[0]);
+    case MODBUS_ASCII:
+        return pack.mid(1, 2).toInt(nullptr, 16);
+    case MODBUS_TCP:
+    case MODBUS_UDP:
+        return quint8(pack[6]);
+    default:
+        return 0;
+    }
+}
+
+ModbusFrameInfo ModbusEngine::requestFrame(const QByteArray &pack) const
+{
+    switch(m_protocol)
+    {
+    case MODBUS_ASCII:
+        return Modbus_ASCII::slavePack2Frame(pack);
+    case MODBUS_TCP:
+    case MODBUS_UDP:
+        return Modbus_TCP::slavePack2Frame(pack);
+    default:
+        return Modbus_RTU::slavePack2Frame(pack);
+    }
+}
+
+void ModbusEngine::comSlaveReadyReadSlot()
+{
+    QIODevice *com = qobject_cast<QIODevice*>(sender());
+    if(!com)
+    {
+        return;
+    }
+    QByteArray recv_buffer = m_slave_recv_buffers.take(com);
+    recv_buffer.append(com->readAll());
+    //several requests may have come in one read, bytes that start none are dropped until one does
+    qint64 pack_size{0};
+    while((pack_size = slavePackLength(m_protocol, recv_buffer.constData(), recv_buffer.size())) != 0)
+    {
+        if(pack_size < 0)
+        {
+            recv_buffer.remove(0, -pack_size);
+            continue;
+        }
+        QByteArray request_pack = recv_buffer.left(pack_size);
+        recv_buffer.remove(0, pack_size);
+        slaveRequestReceived(com, request_pack);
+    }
+    if(!recv_buffer.isEmpty() && m_slave_coms.contains(com))
+    {
+        m_slave_recv_buffers.insert(com, recv_buffer);
+    }
+}
+
+qint64 ModbusEngine::slavePackLength(int protocol, const char *data, qint64 size)
+{
+    switch(protocol)
+    {
+    case MODBUS_RTU:
+        return Modbus_RTU::slavePackLength(data, size);
+    case MODBUS_ASCII:
+        return Modbus_ASCII::slavePackLength(data, size);
+    case MODBUS_TCP:
+    case MODBUS_UDP:
+        return Modbus_TCP::slavePackLength(data, size);
+    default:
+        //nothing is known of the framing, everything received is dropped
+        return -size;
+    }
+}
+
+void ModbusEngine::slaveRequestReceived(QIODevice *com, const QByteArray &request_pack)
+{
+    bool is_intact {false};
+    switch(m_protocol)
+    {
+    case MODBUS_RTU:
+    {
+        is_intact = Modbus_RTU::validPack(request_pack);
+        break;
+    }
+    case MODBUS_ASCII:
+    {
+        is_intact = Modbus_ASCII::validPack(request_pack);
+        break;
+    }
+    case MODBUS_TCP:
+    case MODBUS_UDP:
+    {
+        is_intact = Modbus_TCP::validPack(request_pack);
+        break;
+    }
+    default:
+    {
+        break;
+    }
+    }
+    if(!is_intact)
+    {
+        return;
+    }
+#if PRINT_TRAFFIC
+    qDebug()<<"Slave Recv: "<<request_pack.toHex(' ').toUpper();
+#endif
+    ModbusFaultPlan fault_plan = m_fault_injector.plan();
+    //a poll asked before of a block that did not change since is answered without decoding it
+    if(replyFromCache(com, request_pack, fault_plan))
+    {
+        return;
+    }
+    ModbusFrameInfo frame_info = requestFrame(request_pack);
+    bool has_id{false};
+    for(const auto &x : m_definitions)
+    {
+        if(x.reg_def.id == frame_info.id)
+        {
+            has_id = true;
+            break;
+        }
+    }
+    if(has_id || isBroadcast(frame_info))
+    {
+        reportTraffic("Rx", request_pack, false);
+        processSlaveFrame(frame_info, com, request_pack, fault_plan);
+    }
+}
+
+void ModbusEngine::comDisconnectedSlot()
+{
+    //the engine owns its connections, one that does not come back is deleted here,
+    //its channel or slave connection is dropped when it is destroyed
+    MyTcpSocket *tcp_socket = qobject_cast<MyTcpSocket*>(sender());
+    if(tcp_socket && !tcp_socket->autoReconnect())
+    {
+        tcp_socket->deleteLater();
+    }
+    if(!m_is_master)
+    {
+        m_slave_recv_buffers.remove(qobject_cast<QIODevice*>(sender()));
+        return;
+    }
+    MasterChannel *channel = findChannel(sender());
+    if(channel)
+    {
+        //the request in flight goes back to the head of its queue and is sent again after reconnecting
+        channel->link_up = false;
+        channel->recv_timer->stop();
+        channel->recv_buffer.clear();
+        requeueRequest(channel);
+    }
+}
+
+void ModbusEngine::comConnectFinishedSlot(bool connected)
+{
+    MasterChannel *channel = findChannel(sender());
+    if(!connected || !channel || channel->link_up)
+    {
+        return;
+    }
+    channel->link_up = true;
+    if(!m_paused)
+    {
+        sendNextRequest(channel);
+    }
+}
+
+quint32 ModbusEngine::getSlaveDefinition(int id, int function, int reg_addr, int quantity, ModbusErrorCode &error_code) const
+{
+    bool found_id {false};
+    for(auto it = m_definitions.constBegin(); it != m_definitions.constEnd(); ++it)
+    {
+        const ModbusRegReadDefinitions &x = it.value().reg_def;
+        if(x.id == id)
+        {
+            found_id = true;
+            if(reg_addr >= x.reg_addr)
+            {
+                if(reg_addr + quantity <= x.reg_addr + x.quantity)
+                {
+                    if(x.function == function ||
+                        ((function == ModbusWriteSingleCoil || function == ModbusWriteMultipleCoils) && x.function == ModbusCoilStatus) ||
+                        ((function == ModbusWriteSingleRegister || function ==ModbusWriteMultipleRegisters || function == ModbusMaskWriteRegister) && x.function == ModbusHoldingRegisters))
+                    {
+                        error_code = ModbusErrorCode_OK;
+                        return it.key();
+                    }
+                    else
+                    {
+                        error_code = ModbusErrorCode_Illegal_Function;
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+    if(found_id)
+    {
+        error_code = ModbusErrorCode_Illegal_Data_Address;
+    }
+    else
+    {
+        error_code = ModbusErrorCode_OK;
+    }
+    return 0;
+}
+
+void ModbusEngine::processMasterFrame(const ModbusFrameInfo &frame_info, MasterChannel *channel)
+{
+    quint32 def_handle = channel->request.def_handle;
+    auto definition = m_definitions.find(def_handle);
+    const ModbusFrameInfo &last_send_frame = channel->last_send_frame;
+    if(frame_info.function > ModbusFunctionError)
+    {
+        ModbusErrorCode error_code = (ModbusErrorCode)(frame_info.reg_values[0]);
+        int func_code = frame_info.function - ModbusFunctionError;
+        if(func_code == ModbusReadWriteMultipleRegisters && !channel->request.fused_write.isEmpty())
+        {
+            //an exception to a fused request cannot be told to belong to the write or to the poll, both
+            //are sent again on their own and each reports its own result; a slave without FC23 is not asked again
+            if(error_code == ModbusErrorCode_Illegal_Function)
+            {
+                m_no_fuse_units.insert(channel->request.id);
+            }
+            ModbusRequest write_request;
+            write_request.pack = channel->request.fused_write;
+            write_request.id = channel->request.id;
+            write_request.priority = m_scheduler.writePriority(ModbusWriteMultipleRegisters);
+            write_request.keep_apart = true;
+            m_scheduler.requeue(write_request);
+            if(definition != m_definitions.end())
+            {
+                definition.value().scan_overdue = true;
+            }
+            return;
+        }
+        if(func_code == ModbusMaskWriteRegister && error_code == ModbusErrorCode_Illegal_Function)
+        {
+            //the slave has no FC22, the edit is written as a whole register over the last polled value,
+            //bits changed on the device since that poll are overwritten
+            QByteArray single_write = singleWriteForMask(last_send_frame);
+            if(!single_write.isEmpty())
+            {
+                m_no_mask_write_units.insert(channel->request.id);
+                ModbusRequest write_request;
+                write_request.pack = single_write;
+                write_request.id = channel->request.id;
+                write_request.priority = m_scheduler.writePriority(ModbusWriteSingleRegister);
+                m_scheduler.requeue(write_request);
+                return;
+            }
+        }
+        if(func_code == ModbusWriteSingleCoil ||
+            func_code == ModbusWriteMultipleCoils ||
+            func_code == ModbusWriteSingleRegister ||
+            func_code == ModbusWriteMultipleRegisters ||
+            func_code == ModbusMaskWriteRegister ||
+            func_code == ModbusReadWriteMultipleRegisters)
+        {
+            reportWriteResult(error_code);
+        }
+        reportError(def_handle, error_code);
+    }
+    else if(frame_info.function == ModbusReadCoils ||
+             frame_info.function == ModbusReadDescreteInputs)
+    {
+        if(definition != m_definitions.end())
+        {
+            QVector<quint16> &values = definition.value().values;
+            int offset = last_send_frame.reg_addr - definition.value().reg_def.reg_addr;
+            quint8 *coils = (quint8*)frame_info.reg_values;
+            for(int i = 0; i < last_send_frame.quantity && offset + i < values.size(); ++i)
+            {
+                int byte_index = i / 8;
+                int bit_index = i % 8;
+                values[offset + i] = getBit(coils[byte_index], bit_index);
+            }
+            publishValues(definition.value(), offset, qMin<int>(last_send_frame.quantity, values.size() - offset));
+            ModbusViewUpdate &view_update = pendingView(def_handle);
+            view_update.has_values = true;
+            view_update.has_error = true;
+            view_update.error_code = ModbusErrorCode_OK;
+        }
+    }
+    else if(frame_info.function == ModbusReadHoldingRegisters ||
+               frame_info.function == ModbusReadInputRegisters ||
+               frame_info.function == ModbusReadWriteMultipleRegisters)
+    {
+        if(frame_info.function == ModbusReadWriteMultipleRegisters)
+        {
+            reportWriteResult(ModbusErrorCode_OK);
+        }
+        if(definition != m_definitions.end())
+        {
+            QVector<quint16> &values = definition.value().values;
+            int offset = last_send_frame.reg_addr - definition.value().reg_def.reg_addr;
+            for(int i = 0; i < frame_info.quantity && offset + i < values.size(); ++i)
+            {
+                values[offset + i] = frame_info.reg_values[i];
+            }
+            publishValues(definition.value(), offset, qMin<int>(frame_info.quantity, values.size() - offset));
+            ModbusViewUpdate &view_update = pendingView(def_handle);
+            view_update.has_values = true;
+            view_update.has_error = true;
+            view_update.error_code = ModbusErrorCode_OK;
+        }
+    }
+    else if(last_send_frame.function == ModbusWriteSingleCoil ||
+               last_send_frame.function == ModbusWriteMultipleCoils ||
+               last_send_frame.function == ModbusWriteSingleRegister ||
+               last_send_frame.function == ModbusWriteMultipleRegisters ||
+               last_send_frame.function == ModbusMaskWriteRegister)
+    {
+        reportWriteResult(ModbusErrorCode_OK);
+    }
+    else
+    {
+        qDebug()<<"Unkown Modbus Function Code : "<<frame_info.function <<frame_info.id <<frame_info.reg_addr<<frame_info.quantity;
+    }
+}
+
+bool ModbusEngine::replyFromCache(QIODevice *com, const QByteArray &request_pack, const ModbusFaultPlan &fault_plan)
+{
+    //an exception drawn by the fault injector is worked out the long way
+    if(m_reply_cache.isEmpty() || fault_plan.exception_code)
+    {
+        return false;
+    }
+    auto it = m_reply_cache.find(replyCacheKey(request_pack));
+    if(it == m_reply_cache.end())
+    {
+        return false;
+    }
+    auto definition = m_definitions.find(it.value().def_handle);
+    if(definition != m_definitions.end())
+    {
+        //another process may have written the block since the reply was cached
+        syncFromImage(definition.key(), definition.value());
+    }
+    if(definition == m_definitions.end() || definition.value().version != it.value().version)
+    {
+        m_reply_cache.erase(it);
+        return false;
+    }
+    reportTraffic("Rx", request_pack, false);
+    if(fault_plan.drop)
+    {
+        return true;
+    }
+    QByteArray reply_pack = it.value().pack;
+    if(m_protocol == MODBUS_TCP || m_protocol == MODBUS_UDP)
+    {
+        setModbusPacketTransID(reply_pack, quint8(request_pack[0]) << 8 | quint8(request_pack[1]));
+    }
+    if(fault_plan.corrupt)
+    {
+        reply_pack = ModbusFaultInjector::corrupt(m_protocol, reply_pack);
+    }
+    sendSlaveReply(com, reply_pack, false, fault_plan.delay_ms, fault_plan.fragment);
+    return true;
+}
+
+QByteArray ModbusEngine::replyCacheKey(const QByteArray &request_pack) const
+{
+    if(m_protocol == MODBUS_TCP || m_protocol == MODBUS_UDP)
+    {
+        return request_pack.mid(2);
+    }
+    return request_pack;
+}
+
+void ModbusEngine::processSlaveFrame(const ModbusFrameInfo &frame_info, QIODevice *com, const QByteArray &request_pack, const ModbusFaultPlan &fault_plan)
+{
+    if(isBroadcast(frame_info))
+    {
+        //every unit simulated here carries out a broadcast, none of them answers it
+        QList<int> unit_ids;
+        for(const auto &x : m_definitions)
+        {
+            if(!unit_ids.contains(x.reg_def.id))
+            {
+                unit_ids.append(x.reg_def.id);
+            }
+        }
+        for(auto id : unit_ids)
+        {
+            ModbusFrameInfo unit_frame = frame_info;
+            unit_frame.id = id;
+            slaveReply(unit_frame);
+        }
+        return;
+    }
+    ModbusFrameInfo reply_frame{};
+    if(fault_plan.exception_code)
+    {
+        //the device turns the request down, nothing of it is carried out
+        reply_frame.id = frame_info.id;
+        reply_frame.trans_id = frame_info.trans_id;
+        reply_frame.function = frame_info.function + ModbusFunctionError;
+        reply_frame.reg_values[0] = fault_plan.exception_code;
+    }
+    else
+    {
+        reply_frame = slaveReply(frame_info);
+    }
+    if(fault_plan.drop)
+    {
+        //the request was carried out, only its reply is lost
+        return;
+    }
+    QByteArray reply_pack;
+    switch(m_protocol)
+    {
+    case MODBUS_RTU:
+    {
+        reply_pack = Modbus_RTU::slaveFrame2Pack(reply_frame);
+        break;
+    }
+    case MODBUS_ASCII:
+    {
+        reply_pack = Modbus_ASCII::slaveFrame2Pack(reply_frame);
+        break;
+    }
+    case MODBUS_TCP:
+    case MODBUS_UDP:
+    {
+        reply_pack = Modbus_TCP::slaveFrame2Pack(reply_frame);
+        break;
+    }
+    default:
+        break;
+    }
+    if(reply_frame.function == ModbusReadCoils || reply_frame.function == ModbusReadDescreteInputs ||
+        reply_frame.function == ModbusReadHoldingRegisters || reply_frame.function == ModbusReadInputRegisters)
+    {
+        ModbusErrorCode error_code{ModbusErrorCode_OK};
+        quint32 def_handle = getSlaveDefinition(frame_info.id, frame_info.function, frame_info.reg_addr, frame_info.quantity, error_code);
+        //generated values change with every read, their replies are never the same twice
+        if(def_handle && m_definitions[def_handle].generator.isEmpty())
+        {
+            if(m_reply_cache.size() >= 4096)
+            {
+                m_reply_cache.clear();
+            }
+            m_reply_cache.insert(replyCacheKey(request_pack), CachedReply{def_handle, m_definitions[def_handle].version, reply_pack});
+        }
+    }
+    if(fault_plan.corrupt)
+    {
+        reply_pack = ModbusFaultInjector::corrupt(m_protocol, reply_pack);
+    }
+    sendSlaveReply(com, reply_pack, reply_frame.function > ModbusFunctionError, fault_plan.delay_ms, fault_plan.fragment);
+}
+
+void ModbusEngine::sendSlaveReply(QIODevice *com, const QByteArray &pack, bool is_error, qint64 delay_ms, bool fragment)
+{
+    if(delay_ms <= 0 && !fragment)
+    {
+#if PRINT_TRAFFIC
+        qDebug()<<"Slave Send: "<<pack.toHex(' ').toUpper();
+#endif
+        com->write(pack);
+        reportTraffic("Tx", pack, is_error);
+        return;
+    }
+    //replies go out in the order they come due, other connections are answered meanwhile
+    qint64 due_ms = ModbusMasterEngine::instance()->now() + delay_ms;
+    if(fragment && pack.size() > 1)
+    {
+        int half = pack.size() / 2;
+        m_pending_replies.emplace(due_ms, PendingReply{com, pack.left(half), is_error});
+        due_ms += qMax(1, m_fault_injector.settings().fragment_gap_ms);
+        m_pending_replies.emplace(due_ms, PendingReply{com, pack.mid(half), is_error});
+    }
+    else
+    {
+        m_pending_replies.emplace(due_ms, PendingReply{com, pack, is_error});
+    }
+    replyTimerTimeoutSlot();
+}
+
+void ModbusEngine::replyTimerTimeoutSlot()
+{
+    qint64 now_ms = ModbusMasterEngine::instance()->now();
+    while(!m_pending_replies.empty() && m_pending_replies.begin()->first <= now_ms)
+    {
+        PendingReply reply = m_pending_replies.begin()->second;
+        m_pending_replies.erase(m_pending_replies.begin());
+        if(reply.com)
+        {
+            reply.com->write(reply.pack);
+            reportTraffic("Tx", reply.pack, reply.is_error);
+        }
+    }
+    if(!m_pending_replies.empty())
+    {
+        m_reply_timer->start(int(m_pending_replies.begin()->first - now_ms));
+    }
+}
+
+ModbusFrameInfo ModbusEngine::slaveReply(const ModbusFrameInfo &frame_info)
+{
+    ModbusErrorCode error_code{ModbusErrorCode_OK};
+    quint32 def_handle{0};
+    quint32 write_def_handle{0};
+    if(frame_info.function == ModbusReadWriteMultipleRegisters)
+    {
+        //both blocks are checked before anything is written
+        write_def_handle = getSlaveDefinition(frame_info.id, ModbusWriteMultipleRegisters, frame_info.write_addr, frame_info.write_quantity, error_code);
+        if(write_def_handle)
+        {
+            def_handle = getSlaveDefinition(frame_info.id, ModbusReadHoldingRegisters, frame_info.reg_addr, frame_info.quantity, error_code);
+        }
+    }
+    else
+    {
+        def_handle = getSlaveDefinition(frame_info.id, frame_info.function, frame_info.reg_addr, frame_info.quantity, error_code);
+    }
+    ModbusFrameInfo reply_frame{};
+    reply_frame.id = frame_info.id;
+    reply_frame.trans_id = frame_info.trans_id;
+    if(def_handle)
+    {
+        EngineDefinition &definition = m_definitions[def_handle];
+        //what other processes wrote to the image is served, and written over, from here on
+        syncFromImage(def_handle, definition);
+        if(write_def_handle)
+        {
+            syncFromImage(write_def_handle, m_definitions[write_def_handle]);
+        }
+        quint16 *values = definition.values.data();
+        int offset = frame_info.reg_addr - definition.reg_def.reg_addr;
+        bool is_read = frame_info.function == ModbusReadCoils || frame_info.function == ModbusReadDescreteInputs ||
+                       frame_info.function == ModbusReadHoldingRegisters || frame_info.function == ModbusReadInputRegisters ||
+                       frame_info.function == ModbusReadWriteMultipleRegisters;
+        //simulated values are only worked out for the registers a master actually reads
+        if(is_read && !definition.generator.isEmpty() &&
+            definition.generator.evaluate(ModbusMasterEngine::instance()->now(), values, definition.values.size(), offset, frame_info.quantity))
+        {
+            ++definition.version;
+            //a wide value at the edge of the read may reach past it
+            publishValues(definition, 0, definition.values.size());
+            pendingView(def_handle).has_values = true;
+        }
+        reply_frame.function = frame_info.function;
+        reply_frame.reg_addr = frame_info.reg_addr;
+        reply_frame.quantity = frame_info.quantity;
+        if(frame_info.function == ModbusReadHoldingRegisters || frame_info.function == ModbusReadInputRegisters)
+        {
+            memcpy(reply_frame.reg_values, &values[offset], reply_frame.quantity * 2);
+        }
+        else if(frame_info.function == ModbusReadCoils || frame_info.function == ModbusReadDescreteInputs)
+        {
+            quint8 *coils = (quint8*)reply_frame.reg_values;
+            for(int i = 0;i < reply_frame.quantity;++i)
+            {
+                int byte_index = i / 8;
+                int bit_index = i % 8;
+                setBit(coils[byte_index], bit_index, values[offset + i]);
+            }
+        }
+        else if(frame_info.function == ModbusWriteSingleCoil)
+        {
+            reply_frame.reg_values[0] = frame_info.reg_values[0];
+            values[offset] = frame_info.reg_values[0] >> 8 & 0xFF ? 1 : 0;
+            ++definition.version;
+            publishValues(definition, offset, 1);
+            pendingView(def_handle).has_values = true;
+        }
+        else if(frame_info.function == ModbusWriteMultipleCoils)
+        {
+            for(int i = 0;i < frame_info.quantity;++i)
+            {
+                values[offset + i] = getBit(frame_info.reg_values[i / 16], i % 16);
+            }
+            ++definition.version;
+            publishValues(definition, offset, frame_info.quantity);
+            pendingView(def_handle).has_values = true;
+        }
+        else if(frame_info.function == ModbusWriteSingleRegister)
+        {
+            reply_frame.reg_values[0] = frame_info.reg_values[0];
+            values[offset] = frame_info.reg_values[0];
+            ++definition.version;
+            publishValues(definition, offset, 1);
+            pendingView(def_handle).has_values = true;
+        }
+        else if(frame_info.function == ModbusWriteMultipleRegisters)
+        {
+            memcpy(&values[offset], frame_info.reg_values, frame_info.quantity * 2);
+            ++definition.version;
+            publishValues(definition, offset, frame_info.quantity);
+            pendingView(def_handle).has_values = true;
+        }
+        else if(frame_info.function == ModbusMaskWriteRegister)
+        {
+            //the reply echoes the request, the bits outside the and mask come from the or mask
+            reply_frame.reg_values[0] = frame_info.reg_values[0];
+            reply_frame.reg_values[1] = frame_info.reg_values[1];
+            values[offset] = (values[offset] & frame_info.reg_values[0]) | (frame_info.reg_values[1] & ~frame_info.reg_values[0]);
+            ++definition.version;
+            publishValues(definition, offset, 1);
+            pendingView(def_handle).has_values = true;
+        }
+        else if(frame_info.function == ModbusReadWriteMultipleRegisters)
+        {
+            //the write is done first, the registers read back already hold the new values
+            EngineDefinition &write_definition = m_definitions[write_def_handle];
+            memcpy(write_definition.values.data() + frame_info.write_addr - write_definition.reg_def.reg_addr, frame_info.reg_values, frame_info.write_quantity * 2);
+            ++write_definition.version;
+            publishValues(write_definition, frame_info.write_addr - write_definition.reg_def.reg_addr, frame_info.write_quantity);
+            pendingView(write_def_handle).has_values = true;
+            memcpy(reply_frame.reg_values, &values[offset], reply_frame.quantity * 2);
+        }
+    }
+    else
+    {
+        reply_frame.function = frame_info.function + ModbusFunctionError;
+        reply_frame.reg_values[0] = error_code;
+    }
+    return reply_frame;
+}
+
+void ModbusEngine::publishValues(EngineDefinition &definition, int offset, int count)
+{
+    if(definition.image_index >= 0 && offset >= 0 && count > 0 && offset + count <= definition.values.size())
+    {
+        m_shared_image.write(definition.image_index, offset, definition.values.constData() + offset, count, definition.image_sequence);
+    }
+}
+
+void ModbusEngine::layoutImage()
+{
+    if(!m_shared_image.isOpen())
+    {
+        return;
+    }
+    QList<ModbusImageBlock> blocks;
+    for(const auto &x : m_definitions)
+    {
+        blocks.append(ModbusImageBlock{x.reg_def.id, x.reg_def.function, x.reg_def.reg_addr, x.reg_def.quantity});
+    }
+    QList<bool> kept;
+    QString error;
+    if(!m_shared_image.setLayout(blocks, kept, error))
+    {
+        setSharedImage(QString());
+        emit sharedImageFailed(error);
+        return;
+    }
+    int index{0};
+    for(auto it = m_definitions.begin(); it != m_definitions.end(); ++it, ++index)
+    {
+        EngineDefinition &definition = it.value();
+        definition.image_index = index;
+        if(kept[index])
+        {
+            //a block the image already had is served with the values found there
+            definition.image_sequence = m_shared_image.sequence(index) + 1;
+            syncFromImage(it.key(), definition);
+        }
+        else
+        {
+            definition.image_sequence = m_shared_image.sequence(index);
+            m_shared_image.write(index, 0, definition.values.constData(), definition.values.size(), definition.image_sequence);
+        }
+    }
+    m_image_change_sequence = m_shared_image.changeSequence();
+    m_image_timer->start();
+}
+
+void ModbusEngine::syncFromImage(quint32 def_handle, EngineDefinition &definition)
+{
+    if(definition.image_index < 0 || m_shared_image.sequence(definition.image_index) == definition.image_sequence)
+    {
+        return;
+    }
+    QVector<quint16> values(definition.values.size());
+    definition.image_sequence = m_shared_image.read(definition.image_index, 0, values.data(), values.size());
+    if(values == definition.values)
+    {
+        return;
+    }
+    definition.values = values;
+    ++definition.version;
+    pendingView(def_handle).has_values = true;
+}
+
+void ModbusEngine::imageTimerTimeoutSlot()
+{
+    quint32 change_sequence = m_shared_image.changeSequence();
+    if(change_sequence == m_image_change_sequence)
+    {
+        return;
+    }
+    m_image_change_sequence = change_sequence;
+    for(auto it = m_definitions.begin(); it != m_definitions.end(); ++it)
+    {
+        syncFromImage(it.key(), it.value());
+    }
+}
+
+ModbusViewUpdate &ModbusEngine::pendingView(quint32 def_handle)
+{
+    ModbusViewUpdate &view_update = m_pending_views[def_handle];
+    view_update.def_handle = def_handle;
+    scheduleFlush();
+    return view_update;
+}
+
+void ModbusEngine::scheduleFlush()
+{
+    if(!m_flush_timer->isActive())
+    {
+        m_flush_timer->start();
+    }
+}
+
+void ModbusEngine::reportWriteResult(int error_code)
+{
+    m_pending_updates.write_results.append(error_code);
+    scheduleFlush();
+}
+
+void ModbusEngine::reportError(quint32 def_handle, int error_code)
+{
+    m_pending_updates.error_codes.append(error_code);
+    scheduleFlush();
+    if(def_handle && m_definitions.contains(def_handle))
+    {
+        ModbusViewUpdate &view_update = pendingView(def_handle);
+        ++view_update.error_count;
+        view_update.has_error = true;
+        view_update.error_code = error_code;
+    }
+}
+
+void ModbusEngine::reportTraffic(const QString &direction, const QByteArray &pack, bool is_error)
+{
+    if(m_traffic_enabled)
+    {
+        m_pending_updates.traffic.append(qMakePair(QString("%1: %2").arg(direction, QString(pack.toHex(' ').toUpper())), is_error));
+        scheduleFlush();
+    }
+}
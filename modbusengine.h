@@ -0,0 +1,252 @@
+#ifndef MODBUSENGINE_H
+#define MODBUSENGINE_H
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QVector>
+#include <QByteArray>
+#include <QMetaType>
+#include <QPointer>
+#include <map>
+#include "ModbusFrameInfo.h"
+#include "addregdialog.h"
+#include "modbusscheduler.h"
+#include "modbuschangedetector.h"
+#include "modbusvaluegenerator.h"
+#include "modbusfaultinjector.h"
+#include "modbussharedimage.h"
+#include "modbuswritecombiner.h"
+
+class QIODevice;
+class QTimer;
+
+//what changed for one register view since the last batch
+struct ModbusViewUpdate
+{
+    quint32 def_handle{0};
+    bool has_values{false};
+    //only the registers that moved past their deadband since the last batch
+    QList<ModbusValueChange> changes;
+    quint32 send_count{0};
+    quint32 error_count{0};
+    //ModbusErrorCode_OK clears the view's error line
+    bool has_error{false};
+    int error_code{ModbusErrorCode_OK};
+};
+
+struct ModbusEngineUpdates
+{
+    QList<ModbusViewUpdate> views;
+    QList<int> write_results;
+    QList<int> error_codes;
+    //packet text and whether it is an exception reply
+    QList<QPair<QString, bool> > traffic;
+};
+
+Q_DECLARE_METATYPE(ModbusEngineUpdates)
+
+/*
+ * The protocol side of a modbus route: it owns the connections, the request queues and a
+ * copy of every register block, and runs on the thread of the process-wide master engine so
+ * that nothing the gui does can delay a reply or a timeout. Scans are due when the master
+ * engine says so and requests go out as soon as a connection is free, an idle route never
+ * wakes up. Register views are identified by a handle, the engine collects what changed and
+ * hands it over in one batch at a time.
+ * Every public function is meant to be called on the engine's thread.
+ */
+
+class ModbusEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum ChannelDispatch{
+        Dispatch_By_Load,
+        Dispatch_By_Unit_ID,
+    };
+    //how the blocks sharing a scan rate are placed within their period
+    enum ScanPhasing{
+        Phasing_Spread,
+        Phasing_Synchronized,
+    };
+
+public:
+    explicit ModbusEngine(bool is_master, int protocol, QObject *parent = nullptr);
+    ~ModbusEngine();
+    //attaches to the master engine and registers a master route, called once the engine is on its thread
+    void start();
+    void addChannel(QIODevice *com);
+    void setChannelDispatch(int dispatch);
+    void setRecvTimeout(int recv_timeout_ms);
+    void setSchedulerSettings(const ModbusSchedulerSettings &settings);
+    void setScanPhasing(int phasing);
+    void addDefinition(quint32 def_handle, const ModbusRegReadDefinitions &reg_def);
+    void modifyDefinition(quint32 def_handle, const ModbusRegReadDefinitions &reg_def);
+    //keeps the block and its values, only the cadence of its polls changes
+    void setScanRate(quint32 def_handle, quint32 scan_rate);
+    void removeDefinition(quint32 def_handle);
+    //registers edited in a view, only the ones given are written
+    void writeValues(quint32 def_handle, int offset, const QVector<quint16> &values);
+    void setDeadbands(quint32 def_handle, const QList<ModbusDeadband> &deadbands);
+    void setGenerators(quint32 def_handle, const QList<ModbusGenerator> &generators);
+    void setFaultSettings(const ModbusFaultSettings &settings);
+    //backs the blocks with a register image other processes can map, an empty name detaches it
+    void setSharedImage(const QString &file_name);
+    void write(const QByteArray &pack);
+    void setTrafficEnabled(bool enabled);
+    //hands the connections to someone else, the request in flight is queued again
+    void pause();
+    void resume();
+    void shutdown();
+    //called by the master engine, a handle whose generation is outdated is ignored
+    void scanDue(quint32 def_handle, quint32 generation);
+    //sends on every idle connection as long as there is something queued for it
+    void dispatchRequests();
+
+signals:
+    void updatesReady(const ModbusEngineUpdates &updates);
+    void sharedImageFailed(const QString &error);
+
+private slots:
+    void flushTimerTimeoutSlot();
+    void combineTimerTimeoutSlot();
+    void replyTimerTimeoutSlot();
+    void imageTimerTimeoutSlot();
+    void comSlaveReadyReadSlot();
+    void comDisconnectedSlot();
+    void comConnectFinishedSlot(bool connected);
+
+private:
+    //one connection of a master route with its own request in flight
+    struct MasterChannel
+    {
+        QIODevice *com{nullptr};
+        QTimer *recv_timer{nullptr};
+        QByteArray recv_buffer;
+        ModbusRequest request;
+        ModbusFrameInfo last_send_frame;
+        bool busy{false};
+        bool link_up{true};
+        //a broadcast is in flight, the timer is its turnaround and no reply is expected
+        bool broadcast{false};
+    };
+
+    //a slave reply held back by the fault injector, the connection may be gone when it is due
+    struct PendingReply
+    {
+        QPointer<QIODevice> com;
+        QByteArray pack;
+        bool is_error{false};
+    };
+
+    struct EngineDefinition
+    {
+        ModbusRegReadDefinitions reg_def;
+        QVector<quint16> values;
+        ModbusChangeDetector change_detector;
+        ModbusValueGenerator generator;
+        qint64 next_scan_ms{0};
+        //bumped whenever the block changes, so scans scheduled for the old one are dropped
+        quint32 generation{0};
+        //the scan came due while the last poll was still pending
+        bool scan_overdue{false};
+        //bumped on every change of the values, a cached reply of an older version is stale
+        quint32 version{0};
+        //where the block is in the shared image, and the block sequence the values were last in step with
+        int image_index{-1};
+        quint32 image_sequence{0};
+    };
+
+    //the encoded reply to a read request, sent again as long as its block is unchanged
+    struct CachedReply
+    {
+        quint32 def_handle{0};
+        quint32 version{0};
+        QByteArray pack;
+    };
+
+private:
+    MasterChannel *createChannel(QIODevice *com);
+    MasterChannel *findChannel(QObject *com) const;
+    void removeChannel(MasterChannel *channel);
+    void addSlaveConnection(QIODevice *com);
+    bool acceptsRequest(MasterChannel *channel, const ModbusRequest &request) const;
+    bool isPollPending(quint32 def_handle) const;
+    void scheduleFirstScan(quint32 def_handle);
+    void phaseScanGroup(quint32 scan_rate);
+    void enqueuePoll(quint32 def_handle);
+    void enqueueWrite(const QByteArray &pack);
+    void enqueueCombinedWrites();
+    void pollFinished(quint32 def_handle);
+    void sendNextRequest(MasterChannel *channel);
+    void fuseReadWrite(ModbusRequest &request);
+    bool isBroadcast(const ModbusFrameInfo &frame_info) const;
+    QByteArray masterPack(const ModbusFrameInfo &frame_info) const;
+    //the FC06 request that writes the result of an FC22 request to the last polled value, empty when no poll covers it
+    QByteArray singleWriteForMask(const ModbusFrameInfo &frame_info) const;
+    void requeueRequest(MasterChannel *channel);
+    void channelRecvTimeout(MasterChannel *channel);
+    void channelReadyRead(MasterChannel *channel);
+    int requestUnitId(const QByteArray &pack) const;
+    ModbusFrameInfo requestFrame(const QByteArray &pack) const;
+    static qint64 slavePackLength(int protocol, const char *data, qint64 size);
+    void slaveRequestReceived(QIODevice *com, const QByteArray &request_pack);
+    quint32 getSlaveDefinition(int id, int function, int reg_addr, int quantity, ModbusErrorCode &error_code) const;
+    void processMasterFrame(const ModbusFrameInfo &frame_info, MasterChannel *channel);
+    void processSlaveFrame(const ModbusFrameInfo &frame_info, QIODevice *com, const QByteArray &request_pack, const ModbusFaultPlan &fault_plan);
+    bool replyFromCache(QIODevice *com, const QByteArray &request_pack, const ModbusFaultPlan &fault_plan);
+    QByteArray replyCacheKey(const QByteArray &request_pack) const;
+    ModbusFrameInfo slaveReply(const ModbusFrameInfo &frame_info);
+    void sendSlaveReply(QIODevice *com, const QByteArray &pack, bool is_error, qint64 delay_ms, bool fragment);
+    void publishValues(EngineDefinition &definition, int offset, int count);
+    void layoutImage();
+    void syncFromImage(quint32 def_handle, EngineDefinition &definition);
+    ModbusViewUpdate &pendingView(quint32 def_handle);
+    void scheduleFlush();
+    void reportWriteResult(int error_code);
+    void reportError(quint32 def_handle, int error_code);
+    void reportTraffic(const QString &direction, const QByteArray &pack, bool is_error);
+
+private:
+    bool m_is_master;
+    int m_protocol;
+    QList<MasterChannel*> m_channels;
+    //a slave answers on the connection a request came in on, every connection shares the register image
+    QList<QIODevice*> m_slave_coms;
+    QMap<QIODevice*, QByteArray> m_slave_recv_buffers;
+    ModbusFaultInjector m_fault_injector;
+    //keyed by the request pack, the transaction id of a TCP request is left out
+    QHash<QByteArray, CachedReply> m_reply_cache;
+    //due time on the master engine's clock, a multimap keeps replies due at the same time in order
+    std::multimap<qint64, PendingReply> m_pending_replies;
+    QTimer *m_reply_timer;
+    int m_channel_dispatch;
+    QMap<quint32, EngineDefinition> m_definitions;
+    ModbusSharedImage m_shared_image;
+    //looks for writes of other processes, a request brings its own block up to date at once
+    QTimer *m_image_timer;
+    quint32 m_image_change_sequence;
+    ModbusScheduler m_scheduler;
+    //units that answered FC23 with an illegal function, their block writes are not fused again
+    QSet<int> m_no_fuse_units;
+    //units that answered FC22 with an illegal function, their bit edits go out as FC06
+    QSet<int> m_no_mask_write_units;
+    ModbusWriteCombiner m_write_combiner;
+    QTimer *m_combine_timer;
+    quint64 m_route_id;
+    quint32 m_next_generation;
+    int m_scan_phasing;
+    QTimer *m_flush_timer;
+    int m_recv_timeout_ms;
+    quint16 m_trans_id;
+    bool m_paused;
+    bool m_traffic_enabled;
+    QMap<quint32, ModbusViewUpdate> m_pending_views;
+    ModbusEngineUpdates m_pending_updates;
+};
+
+#endif // MODBUSENGINE_H
@@ -0,0 +1,100 @@
+#include "modbusfaultinjector.h"
+#include <QtMath>
+#include <QRandomGenerator>
+#include "openroutedialog.h"
+#include "ModbusFrameInfo.h"
+
+void ModbusFaultInjector::setSettings(const ModbusFaultSettings &settings)
+{
+    m_settings = settings;
+    m_active = settings.delay_ms > 0 || settings.jitter_ms > 0 || settings.busy_rate > 0 || settings.gateway_rate > 0 ||
+               settings.drop_rate > 0 || settings.corrupt_rate > 0 || settings.fragment_rate > 0;
+}
+
+ModbusFaultSettings ModbusFaultInjector::settings() const
+{
+    return m_settings;
+}
+
+bool ModbusFaultInjector::isActive() const
+{
+    return m_active;
+}
+
+ModbusFaultPlan ModbusFaultInjector::plan() const
+{
+    ModbusFaultPlan fault_plan;
+    if(!m_active)
+    {
+        return fault_plan;
+    }
+    double roll = percent();
+    if(roll < m_settings.busy_rate)
+    {
+        fault_plan.exception_code = ModbusErrorCode_Slave_Device_Busy;
+    }
+    else if(roll < m_settings.busy_rate + m_settings.gateway_rate)
+    {
+        fault_plan.exception_code = ModbusErrorCode_Gateway_Target_Device_Failed_To_Respond;
+    }
+    else if(roll < m_settings.busy_rate + m_settings.gateway_rate + m_settings.drop_rate)
+    {
+        fault_plan.drop = true;
+    }
+    fault_plan.corrupt = percent() < m_settings.corrupt_rate;
+    fault_plan.fragment = percent() < m_settings.fragment_rate;
+    fault_plan.delay_ms = delay();
+    return fault_plan;
+}
+
+QByteArray ModbusFaultInjector::corrupt(int protocol, const QByteArray &pack)
+{
+    QByteArray ret = pack;
+    if(ret.isEmpty())
+    {
+        return ret;
+    }
+    if(protocol == MODBUS_ASCII && ret.size() > 3)
+    {
+        //the lrc is the last hex digit pair before CR LF, changing a digit keeps the frame readable
+        char &digit = ret[ret.size() - 3];
+        digit = digit == '0' ? '1' : '0';
+    }
+    else
+    {
+        ret[ret.size() - 1] = ret[ret.size() - 1] ^ 0xFF;
+    }
+    return ret;
+}
+
+qint64 ModbusFaultInjector::delay() const
+{
+    double delay_ms = m_settings.delay_ms;
+    double jitter_ms = m_settings.jitter_ms;
+    QRandomGenerator *generator = QRandomGenerator::global();
+    switch(m_settings.distribution)
+    {
+    case Delay_Uniform:
+        delay_ms += (generator->generateDouble() * 2 - 1) * jitter_ms;
+        break;
+    case Delay_Normal:
+    {
+        //Box-Muller, 1 - u keeps the logarithm away from 0
+        double u1 = 1 - generator->generateDouble();
+        double u2 = generator->generateDouble();
+        delay_ms += jitter_ms * qSqrt(-2 * qLn(u1)) * qCos(2 * M_PI * u2);
+        break;
+    }
+    case Delay_Exponential:
+        delay_ms += -jitter_ms * qLn(1 - generator->generateDouble());
+        break;
+    default:
+        break;
+    }
+    return qMax<qint64>(0, qRound64(delay_ms));
+}
+
+double ModbusFaultInjector::percent() const
+{
+    return QRandomGenerator::global()->generateDouble() * 100;
+}
@@ -0,0 +1,68 @@
+#ifndef MODBUSFAULTINJECTOR_H
+#define MODBUSFAULTINJECTOR_H
+
+#include <QByteArray>
+
+struct ModbusFaultSettings
+{
+    //a ModbusFaultInjector::DelayDistribution
+    int distribution{0};
+    int delay_ms{0};
+    //the spread of the delay, the standard deviation of a normal one and the mean tail of an exponential one
+    int jitter_ms{0};
+    //percent of the requests answered with each fault
+    double busy_rate{0};
+    double gateway_rate{0};
+    double drop_rate{0};
+    double corrupt_rate{0};
+    double fragment_rate{0};
+    //the pause in the middle of a fragmented reply
+    int fragment_gap_ms{5};
+};
+
+//what is done to the reply of one request
+struct ModbusFaultPlan
+{
+    //an exception code answered instead of the reply, 0 for none
+    int exception_code{0};
+    bool drop{false};
+    bool corrupt{false};
+    bool fragment{false};
+    qint64 delay_ms{0};
+};
+
+/*
+ * Makes a simulated slave behave like a real device. Every request draws a plan: how long the
+ * reply is held back, and whether it is replaced by a busy or gateway exception, lost, sent with
+ * a broken checksum or split in two with a pause in between. The exceptions and the lost reply
+ * exclude each other, the other faults are drawn on their own.
+ */
+
+class ModbusFaultInjector
+{
+public:
+    enum DelayDistribution{
+        Delay_Fixed,
+        Delay_Uniform,
+        Delay_Normal,
+        Delay_Exponential,
+    };
+
+public:
+    void setSettings(const ModbusFaultSettings &settings);
+    ModbusFaultSettings settings() const;
+    bool isActive() const;
+    ModbusFaultPlan plan() const;
+    //the pack with its checksum broken, a TCP pack has none and gets its last byte flipped
+    static QByteArray corrupt(int protocol, const QByteArray &pack);
+
+private:
+    qint64 delay() const;
+    double percent() const;
+
+private:
+    ModbusFaultSettings m_settings;
+    bool m_active{false};
+};
+
+#endif // MODBUSFAULTINJECTOR_H
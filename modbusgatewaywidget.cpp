@@ -0,0 +1,263 @@
+#include "modbusgatewaywidget.h"
+#include "ui_modbusgatewaywidget.h"
+#include <QTimer>
+#include <QDebug>
+#include <QTableWidgetItem>
+#include "mytcpsocket.h"
+#include "modbus_rtu.h"
+#include "modbus_tcp.h"
+#include "openroutedialog.h"
+#include "utils.h"
+
+#define PRINT_TRAFFIC 0
+
+enum GatewayClientColumns{
+    Column_Client,
+    Column_Queued,
+    Column_Requests,
+    Column_Responses,
+    Column_Timeouts,
+};
+
+ModbusGatewayWidget::ModbusGatewayWidget(MyTcpSocket *server, QIODevice *com, QWidget *parent)
+    : ProtocolWidget(com, MODBUS_RTU, parent)
+    , ui(new Ui::ModbusGatewayWidget), m_server(server), m_next_client(0), m_busy_client(nullptr)
+    , m_bus_busy(false), m_recv_timeout_ms(300), m_max_queued_requests(32)
+{
+    ui->setupUi(this);
+    m_recv_timer = new QTimer(this);
+    m_recv_timer->setSingleShot(true);
+    connect(m_recv_timer, &QTimer::timeout, this, &ModbusGatewayWidget::recvTimerTimeoutSlot);
+    connect(m_com, &QIODevice::readyRead, this, &ModbusGatewayWidget::comReadyReadSlot);
+    connect(m_server, &MyTcpSocket::newConnectionIncoming, this, &ModbusGatewayWidget::newClientIncoming);
+}
+
+ModbusGatewayWidget::~ModbusGatewayWidget()
+{
+    qDeleteAll(m_clients);
+    delete ui;
+}
+
+void ModbusGatewayWidget::closeEvent(QCloseEvent *event)
+{
+    for(auto x : m_clients)
+    {
+        x->socket->deleteLater();
+    }
+    m_server->deleteLater();
+    ProtocolWidget::closeEvent(event);
+}
+
+void ModbusGatewayWidget::newClientIncoming(MyTcpSocket *client)
+{
+    GatewayClient *gateway_client = new GatewayClient;
+    gateway_client->socket = client;
+    m_clients.append(gateway_client);
+    connect(client, &QIODevice::readyRead, this, &ModbusGatewayWidget::clientReadyReadSlot);
+    connect(client, &MyTcpSocket::disconnectedFromHost, this, &ModbusGatewayWidget::clientDisconnectedSlot);
+    int row = ui->table_clients->rowCount();
+    ui->table_clients->insertRow(row);
+    ui->table_clients->setItem(row, Column_Client, new QTableWidgetItem(QString("%1:%2").arg(client->peerAddress()).arg(client->peerPort())));
+    for(int i = Column_Queued; i <= Column_Timeouts; ++i)
+    {
+        ui->table_clients->setItem(row, i, new QTableWidgetItem("0"));
+    }
+}
+
+void ModbusGatewayWidget::clientReadyReadSlot()
+{
+    GatewayClient *client = findClient(sender());
+    if(!client)
+    {
+        return;
+    }
+    client->recv_buffer.append(client->socket->readAll());
+    qint64 pack_size{0};
+    while((pack_size = Modbus_TCP::slavePackLength(client->recv_buffer.constData(), client->recv_buffer.size())) != 0)
+    {
+        if(pack_size < 0)
+        {
+            client->recv_buffer.remove(0, -pack_size);
+            continue;
+        }
+        QByteArray request = client->recv_buffer.left(pack_size);
+        client->recv_buffer.remove(0, pack_size);
+        if(request.size() < 8)
+        {
+            continue;
+        }
+        ++client->request_count;
+        if(client->requests.size() >= m_max_queued_requests)
+        {
+            //answer for the bus instead of letting one client's backlog grow without bound
+            QByteArray response = request.left(8);
+            response[5] = 3;
+            response[7] = quint8(request[7]) | ModbusFunctionError;
+            response.append(quint8(ModbusErrorCode_Slave_Device_Busy));
+            client->socket->write(response);
+            continue;
+        }
+        client->requests.append(request);
+    }
+    //the mbap length never exceeds 254, anything longer is not modbus-tcp
+    if(client->recv_buffer.size() >= 6 && (quint8(client->recv_buffer[4]) << 8 | quint8(client->recv_buffer[5])) > 254)
+    {
+        client->recv_buffer.clear();
+    }
+    updateClientRow(client);
+    if(!m_bus_busy)
+    {
+        sendNextRequest();
+    }
+}
+
+void ModbusGatewayWidget::clientDisconnectedSlot()
+{
+    GatewayClient *client = findClient(sender());
+    if(!client)
+    {
+        return;
+    }
+    int row = m_clients.indexOf(client);
+    m_clients.removeAt(row);
+    ui->table_clients->removeRow(row);
+    if(m_next_client > row)
+    {
+        --m_next_client;
+    }
+    if(m_busy_client == client)
+    {
+        //the bus still owes an answer, it is read and dropped to keep the bus in step
+        m_busy_client = nullptr;
+    }
+    client->socket->deleteLater();
+    delete client;
+}
+
+void ModbusGatewayWidget::comReadyReadSlot()
+{
+    m_recv_buffer.append(m_com->readAll());
+    if(!m_bus_busy)
+    {
+        m_recv_buffer.clear();
+        return;
+    }
+    qint64 pack_size{0};
+    while((pack_size = Modbus_RTU::masterPackLength(m_recv_buffer.constData(), m_recv_buffer.size())) < 0)
+    {
+        m_recv_buffer.remove(0, -pack_size);
+    }
+    if(pack_size == 0)
+    {
+        return;
+    }
+    if(m_recv_buffer[0] != m_busy_request[6])
+    {
+        m_recv_buffer.clear();
+        return;
+    }
+#if PRINT_TRAFFIC
+    qDebug()<<"Gateway Bus Recv: "<<m_recv_buffer.left(pack_size).toHex(' ').toUpper();
+#endif
+    m_recv_timer->stop();
+    if(m_busy_client)
+    {
+        ++m_busy_client->response_count;
+    }
+    finishRequest(m_recv_buffer.mid(1, pack_size - 3));
+}
+
+void ModbusGatewayWidget::recvTimerTimeoutSlot()
+{
+    if(!m_bus_busy)
+    {
+        return;
+    }
+    QByteArray pdu;
+    pdu.append(quint8(m_busy_request[7]) | ModbusFunctionError);
+    pdu.append(quint8(ModbusErrorCode_Gateway_Target_Device_Failed_To_Respond));
+    if(m_busy_client)
+    {
+        ++m_busy_client->timeout_count;
+    }
+    finishRequest(pdu);
+}
+
+ModbusGatewayWidget::GatewayClient *ModbusGatewayWidget::findClient(QObject *socket) const
+{
+    for(auto x : m_clients)
+    {
+        if(x->socket == socket)
+        {
+            return x;
+        }
+    }
+    return nullptr;
+}
+
+void ModbusGatewayWidget::sendNextRequest()
+{
+    //round robin over the clients, one request each, so a busy client cannot starve the others
+    for(int i = 0; i < m_clients.size(); ++i)
+    {
+        int index = (m_next_client + i) % m_clients.size();
+        GatewayClient *client = m_clients[index];
+        if(client->requests.isEmpty())
+        {
+            continue;
+        }
+        m_next_client = (index + 1) % m_clients.size();
+        m_busy_client = client;
+        m_busy_request = client->requests.takeFirst();
+        QByteArray pack = m_busy_request.mid(6);
+        quint16 crc_value = CRC_16(pack, pack.size());
+        pack.append(quint8(crc_value & 0xFF));
+        pack.append(quint8(crc_value >> 8 & 0xFF));
+#if PRINT_TRAFFIC
+        qDebug()<<"Gateway Bus Send: "<<pack.toHex(' ').toUpper();
+#endif
+        m_recv_buffer.clear();
+        m_com->write(pack);
+        updateClientRow(client);
+        if(m_busy_request[6] == 0)
+        {
+            //a broadcast is never answered, the bus is free as soon as it is written
+            m_busy_client = nullptr;
+            sendNextRequest();
+            return;
+        }
+        m_bus_busy = true;
+        m_recv_timer->start(m_recv_timeout_ms);
+        return;
+    }
+    m_busy_client = nullptr;
+}
+
+void ModbusGatewayWidget::finishRequest(const QByteArray &pdu)
+{
+    if(m_busy_client)
+    {
+        QByteArray response = m_busy_request.left(7);
+        response[4] = quint8((pdu.size() + 1) >> 8 & 0xFF);
+        response[5] = quint8((pdu.size() + 1) & 0xFF);
+        response.append(pdu);
+        m_busy_client->socket->write(response);
+        updateClientRow(m_busy_client);
+    }
+    m_recv_buffer.clear();
+    m_bus_busy = false;
+    sendNextRequest();
+}
+
+void ModbusGatewayWidget::updateClientRow(GatewayClient *client)
+{
+    int row = m_clients.indexOf(client);
+    if(row < 0)
+    {
+        return;
+    }
+    ui->table_clients->item(row, Column_Queued)->setText(QString::number(client->requests.size()));
+    ui->table_clients->item(row, Column_Requests)->setText(QString::number(client->request_count));
+    ui->table_clients->item(row, Column_Responses)->setText(QString::number(client->response_count));
+    ui->table_clients->item(row, Column_Timeouts)->setText(QString::number(client->timeout_count));
+}
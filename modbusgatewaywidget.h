@@ -0,0 +1,70 @@
+#ifndef MODBUSGATEWAYWIDGET_H
+#define MODBUSGATEWAYWIDGET_H
+
+#include "protocolwidget.h"
+#include <QList>
+#include <QByteArray>
+
+namespace Ui {
+class ModbusGatewayWidget;
+}
+
+class QTimer;
+class MyTcpSocket;
+
+/*
+ * Bridges modbus-tcp clients onto one modbus-rtu bus. Each client has its own
+ * request queue and the bus takes one request per client in turn.
+ */
+
+class ModbusGatewayWidget : public ProtocolWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ModbusGatewayWidget(MyTcpSocket *server, QIODevice *com, QWidget *parent = nullptr);
+    ~ModbusGatewayWidget();
+
+private slots:
+    void newClientIncoming(MyTcpSocket *client);
+    void clientReadyReadSlot();
+    void clientDisconnectedSlot();
+    void comReadyReadSlot();
+    void recvTimerTimeoutSlot();
+
+protected:
+    void closeEvent(QCloseEvent *event) override;
+
+private:
+    struct GatewayClient
+    {
+        MyTcpSocket *socket{nullptr};
+        QByteArray recv_buffer;
+        QList<QByteArray> requests;
+        quint64 request_count{0};
+        quint64 response_count{0};
+        quint64 timeout_count{0};
+    };
+
+private:
+    GatewayClient *findClient(QObject *socket) const;
+    void sendNextRequest();
+    void finishRequest(const QByteArray &pdu);
+    void updateClientRow(GatewayClient *client);
+
+private:
+    Ui::ModbusGatewayWidget *ui;
+    MyTcpSocket *m_server;
+    QList<GatewayClient*> m_clients;
+    int m_next_client;
+    //the request on the bus, kept as the tcp adu so the reply can reuse its header
+    GatewayClient *m_busy_client;
+    QByteArray m_busy_request;
+    bool m_bus_busy;
+    QByteArray m_recv_buffer;
+    QTimer *m_recv_timer;
+    int m_recv_timeout_ms;
+    int m_max_queued_requests;
+};
+
+#endif // MODBUSGATEWAYWIDGET_H
@@ -0,0 +1,173 @@
+#include "modbusmasterengine.h"
+#include <QThread>
+#include <QTimer>
+#include <QCoreApplication>
+#include "modbusengine.h"
+
+ModbusMasterEngine *ModbusMasterEngine::instance()
+{
+    //a function local static is set up exactly once, whichever thread asks first
+    static ModbusMasterEngine *master_engine = [](){
+        QThread *thread = new QThread();
+        ModbusMasterEngine *engine = new ModbusMasterEngine();
+        engine->m_thread = thread;
+        engine->moveToThread(thread);
+        //the routes close their connections on the thread before it ends, the widgets are too late for that
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, qApp, [engine, thread](){
+            QMetaObject::invokeMethod(engine, [engine](){
+                engine->shutdownEngines();
+            }, Qt::BlockingQueuedConnection);
+            thread->quit();
+            thread->wait();
+        });
+        thread->start();
+        return engine;
+    }();
+    return master_engine;
+}
+
+ModbusMasterEngine::ModbusMasterEngine(QObject *parent)
+    : QObject{parent}, m_thread(nullptr), m_next_route_id(1)
+{
+    m_wake_timer = new QTimer(this);
+    m_wake_timer->setSingleShot(true);
+    m_wake_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_wake_timer, &QTimer::timeout, this, &ModbusMasterEngine::wakeTimerTimeoutSlot);
+    m_clock.start();
+}
+
+QThread *ModbusMasterEngine::engineThread() const
+{
+    return m_thread;
+}
+
+void ModbusMasterEngine::attachEngine(ModbusEngine *engine)
+{
+    if(!m_engines.contains(engine))
+    {
+        m_engines.append(engine);
+    }
+}
+
+void ModbusMasterEngine::detachEngine(ModbusEngine *engine)
+{
+    m_engines.removeOne(engine);
+}
+
+void ModbusMasterEngine::shutdownEngines()
+{
+    //shutting an engine down detaches it, the list is emptied first
+    QList<ModbusEngine*> engines = m_engines;
+    m_engines.clear();
+    for(auto x : engines)
+    {
+        x->shutdown();
+    }
+}
+
+quint64 ModbusMasterEngine::registerRoute(ModbusEngine *engine)
+{
+    quint64 route_id = m_next_route_id++;
+    m_routes.insert(route_id, engine);
+    return route_id;
+}
+
+void ModbusMasterEngine::unregisterRoute(quint64 route_id)
+{
+    m_routes.remove(route_id);
+    for(auto it = m_scan_generations.begin(); it != m_scan_generations.end();)
+    {
+        if(it.key().first == route_id)
+        {
+            it = m_scan_generations.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    dropStaleScans();
+}
+
+void ModbusMasterEngine::scheduleScan(quint64 route_id, quint32 def_handle, quint32 generation, qint64 due_ms)
+{
+    bool earliest = m_scan_queue.empty() || due_ms < m_scan_queue.top().due_ms;
+    m_scan_queue.push(ScanEntry{due_ms, route_id, def_handle, generation});
+    //a block scheduled again leaves its earlier entry behind
+    m_scan_generations.insert(qMakePair(route_id, def_handle), generation);
+    dropStaleScans();
+    if(earliest)
+    {
+        armWakeTimer();
+    }
+}
+
+qint64 ModbusMasterEngine::now() const
+{
+    return m_clock.elapsed();
+}
+
+void ModbusMasterEngine::wakeTimerTimeoutSlot()
+{
+    qint64 now_ms = now();
+    QList<ModbusEngine*> due_engines;
+    while(!m_scan_queue.empty() && m_scan_queue.top().due_ms <= now_ms)
+    {
+        ScanEntry entry = m_scan_queue.top();
+        m_scan_queue.pop();
+        auto key = qMakePair(entry.route_id, entry.def_handle);
+        auto generation = m_scan_generations.find(key);
+        if(generation == m_scan_generations.end() || generation.value() != entry.generation)
+        {
+            continue;
+        }
+        //the engine schedules the next scan itself if the block is still there
+        m_scan_generations.erase(generation);
+        ModbusEngine *engine = m_routes.value(entry.route_id);
+        if(engine)
+        {
+            engine->scanDue(entry.def_handle, entry.generation);
+            if(!due_engines.contains(engine))
+            {
+                due_engines.append(engine);
+            }
+        }
+    }
+    //every scan due now is queued before anything is sent, so the priority classes decide the order
+    for(auto x : due_engines)
+    {
+        x->dispatchRequests();
+    }
+    armWakeTimer();
+}
+
+void ModbusMasterEngine::dropStaleScans()
+{
+    //a group phased again pushes a new entry for each of its blocks, left alone the dead ones would pile up
+    if(m_scan_queue.size() <= size_t(2 * m_scan_generations.size() + 16))
+    {
+        return;
+    }
+    std::vector<ScanEntry> entries;
+    entries.reserve(m_scan_generations.size());
+    while(!m_scan_queue.empty())
+    {
+        const ScanEntry &entry = m_scan_queue.top();
+        if(m_scan_generations.value(qMakePair(entry.route_id, entry.def_handle)) == entry.generation)
+        {
+            entries.push_back(entry);
+        }
+        m_scan_queue.pop();
+    }
+    m_scan_queue = std::priority_queue<ScanEntry, std::vector<ScanEntry>, std::greater<ScanEntry> >(std::greater<ScanEntry>(), std::move(entries));
+}
+
+void ModbusMasterEngine::armWakeTimer()
+{
+    if(m_scan_queue.empty())
+    {
+        m_wake_timer->stop();
+        return;
+    }
+    m_wake_timer->start(int(qMax<qint64>(0, m_scan_queue.top().due_ms - now())));
+}
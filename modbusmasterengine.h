@@ -0,0 +1,79 @@
+#ifndef MODBUSMASTERENGINE_H
+#define MODBUSMASTERENGINE_H
+
+#include <QObject>
+#include <QMap>
+#include <QList>
+#include <QHash>
+#include <QPair>
+#include <QElapsedTimer>
+#include <queue>
+#include <vector>
+#include <functional>
+
+class QThread;
+class QTimer;
+class ModbusEngine;
+
+/*
+ * Drives every modbus route of the process from one thread. The engines of all routes live
+ * on it, and the scans of every register definition wait in one queue ordered by due time.
+ * A single timer is armed for the earliest of them, so an idle process does not wake up at
+ * all and a hundred routes cost no more timers than one.
+ * Apart from instance() every function is meant to be called on the engine thread.
+ * When the application quits, every engine still attached is shut down before the thread ends.
+ */
+
+class ModbusMasterEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ModbusMasterEngine *instance();
+    QThread *engineThread() const;
+    //every engine on the thread, master or slave, so it can be shut down when the application quits
+    void attachEngine(ModbusEngine *engine);
+    void detachEngine(ModbusEngine *engine);
+    quint64 registerRoute(ModbusEngine *engine);
+    void unregisterRoute(quint64 route_id);
+    void scheduleScan(quint64 route_id, quint32 def_handle, quint32 generation, qint64 due_ms);
+    //milliseconds on the clock every due time is measured against
+    qint64 now() const;
+
+private slots:
+    void wakeTimerTimeoutSlot();
+
+private:
+    struct ScanEntry
+    {
+        qint64 due_ms;
+        quint64 route_id;
+        quint32 def_handle;
+        quint32 generation;
+        bool operator>(const ScanEntry &other) const
+        {
+            return due_ms > other.due_ms;
+        }
+    };
+
+private:
+    explicit ModbusMasterEngine(QObject *parent = nullptr);
+    void shutdownEngines();
+    void armWakeTimer();
+    void dropStaleScans();
+
+private:
+    QThread *m_thread;
+    QTimer *m_wake_timer;
+    QElapsedTimer m_clock;
+    quint64 m_next_route_id;
+    QMap<quint64, ModbusEngine*> m_routes;
+    QList<ModbusEngine*> m_engines;
+    //entries of removed routes or changed definitions are dropped when they come up,
+    //or all at once when they outnumber the live ones
+    std::priority_queue<ScanEntry, std::vector<ScanEntry>, std::greater<ScanEntry> > m_scan_queue;
+    //the generation of the entry still queued for a block, by route and definition handle
+    QHash<QPair<quint64, quint32>, quint32> m_scan_generations;
+};
+
+#endif // MODBUSMASTERENGINE_H
@@ -0,0 +1,151 @@
+#include "modbusscandialog.h"
+#include "ui_modbusscandialog.h"
+#include "addregdialog.h"
+#include "modbus_rtu.h"
+#include "modbus_ascii.h"
+#include "modbus_tcp.h"
+#include "openroutedialog.h"
+#include <QThread>
+
+ModbusScanDialog::ModbusScanDialog(const QList<QIODevice*> &coms, int protocol, QThread *com_thread, QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::ModbusScanDialog), m_coms(coms), m_protocol(protocol), m_com_thread(com_thread), m_scanner(nullptr)
+{
+    ui->setupUi(this);
+    ui->button_stop->setEnabled(false);
+    ui->button_add_definitions->setEnabled(false);
+    if(m_protocol != MODBUS_TCP && m_protocol != MODBUS_UDP)
+    {
+        //a serial bus carries one request at a time
+        ui->box_concurrency->setValue(1);
+        ui->box_concurrency->setEnabled(false);
+    }
+}
+
+ModbusScanDialog::~ModbusScanDialog()
+{
+    releaseScanner();
+    delete ui;
+}
+
+void ModbusScanDialog::releaseScanner()
+{
+    if(!m_scanner)
+    {
+        return;
+    }
+    disconnect(m_scanner, nullptr, this, nullptr);
+    QMetaObject::invokeMethod(m_scanner, &ModbusScanner::stop, Qt::QueuedConnection);
+    m_scanner->deleteLater();
+    m_scanner = nullptr;
+}
+
+void ModbusScanDialog::on_button_start_clicked()
+{
+    ModbusScanner::ScanSettings settings;
+    settings.first_id = ui->box_first_id->value();
+    settings.last_id = qMax(ui->box_first_id->value(), ui->box_last_id->value());
+    if(ui->box_coils->isChecked())
+    {
+        settings.functions.append(ModbusReadCoils);
+    }
+    if(ui->box_discrete_inputs->isChecked())
+    {
+        settings.functions.append(ModbusReadDescreteInputs);
+    }
+    if(ui->box_holding_registers->isChecked())
+    {
+        settings.functions.append(ModbusReadHoldingRegisters);
+    }
+    if(ui->box_input_registers->isChecked())
+    {
+        settings.functions.append(ModbusReadInputRegisters);
+    }
+    settings.first_addr = ui->box_first_addr->value();
+    settings.last_addr = qMax(ui->box_first_addr->value(), ui->box_last_addr->value());
+    settings.resolution = ui->box_resolution->value();
+    settings.max_timeout_ms = ui->box_timeout->value();
+    settings.concurrency = ui->box_concurrency->value();
+
+    releaseScanner();
+    m_scanner = new ModbusScanner(m_coms, m_protocol, settings);
+    m_scanner->moveToThread(m_com_thread);
+    connect(m_scanner, &ModbusScanner::unitFound, this, &ModbusScanDialog::scannerUnitFound);
+    connect(m_scanner, &ModbusScanner::progressChanged, this, &ModbusScanDialog::scannerProgressChanged);
+    connect(m_scanner, &ModbusScanner::finished, this, &ModbusScanDialog::scannerFinished);
+    ui->list_results->clear();
+    ui->button_start->setEnabled(false);
+    ui->button_stop->setEnabled(true);
+    ui->button_add_definitions->setEnabled(false);
+    QMetaObject::invokeMethod(m_scanner, &ModbusScanner::start, Qt::QueuedConnection);
+}
+
+void ModbusScanDialog::on_button_stop_clicked()
+{
+    if(m_scanner)
+    {
+        QMetaObject::invokeMethod(m_scanner, &ModbusScanner::stop, Qt::QueuedConnection);
+    }
+}
+
+void ModbusScanDialog::on_button_add_definitions_clicked()
+{
+    //a definition holds at most a byte of quantity, longer ranges are split
+    for(const auto &x : m_found_ranges)
+    {
+        int max_quantity = x.function == ModbusReadCoils || x.function == ModbusReadDescreteInputs ? 248 : 125;
+        for(int offset = 0; offset < x.quantity; offset += max_quantity)
+        {
+            ModbusFrameInfo frame_info;
+            frame_info.id = x.id;
+            frame_info.function = x.function;
+            frame_info.reg_addr = x.reg_addr + offset;
+            frame_info.quantity = qMin(max_quantity, x.quantity - offset);
+            ModbusRegReadDefinitions *def = new ModbusRegReadDefinitions;
+            def->is_master = true;
+            def->id = frame_info.id;
+            def->function = frame_info.function;
+            def->reg_addr = frame_info.reg_addr;
+            def->quantity = frame_info.quantity;
+            def->scan_rate = ui->box_scan_rate->value();
+            switch(m_protocol)
+            {
+            case MODBUS_RTU:
+                def->packet = Modbus_RTU::masterFrame2Pack(frame_info);
+                break;
+            case MODBUS_ASCII:
+                def->packet = Modbus_ASCII::masterFrame2Pack(frame_info);
+                break;
+            default:
+                def->packet = Modbus_TCP::masterFrame2Pack(frame_info);
+                break;
+            }
+            emit readDefinitionsCreated(def);
+        }
+    }
+    close();
+}
+
+void ModbusScanDialog::scannerUnitFound(int id)
+{
+    ui->list_results->addItem(QString("%1 %2").arg(tr("Unit")).arg(id));
+}
+
+void ModbusScanDialog::scannerProgressChanged(const QString &phase, int probes_sent, int probes_queued)
+{
+    ui->label_progress->setText(QString("%1 : %2 %3, %4 %5").arg(phase).arg(probes_sent).arg(tr("sent")).arg(probes_queued).arg(tr("queued")));
+}
+
+void ModbusScanDialog::scannerFinished()
+{
+    ui->list_results->clear();
+    m_found_ranges = m_scanner->foundRanges();
+    for(const auto &x : m_found_ranges)
+    {
+        ui->list_results->addItem(QString("%1 %2\t%3 %4\t%5 - %6").arg(tr("Unit")).arg(x.id).arg(tr("Function")).arg(x.function, 2, 10, QChar('0')).arg(x.reg_addr).arg(x.reg_addr + x.quantity - 1));
+    }
+    ui->label_progress->setText(QString("%1 : %2").arg(tr("Finished")).arg(m_found_ranges.size()));
+    ui->button_start->setEnabled(true);
+    ui->button_stop->setEnabled(false);
+    ui->button_add_definitions->setEnabled(!m_found_ranges.isEmpty());
+}
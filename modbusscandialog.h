@@ -0,0 +1,54 @@
+#ifndef MODBUSSCANDIALOG_H
+#define MODBUSSCANDIALOG_H
+
+#include <QDialog>
+#include <QList>
+#include "modbusscanner.h"
+
+namespace Ui {
+class ModbusScanDialog;
+}
+
+struct ModbusRegReadDefinitions;
+class QIODevice;
+class QThread;
+
+class ModbusScanDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ModbusScanDialog(const QList<QIODevice*> &coms, int protocol, QThread *com_thread, QWidget *parent = nullptr);
+    ~ModbusScanDialog();
+
+signals:
+    void readDefinitionsCreated(ModbusRegReadDefinitions *reg_def);
+
+private slots:
+    void on_button_start_clicked();
+
+    void on_button_stop_clicked();
+
+    void on_button_add_definitions_clicked();
+
+    void scannerUnitFound(int id);
+
+    void scannerProgressChanged(const QString &phase, int probes_sent, int probes_queued);
+
+    void scannerFinished();
+
+private:
+    void releaseScanner();
+
+private:
+    Ui::ModbusScanDialog *ui;
+    QList<QIODevice*> m_coms;
+    int m_protocol;
+    //the scanner has to run on the thread the connections live on
+    QThread *m_com_thread;
+    ModbusScanner *m_scanner;
+    //taken from the scanner once it has finished and stopped touching them
+    QList<ModbusScanner::FoundRange> m_found_ranges;
+};
+
+#endif // MODBUSSCANDIALOG_H
@@ -0,0 +1,360 @@
+#include "modbusscanner.h"
+#include <QIODevice>
+#include <QTimer>
+#include <algorithm>
+#include <tuple>
+#include "modbus_rtu.h"
+#include "modbus_ascii.h"
+#include "modbus_tcp.h"
+#include "openroutedialog.h"
+#include "ModbusFrameInfo.h"
+
+ModbusScanner::ModbusScanner(const QList<QIODevice*> &coms, int protocol, const ScanSettings &settings, QObject *parent)
+    : QObject{parent}, m_protocol(protocol), m_settings(settings), m_phase(Phase_Idle)
+    , m_trans_id(0), m_probes_sent(0), m_last_progress_ms(0), m_srtt_ms(0), m_rttvar_ms(0)
+{
+    for(auto x : coms)
+    {
+        Link link;
+        link.com = x;
+        m_links.append(link);
+    }
+    m_tick_timer = new QTimer(this);
+    connect(m_tick_timer, &QTimer::timeout, this, &ModbusScanner::tickTimerTimeoutSlot);
+}
+
+void ModbusScanner::start()
+{
+    m_queue.clear();
+    m_units.clear();
+    m_unsupported_tables.clear();
+    m_valid_blocks.clear();
+    m_probes_sent = 0;
+    m_last_progress_ms = 0;
+    m_srtt_ms = m_rttvar_ms = 0;
+    quint8 function = m_settings.functions.isEmpty() ? quint8(ModbusReadHoldingRegisters) : m_settings.functions.first();
+    for(int i = m_settings.first_id; i <= m_settings.last_id; ++i)
+    {
+        //any answer, an exception included, proves the unit is there
+        m_queue.append(Probe{quint8(i), function, m_settings.first_addr, 1});
+    }
+    for(auto &x : m_links)
+    {
+        x.recv_buffer.clear();
+        x.in_flight.clear();
+        connect(x.com, &QIODevice::readyRead, this, &ModbusScanner::comReadyReadSlot);
+    }
+    m_phase = Phase_Units;
+    m_clock.start();
+    m_tick_timer->start(1);
+    fillLinks();
+}
+
+void ModbusScanner::stop()
+{
+    if(m_phase == Phase_Idle)
+    {
+        return;
+    }
+    m_phase = Phase_Idle;
+    m_tick_timer->stop();
+    m_queue.clear();
+    for(auto &x : m_links)
+    {
+        disconnect(x.com, &QIODevice::readyRead, this, &ModbusScanner::comReadyReadSlot);
+        x.in_flight.clear();
+    }
+    emit finished();
+}
+
+bool ModbusScanner::isRunning() const
+{
+    return m_phase != Phase_Idle;
+}
+
+QList<ModbusScanner::FoundRange> ModbusScanner::foundRanges() const
+{
+    QList<FoundRange> blocks = m_valid_blocks;
+    std::sort(blocks.begin(), blocks.end(), [](const FoundRange &a, const FoundRange &b){
+        return std::make_tuple(a.id, a.function, a.reg_addr) < std::make_tuple(b.id, b.function, b.reg_addr);
+    });
+    QList<FoundRange> ret;
+    for(const auto &x : blocks)
+    {
+        if(!ret.isEmpty() && ret.last().id == x.id && ret.last().function == x.function &&
+            ret.last().reg_addr + ret.last().quantity == x.reg_addr)
+        {
+            ret.last().quantity += x.quantity;
+        }
+        else
+        {
+            ret.append(x);
+        }
+    }
+    return ret;
+}
+
+void ModbusScanner::comReadyReadSlot()
+{
+    QIODevice *com = qobject_cast<QIODevice*>(sender());
+    for(auto &link : m_links)
+    {
+        if(link.com != com)
+        {
+            continue;
+        }
+        link.recv_buffer.append(com->readAll());
+        qint64 pack_size{0};
+        while(!link.recv_buffer.isEmpty())
+        {
+            switch(m_protocol)
+            {
+            case MODBUS_RTU:
+                pack_size = Modbus_RTU::masterPackLength(link.recv_buffer.constData(), link.recv_buffer.size());
+                break;
+            case MODBUS_ASCII:
+                pack_size = Modbus_ASCII::masterPackLength(link.recv_buffer.constData(), link.recv_buffer.size());
+                break;
+            default:
+                pack_size = Modbus_TCP::masterPackLength(link.recv_buffer.constData(), link.recv_buffer.size());
+                break;
+            }
+            if(pack_size < 0)
+            {
+                link.recv_buffer.remove(0, -pack_size);
+                continue;
+            }
+            if(pack_size == 0)
+            {
+                break;
+            }
+            QByteArray pack = link.recv_buffer.left(pack_size);
+            link.recv_buffer.remove(0, pack_size);
+            handleResponse(link, pack);
+        }
+        break;
+    }
+    fillLinks();
+}
+
+void ModbusScanner::tickTimerTimeoutSlot()
+{
+    qint64 now = m_clock.elapsed();
+    int timeout = currentTimeout();
+    for(auto &link : m_links)
+    {
+        for(auto it = link.in_flight.begin(); it != link.in_flight.end();)
+        {
+            if(now - it.value().sent_at >= timeout)
+            {
+                Probe probe = it.value().probe;
+                it = link.in_flight.erase(it);
+                link.recv_buffer.clear();
+                handleTimeout(probe);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    fillLinks();
+    if(m_phase != Phase_Idle && now - m_last_progress_ms >= 100)
+    {
+        m_last_progress_ms = now;
+        emit progressChanged(m_phase == Phase_Units ? tr("Unit IDs") : tr("Address Ranges"), m_probes_sent, m_queue.size());
+    }
+}
+
+bool ModbusScanner::isTcp() const
+{
+    return m_protocol == MODBUS_TCP || m_protocol == MODBUS_UDP;
+}
+
+int ModbusScanner::maxQuantity(quint8 function) const
+{
+    return function == ModbusReadCoils || function == ModbusReadDescreteInputs ? 2000 : 125;
+}
+
+void ModbusScanner::fillLinks()
+{
+    if(m_phase == Phase_Idle)
+    {
+        return;
+    }
+    int window = isTcp() ? qMax(1, m_settings.concurrency) : 1;
+    for(auto &link : m_links)
+    {
+        while(link.in_flight.size() < window && !m_queue.isEmpty())
+        {
+            Probe probe = m_queue.takeFirst();
+            if(m_unsupported_tables.contains(qMakePair(int(probe.id), int(probe.function))))
+            {
+                continue;
+            }
+            sendProbe(link, probe);
+        }
+    }
+    if(m_queue.isEmpty() && inFlightCount() == 0)
+    {
+        if(m_phase == Phase_Units && !m_units.isEmpty())
+        {
+            m_phase = Phase_Ranges;
+            queueRangeProbes();
+            fillLinks();
+            return;
+        }
+        stop();
+    }
+}
+
+void ModbusScanner::sendProbe(Link &link, const Probe &probe)
+{
+    ModbusFrameInfo frame_info;
+    frame_info.id = probe.id;
+    frame_info.function = probe.function;
+    frame_info.reg_addr = probe.reg_addr;
+    frame_info.quantity = probe.quantity;
+    QByteArray pack;
+    quint16 key{0};
+    switch(m_protocol)
+    {
+    case MODBUS_RTU:
+        pack = Modbus_RTU::masterFrame2Pack(frame_info);
+        break;
+    case MODBUS_ASCII:
+        pack = Modbus_ASCII::masterFrame2Pack(frame_info);
+        break;
+    default:
+        frame_info.trans_id = key = m_trans_id++;
+        pack = Modbus_TCP::masterFrame2Pack(frame_info);
+        break;
+    }
+    link.in_flight.insert(key, InFlight{probe, m_clock.elapsed()});
+    link.com->write(pack);
+    ++m_probes_sent;
+}
+
+void ModbusScanner::handleResponse(Link &link, const QByteArray &pack)
+{
+    ModbusFrameInfo frame_info{};
+    quint16 key{0};
+    switch(m_protocol)
+    {
+    case MODBUS_RTU:
+        frame_info = Modbus_RTU::masterPack2Frame(pack);
+        break;
+    case MODBUS_ASCII:
+        frame_info = Modbus_ASCII::masterPack2Frame(pack);
+        break;
+    default:
+        frame_info = Modbus_TCP::masterPack2Frame(pack);
+        key = quint8(pack[0]) << 8 | quint8(pack[1]);
+        break;
+    }
+    auto it = link.in_flight.find(key);
+    if(it == link.in_flight.end() || it.value().probe.id != frame_info.id)
+    {
+        //a late answer to a probe that already timed out
+        return;
+    }
+    InFlight in_flight = it.value();
+    link.in_flight.erase(it);
+    if(m_phase == Phase_Units)
+    {
+        updateTimeout(m_clock.elapsed() - in_flight.sent_at);
+    }
+    int error_code = frame_info.function > ModbusFunctionError ? frame_info.reg_values[0] : ModbusErrorCode_OK;
+    handleResult(in_flight.probe, frame_info.function, error_code);
+}
+
+void ModbusScanner::handleResult(const Probe &probe, int function, int error_code)
+{
+    if(m_phase == Phase_Units)
+    {
+        if(!m_units.contains(probe.id))
+        {
+            m_units.append(probe.id);
+            emit unitFound(probe.id);
+        }
+        return;
+    }
+    if(error_code == ModbusErrorCode_OK && function == probe.function)
+    {
+        m_valid_blocks.append(FoundRange{probe.id, probe.function, probe.reg_addr, probe.quantity});
+    }
+    else if(error_code == ModbusErrorCode_Illegal_Function)
+    {
+        m_unsupported_tables.insert(qMakePair(int(probe.id), int(probe.function)));
+    }
+    else if((error_code == ModbusErrorCode_Illegal_Data_Address || error_code == ModbusErrorCode_Illegal_Data_Value) &&
+             probe.quantity > m_settings.resolution)
+    {
+        //some devices report a read running past the end as an illegal value, it is split the same way
+        quint16 half = probe.quantity / 2;
+        m_queue.prepend(Probe{probe.id, probe.function, quint16(probe.reg_addr + half), quint16(probe.quantity - half)});
+        m_queue.prepend(Probe{probe.id, probe.function, probe.reg_addr, half});
+    }
+}
+
+void ModbusScanner::handleTimeout(const Probe &probe)
+{
+    //a unit that did not answer its id probe is taken as absent, a found unit gets one more try
+    if(m_phase == Phase_Ranges && probe.retries == 0)
+    {
+        Probe retry = probe;
+        retry.retries = 1;
+        m_queue.prepend(retry);
+    }
+}
+
+void ModbusScanner::queueRangeProbes()
+{
+    std::sort(m_units.begin(), m_units.end());
+    for(auto id : m_units)
+    {
+        for(auto function : m_settings.functions)
+        {
+            int block = maxQuantity(function);
+            for(int addr = m_settings.first_addr; addr <= m_settings.last_addr; addr += block)
+            {
+                int quantity = qMin(block, m_settings.last_addr - addr + 1);
+                m_queue.append(Probe{quint8(id), function, quint16(addr), quint16(quantity)});
+            }
+        }
+    }
+}
+
+void ModbusScanner::updateTimeout(qint64 rtt_ms)
+{
+    if(m_srtt_ms == 0)
+    {
+        m_srtt_ms = rtt_ms;
+        m_rttvar_ms = rtt_ms / 2.0;
+        return;
+    }
+    m_rttvar_ms = 0.75 * m_rttvar_ms + 0.25 * qAbs(m_srtt_ms - rtt_ms);
+    m_srtt_ms = 0.875 * m_srtt_ms + 0.125 * rtt_ms;
+}
+
+int ModbusScanner::currentTimeout() const
+{
+    //the round trip is learnt from one-register id probes, block reads of found units take
+    //longer on a slow line and keep the full timeout
+    if(m_srtt_ms == 0 || m_phase != Phase_Units)
+    {
+        return m_settings.max_timeout_ms;
+    }
+    int timeout = int(m_srtt_ms + 4 * m_rttvar_ms) + 1;
+    return qBound(m_settings.min_timeout_ms, timeout, m_settings.max_timeout_ms);
+}
+
+int ModbusScanner::inFlightCount() const
+{
+    int count{0};
+    for(const auto &x : m_links)
+    {
+        count += x.in_flight.size();
+    }
+    return count;
+}
@@ -0,0 +1,130 @@
+#ifndef MODBUSSCANNER_H
+#define MODBUSSCANNER_H
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QPair>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+class QIODevice;
+class QTimer;
+
+/*
+ * Finds the unit ids that answer on a route and the address ranges each of them implements.
+ * Unit ids are probed first, then every table of every found unit is read in the largest
+ * blocks the protocol allows, a block answered with an illegal address exception is split
+ * in halves until it is valid or down to the resolution.
+ * On tcp and udp several probes are in flight per connection, matched by transaction id,
+ * on serial lines the probes run back to back.
+ */
+
+class ModbusScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct ScanSettings
+    {
+        int first_id{1};
+        int last_id{247};
+        QList<quint8> functions;
+        quint16 first_addr{0};
+        quint16 last_addr{9999};
+        //smallest block that is still split on an illegal address exception
+        int resolution{1};
+        int max_timeout_ms{300};
+        int min_timeout_ms{10};
+        //probes in flight per tcp or udp connection
+        int concurrency{8};
+    };
+
+    struct FoundRange
+    {
+        quint8 id;
+        quint8 function;
+        quint16 reg_addr;
+        quint16 quantity;
+    };
+
+public:
+    explicit ModbusScanner(const QList<QIODevice*> &coms, int protocol, const ScanSettings &settings, QObject *parent = nullptr);
+    void start();
+    void stop();
+    bool isRunning() const;
+    //adjacent valid blocks merged, sorted by unit, table and address
+    QList<FoundRange> foundRanges() const;
+
+signals:
+    void unitFound(int id);
+    void progressChanged(const QString &phase, int probes_sent, int probes_queued);
+    void finished();
+
+private slots:
+    void comReadyReadSlot();
+    void tickTimerTimeoutSlot();
+
+private:
+    struct Probe
+    {
+        quint8 id;
+        quint8 function;
+        quint16 reg_addr;
+        quint16 quantity;
+        int retries{0};
+    };
+
+    struct InFlight
+    {
+        Probe probe;
+        qint64 sent_at;
+    };
+
+    struct Link
+    {
+        QIODevice *com{nullptr};
+        QByteArray recv_buffer;
+        QMap<quint16, InFlight> in_flight;
+    };
+
+    enum Phase{
+        Phase_Idle,
+        Phase_Units,
+        Phase_Ranges,
+    };
+
+private:
+    bool isTcp() const;
+    int maxQuantity(quint8 function) const;
+    void fillLinks();
+    void sendProbe(Link &link, const Probe &probe);
+    void handleResponse(Link &link, const QByteArray &pack);
+    void handleResult(const Probe &probe, int function, int error_code);
+    void handleTimeout(const Probe &probe);
+    void queueRangeProbes();
+    void updateTimeout(qint64 rtt_ms);
+    int currentTimeout() const;
+    int inFlightCount() const;
+
+private:
+    QList<Link> m_links;
+    int m_protocol;
+    ScanSettings m_settings;
+    Phase m_phase;
+    QList<Probe> m_queue;
+    QList<int> m_units;
+    QSet<QPair<int, int> > m_unsupported_tables;
+    QList<FoundRange> m_valid_blocks;
+    QTimer *m_tick_timer;
+    QElapsedTimer m_clock;
+    quint16 m_trans_id;
+    int m_probes_sent;
+    qint64 m_last_progress_ms;
+    //smoothed round trip and its deviation, the timeout follows them as tcp's rto does
+    double m_srtt_ms;
+    double m_rttvar_ms;
+};
+
+#endif // MODBUSSCANNER_H
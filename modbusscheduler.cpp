@@ -0,0 +1,255 @@
+#include "modbusscheduler.h"
+#include "ModbusFrameInfo.h"
+
+ModbusScheduler::ModbusScheduler()
+    : m_fast_poll_ms(1000), m_write_combine_ms(0), m_broadcast_turnaround_ms(100), m_fuse_read_write(false)
+{
+    m_clock.start();
+    setRateBudget(Priority_Urgent_Write, 50, 10);
+    setRateBudget(Priority_Normal_Write, 20, 5);
+    setRateBudget(Priority_Fast_Poll, 0, 1);
+    setRateBudget(Priority_Slow_Poll, 0, 1);
+}
+
+void ModbusScheduler::setRateBudget(int priority, int rate, int burst)
+{
+    if(priority < 0 || priority >= Priority_Count)
+    {
+        return;
+    }
+    ClassQueue &class_queue = m_classes[priority];
+    class_queue.rate = qMax(0, rate);
+    class_queue.burst = qMax(1, burst);
+    class_queue.tokens = class_queue.burst;
+    class_queue.last_refill = m_clock.elapsed();
+}
+
+void ModbusScheduler::setSettings(const ModbusSchedulerSettings &settings)
+{
+    for(int i = 0; i < Priority_Count && i < settings.rates.size() && i < settings.bursts.size(); ++i)
+    {
+        setRateBudget(i, settings.rates[i], settings.bursts[i]);
+    }
+    m_fast_poll_ms = settings.fast_poll_ms;
+    m_write_combine_ms = qMax(0, settings.write_combine_ms);
+    m_broadcast_turnaround_ms = qMax(1, settings.broadcast_turnaround_ms);
+    m_fuse_read_write = settings.fuse_read_write;
+}
+
+ModbusSchedulerSettings ModbusScheduler::settings() const
+{
+    ModbusSchedulerSettings settings;
+    for(const auto &x : m_classes)
+    {
+        settings.rates.append(x.rate);
+        settings.bursts.append(x.burst);
+    }
+    settings.fast_poll_ms = m_fast_poll_ms;
+    settings.write_combine_ms = m_write_combine_ms;
+    settings.broadcast_turnaround_ms = m_broadcast_turnaround_ms;
+    settings.fuse_read_write = m_fuse_read_write;
+    return settings;
+}
+
+int ModbusScheduler::writePriority(quint8 function) const
+{
+    //a single coil, register or bit is what an operator toggles, block writes are usually downloads
+    if(function == ModbusWriteSingleCoil || function == ModbusWriteSingleRegister || function == ModbusMaskWriteRegister)
+    {
+        return Priority_Urgent_Write;
+    }
+    return Priority_Normal_Write;
+}
+
+int ModbusScheduler::pollPriority(quint32 scan_rate) const
+{
+    return int(scan_rate) <= m_fast_poll_ms ? Priority_Fast_Poll : Priority_Slow_Poll;
+}
+
+void ModbusScheduler::enqueue(const ModbusRequest &request)
+{
+    ClassQueue &class_queue = m_classes[qBound(0, request.priority, Priority_Count - 1)];
+    QList<ModbusRequest> &unit_queue = class_queue.unit_queues[request.id];
+    if(unit_queue.isEmpty())
+    {
+        class_queue.unit_order.append(request.id);
+    }
+    unit_queue.append(request);
+}
+
+void ModbusScheduler::requeue(const ModbusRequest &request)
+{
+    ClassQueue &class_queue = m_classes[qBound(0, request.priority, Priority_Count - 1)];
+    QList<ModbusRequest> &unit_queue = class_queue.unit_queues[request.id];
+    if(unit_queue.isEmpty())
+    {
+        //the unit is next in turn, it already had its turn taken from it once
+        class_queue.unit_order.insert(qMin(class_queue.next_unit, int(class_queue.unit_order.size())), request.id);
+    }
+    unit_queue.prepend(request);
+}
+
+bool ModbusScheduler::dequeue(ModbusRequest &request, const std::function<bool(const ModbusRequest&)> &accepts)
+{
+    qint64 now = m_clock.elapsed();
+    for(auto &x : m_classes)
+    {
+        refill(x, now);
+    }
+    for(auto &x : m_classes)
+    {
+        if(x.rate > 0 && x.tokens < 1)
+        {
+            continue;
+        }
+        if(takeFrom(x, request, accepts))
+        {
+            if(x.rate > 0)
+            {
+                x.tokens -= 1;
+            }
+            return true;
+        }
+    }
+    //every class with work is over budget, the line is not left idle for it
+    for(auto &x : m_classes)
+    {
+        if(takeFrom(x, request, accepts))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ModbusScheduler::take(int id, ModbusRequest &request, const std::function<bool(const ModbusRequest&)> &matches)
+{
+    for(auto &x : m_classes)
+    {
+        int index = x.unit_order.indexOf(id);
+        if(index < 0)
+        {
+            continue;
+        }
+        QList<ModbusRequest> &unit_queue = x.unit_queues[id];
+        for(int i = 0; i < unit_queue.size(); ++i)
+        {
+            if(!matches(unit_queue[i]))
+            {
+                continue;
+            }
+            request = unit_queue.takeAt(i);
+            if(unit_queue.isEmpty())
+            {
+                x.unit_queues.remove(id);
+                x.unit_order.removeAt(index);
+                if(x.next_unit > index)
+                {
+                    --x.next_unit;
+                }
+                if(x.next_unit >= x.unit_order.size())
+                {
+                    x.next_unit = 0;
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ModbusScheduler::contains(quint32 def_handle) const
+{
+    for(const auto &x : m_classes)
+    {
+        for(auto id : x.unit_order)
+        {
+            for(const auto &request : x.unit_queues.value(id))
+            {
+                if(request.def_handle == def_handle)
+                {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void ModbusScheduler::removeDefinition(quint32 def_handle)
+{
+    for(auto &x : m_classes)
+    {
+        for(int i = x.unit_order.size() - 1; i >= 0; --i)
+        {
+            QList<ModbusRequest> &unit_queue = x.unit_queues[x.unit_order[i]];
+            for(int j = unit_queue.size() - 1; j >= 0; --j)
+            {
+                if(unit_queue[j].def_handle == def_handle)
+                {
+                    unit_queue.removeAt(j);
+                }
+            }
+            if(unit_queue.isEmpty())
+            {
+                x.unit_queues.remove(x.unit_order[i]);
+                x.unit_order.removeAt(i);
+                if(x.next_unit > i)
+                {
+                    --x.next_unit;
+                }
+            }
+        }
+    }
+}
+
+int ModbusScheduler::size() const
+{
+    int count{0};
+    for(const auto &x : m_classes)
+    {
+        for(auto id : x.unit_order)
+        {
+            count += x.unit_queues.value(id).size();
+        }
+    }
+    return count;
+}
+
+void ModbusScheduler::refill(ClassQueue &class_queue, qint64 now)
+{
+    if(class_queue.rate > 0)
+    {
+        class_queue.tokens = qMin(double(class_queue.burst), class_queue.tokens + (now - class_queue.last_refill) * class_queue.rate / 1000.0);
+    }
+    class_queue.last_refill = now;
+}
+
+bool ModbusScheduler::takeFrom(ClassQueue &class_queue, ModbusRequest &request, const std::function<bool(const ModbusRequest&)> &accepts)
+{
+    int unit_count = class_queue.unit_order.size();
+    for(int i = 0; i < unit_count; ++i)
+    {
+        int index = (class_queue.next_unit + i) % unit_count;
+        int id = class_queue.unit_order[index];
+        QList<ModbusRequest> &unit_queue = class_queue.unit_queues[id];
+        //only the head of a unit's queue is a candidate, a unit's requests keep their order
+        if(!accepts(unit_queue.first()))
+        {
+            continue;
+        }
+        request = unit_queue.takeFirst();
+        if(unit_queue.isEmpty())
+        {
+            class_queue.unit_queues.remove(id);
+            class_queue.unit_order.removeAt(index);
+            class_queue.next_unit = unit_count > 1 ? index % (unit_count - 1) : 0;
+        }
+        else
+        {
+            class_queue.next_unit = (index + 1) % unit_count;
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,100 @@
+#ifndef MODBUSSCHEDULER_H
+#define MODBUSSCHEDULER_H
+
+#include <QList>
+#include <QMap>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <functional>
+
+/*
+ * Orders the requests of a master route. Requests are sorted into priority classes and a class
+ * is served before any class below it, as long as its rate budget has a token left. Within a
+ * class each unit id has its own queue and the units are served in turn, so one slow or chatty
+ * slave cannot hold back the others. When every class with queued work is out of budget the
+ * highest one is served anyway, the budgets shape the traffic but never leave the line idle.
+ */
+
+struct ModbusRequest
+{
+    QByteArray pack;
+    int id{0};
+    int priority{0};
+    //the definition a poll reads, 0 for a manual write
+    quint32 def_handle{0};
+    //the FC16 write a poll was fused with, sent on its own again if the slave refuses the FC23
+    QByteArray fused_write;
+    //a write split back out of a refused FC23, it is not fused again
+    bool keep_apart{false};
+};
+
+struct ModbusSchedulerSettings
+{
+    //requests per second and burst of each priority class, a rate of 0 leaves the class unlimited
+    QList<int> rates;
+    QList<int> bursts;
+    //a poll scanned at this period or faster is a fast poll
+    int fast_poll_ms{1000};
+    //writes queued within this window are merged before they are sent, 0 sends each one at once;
+    //off unless asked for, a test tool should put on the wire the frames it was told to and when
+    int write_combine_ms{0};
+    //the silence left after a broadcast, the slaves need it to carry out the write
+    int broadcast_turnaround_ms{100};
+    //a block write is sent together with a waiting holding register poll as one FC23 request
+    bool fuse_read_write{false};
+};
+
+class ModbusScheduler
+{
+public:
+    enum PriorityClass{
+        Priority_Urgent_Write,
+        Priority_Normal_Write,
+        Priority_Fast_Poll,
+        Priority_Slow_Poll,
+        Priority_Count,
+    };
+
+public:
+    ModbusScheduler();
+    void setSettings(const ModbusSchedulerSettings &settings);
+    ModbusSchedulerSettings settings() const;
+    int writePriority(quint8 function) const;
+    int pollPriority(quint32 scan_rate) const;
+    void enqueue(const ModbusRequest &request);
+    //puts a request that could not be completed back at the head of its unit's queue
+    void requeue(const ModbusRequest &request);
+    bool dequeue(ModbusRequest &request, const std::function<bool(const ModbusRequest&)> &accepts);
+    //takes the first queued request of one unit that matches, whatever class it waits in
+    bool take(int id, ModbusRequest &request, const std::function<bool(const ModbusRequest&)> &matches);
+    bool contains(quint32 def_handle) const;
+    void removeDefinition(quint32 def_handle);
+    int size() const;
+
+private:
+    struct ClassQueue
+    {
+        QMap<int, QList<ModbusRequest> > unit_queues;
+        QList<int> unit_order;
+        int next_unit{0};
+        int rate{0};
+        int burst{1};
+        double tokens{1};
+        qint64 last_refill{0};
+    };
+
+private:
+    void setRateBudget(int priority, int rate, int burst);
+    void refill(ClassQueue &class_queue, qint64 now);
+    bool takeFrom(ClassQueue &class_queue, ModbusRequest &request, const std::function<bool(const ModbusRequest&)> &accepts);
+
+private:
+    ClassQueue m_classes[Priority_Count];
+    int m_fast_poll_ms;
+    int m_write_combine_ms;
+    int m_broadcast_turnaround_ms;
+    bool m_fuse_read_write;
+    QElapsedTimer m_clock;
+};
+
+#endif // MODBUSSCHEDULER_H
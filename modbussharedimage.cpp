@@ -0,0 +1,418 @@
+#include "modbussharedimage.h"
+#include <QHash>
+#include <QVector>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <cerrno>
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+const char image_magic[4] = {'M', 'B', 'R', 'I'};
+const quint16 image_format_version = 2;
+//the file grows in steps, so that it rarely has to while other processes have it mapped
+const qint64 image_size_step = 64 * 1024;
+//far longer than a writer could take for 255 words, a block held longer has its writer looked at
+const int stale_lock_ms = 100;
+
+quint64 blockKey(quint8 id, quint8 function, quint16 reg_addr, quint16 quantity)
+{
+    return quint64(id) << 40 | quint64(function) << 32 | quint64(reg_addr) << 16 | quantity;
+}
+
+//only a process known to be gone gives up its blocks, one that cannot be looked at is waited for
+bool processExited(quint32 pid)
+{
+    if(pid == 0)
+    {
+        return false;
+    }
+#if defined(Q_OS_UNIX)
+    return kill(pid_t(pid), 0) != 0 && errno == ESRCH;
+#elif defined(Q_OS_WIN)
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, DWORD(pid));
+    if(!process)
+    {
+        return GetLastError() == ERROR_INVALID_PARAMETER;
+    }
+    bool exited = WaitForSingleObject(process, 0) == WAIT_OBJECT_0;
+    CloseHandle(process);
+    return exited;
+#else
+    return false;
+#endif
+}
+
+void waitForWriter(const QElapsedTimer &stale_timer)
+{
+    if(stale_timer.elapsed() < stale_lock_ms)
+    {
+        QThread::yieldCurrentThread();
+    }
+    else
+    {
+        QThread::msleep(1);
+    }
+}
+}
+
+static_assert(std::atomic<quint32>::is_always_lock_free && std::atomic<quint16>::is_always_lock_free,
+              "the image is shared between processes, its atomics must not hide a lock");
+
+ModbusSharedImage::ModbusSharedImage()
+    : m_data(nullptr), m_size(0)
+{
+
+}
+
+ModbusSharedImage::~ModbusSharedImage()
+{
+    close();
+}
+
+bool ModbusSharedImage::open(const QString &file_name, QString &error)
+{
+    close();
+    m_file.setFileName(file_name);
+    if(!m_file.open(QIODevice::ReadWrite))
+    {
+        error = m_file.errorString();
+        return false;
+    }
+    qint64 size = m_file.size();
+    if(size == 0)
+    {
+        if(!map(image_size_step, error))
+        {
+            close();
+            return false;
+        }
+        memcpy(header()->magic, image_magic, sizeof(image_magic));
+        header()->format_version = image_format_version;
+        header()->entry_size = sizeof(Entry);
+        return true;
+    }
+    if(size < qint64(sizeof(Header)) || !map(size, error))
+    {
+        error = error.isEmpty() ? QString("%1 is not a register image").arg(file_name) : error;
+        close();
+        return false;
+    }
+    const Header *image_header = header();
+    if(memcmp(image_header->magic, image_magic, sizeof(image_magic)) != 0 ||
+        image_header->format_version != image_format_version || image_header->entry_size != sizeof(Entry) ||
+        qint64(sizeof(Header) + image_header->block_count * sizeof(Entry)) > size)
+    {
+        error = QString("%1 is not a register image").arg(file_name);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ModbusSharedImage::close()
+{
+    if(m_data)
+    {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    m_size = 0;
+    m_file.close();
+}
+
+bool ModbusSharedImage::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+QString ModbusSharedImage::fileName() const
+{
+    return m_file.fileName();
+}
+
+bool ModbusSharedImage::setLayout(const QList<ModbusImageBlock> &blocks, QList<bool> &kept, QString &error)
+{
+    kept.clear();
+    if(!m_data)
+    {
+        error = "The register image is not open";
+        return false;
+    }
+    qint64 size = sizeof(Header) + blocks.size() * sizeof(Entry);
+    for(const auto &x : blocks)
+    {
+        size += (x.quantity * sizeof(quint16) + 3) & ~3;
+    }
+    //growing the file leaves the blocks where they are, it is done before anything is taken
+    if(size > m_size && !map((size + image_size_step - 1) / image_size_step * image_size_step, error))
+    {
+        return false;
+    }
+    Header *image_header = header();
+    //no writer may be inside a block while the blocks move
+    quint32 old_count = image_header->block_count;
+    QVector<quint32> held(old_count);
+    for(quint32 i = 0; i < old_count; ++i)
+    {
+        held[i] = lockBlock(entry(i));
+    }
+    image_header->layout_sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    QHash<quint64, QVector<quint16> > old_values;
+    QHash<quint64, quint32> old_sequences;
+    //a new block starts above every sequence any reader could have seen in the old directory
+    quint32 new_sequence = 0;
+    for(quint32 i = 0; i < old_count; ++i)
+    {
+        const Entry *old_entry = entry(i);
+        new_sequence = qMax(new_sequence, held[i] + 1);
+        if(old_entry->data_offset + old_entry->quantity * sizeof(quint16) > quint64(m_size))
+        {
+            continue;
+        }
+        old_sequences.insert(blockKey(old_entry->id, old_entry->function, old_entry->reg_addr, old_entry->quantity), held[i] + 1);
+        QVector<quint16> block_values(old_entry->quantity);
+        const std::atomic<quint16> *source = values(old_entry);
+        for(int j = 0; j < block_values.size(); ++j)
+        {
+            block_values[j] = source[j].load(std::memory_order_relaxed);
+        }
+        old_values.insert(blockKey(old_entry->id, old_entry->function, old_entry->reg_addr, old_entry->quantity), block_values);
+    }
+    quint32 data_offset = sizeof(Header) + blocks.size() * sizeof(Entry);
+    for(int i = 0; i < blocks.size(); ++i)
+    {
+        const ModbusImageBlock &block = blocks[i];
+        Entry *new_entry = entry(i);
+        new_entry->id = block.id;
+        new_entry->function = block.function;
+        new_entry->reg_addr = block.reg_addr;
+        new_entry->quantity = block.quantity;
+        new_entry->reserved = 0;
+        new_entry->data_offset = data_offset;
+        quint64 key = blockKey(block.id, block.function, block.reg_addr, block.quantity);
+        new_entry->sequence.store(old_sequences.value(key, new_sequence), std::memory_order_relaxed);
+        new_entry->owner_pid.store(0, std::memory_order_relaxed);
+        QVector<quint16> block_values = old_values.value(key);
+        kept.append(!block_values.isEmpty());
+        std::atomic<quint16> *target = values(new_entry);
+        for(int j = 0; j < block.quantity; ++j)
+        {
+            target[j].store(j < block_values.size() ? block_values[j] : 0, std::memory_order_relaxed);
+        }
+        data_offset += (block.quantity * sizeof(quint16) + 3) & ~3;
+    }
+    image_header->block_count = blocks.size();
+    image_header->change_sequence.fetch_add(1, std::memory_order_relaxed);
+    image_header->layout_sequence.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void ModbusSharedImage::write(int index, int offset, const quint16 *values, int count, quint32 &sequence)
+{
+    if(!m_data)
+    {
+        return;
+    }
+    Header *image_header = header();
+    Entry *block_entry = nullptr;
+    quint32 held = 0;
+    for(;;)
+    {
+        quint32 layout_sequence = image_header->layout_sequence.load(std::memory_order_acquire);
+        if(layout_sequence & 1)
+        {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        if(index < 0 || index >= int(image_header->block_count))
+        {
+            return;
+        }
+        block_entry = entry(index);
+        if(offset < 0 || count <= 0 || offset + count > block_entry->quantity)
+        {
+            return;
+        }
+        held = lockBlock(block_entry);
+        //the directory is rewritten with every block taken, so once the block is held it stays where
+        //it was looked up, unless the directory moved between the look up and the taking
+        if(image_header->layout_sequence.load(std::memory_order_acquire) == layout_sequence)
+        {
+            break;
+        }
+        unlockBlock(block_entry, held);
+    }
+    std::atomic<quint16> *target = this->values(block_entry);
+    for(int i = 0; i < count; ++i)
+    {
+        target[offset + i].store(values[i], std::memory_order_relaxed);
+    }
+    unlockBlock(block_entry, held);
+    image_header->change_sequence.fetch_add(1, std::memory_order_release);
+    //the caller's copy is only up to date if nobody else got in since it last looked
+    if(held == sequence + 1)
+    {
+        sequence = held + 1;
+    }
+}
+
+quint32 ModbusSharedImage::read(int index, int offset, quint16 *values, int count) const
+{
+    if(!m_data)
+    {
+        return 0;
+    }
+    const Header *image_header = header();
+    QElapsedTimer stale_timer;
+    for(;;)
+    {
+        //the entry is only trusted for as long as the directory it was read from stays
+        quint32 layout_sequence = image_header->layout_sequence.load(std::memory_order_acquire);
+        if(layout_sequence & 1)
+        {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        if(index < 0 || index >= int(image_header->block_count))
+        {
+            return 0;
+        }
+        Entry *block_entry = entry(index);
+        if(offset < 0 || count <= 0 || offset + count > block_entry->quantity)
+        {
+            return 0;
+        }
+        quint32 sequence = block_entry->sequence.load(std::memory_order_acquire);
+        if(sequence & 1)
+        {
+            if(!stale_timer.isValid())
+            {
+                stale_timer.start();
+            }
+            if(stale_timer.elapsed() < stale_lock_ms || !processExited(block_entry->owner_pid.load(std::memory_order_relaxed)))
+            {
+                waitForWriter(stale_timer);
+                continue;
+            }
+            //the writer is gone, what it left behind is all there is
+        }
+        const std::atomic<quint16> *source = this->values(block_entry);
+        for(int i = 0; i < count; ++i)
+        {
+            values[i] = source[offset + i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(block_entry->sequence.load(std::memory_order_relaxed) == sequence &&
+            image_header->layout_sequence.load(std::memory_order_relaxed) == layout_sequence)
+        {
+            return sequence;
+        }
+    }
+}
+
+quint32 ModbusSharedImage::sequence(int index) const
+{
+    if(!m_data || index < 0 || index >= int(header()->block_count))
+    {
+        return 0;
+    }
+    return entry(index)->sequence.load(std::memory_order_acquire);
+}
+
+quint32 ModbusSharedImage::changeSequence() const
+{
+    return m_data ? header()->change_sequence.load(std::memory_order_acquire) : 0;
+}
+
+bool ModbusSharedImage::map(qint64 size, QString &error)
+{
+    if(m_data)
+    {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+        m_size = 0;
+    }
+    if(m_file.size() < size && !m_file.resize(size))
+    {
+        error = m_file.errorString();
+        return false;
+    }
+    m_data = m_file.map(0, size);
+    if(!m_data)
+    {
+        error = m_file.errorString();
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+ModbusSharedImage::Header *ModbusSharedImage::header() const
+{
+    return reinterpret_cast<Header*>(m_data);
+}
+
+ModbusSharedImage::Entry *ModbusSharedImage::entry(int index) const
+{
+    return reinterpret_cast<Entry*>(m_data + sizeof(Header) + index * sizeof(Entry));
+}
+
+std::atomic<quint16> *ModbusSharedImage::values(const Entry *entry) const
+{
+    return reinterpret_cast<std::atomic<quint16>*>(m_data + entry->data_offset);
+}
+
+quint32 ModbusSharedImage::lockBlock(Entry *entry) const
+{
+    quint32 pid = quint32(QCoreApplication::applicationPid());
+    QElapsedTimer stale_timer;
+    for(;;)
+    {
+        quint32 owner = entry->owner_pid.load(std::memory_order_relaxed);
+        if(owner == 0)
+        {
+            if(entry->owner_pid.compare_exchange_weak(owner, pid, std::memory_order_acquire))
+            {
+                break;
+            }
+            continue;
+        }
+        if(!stale_timer.isValid())
+        {
+            stale_timer.start();
+        }
+        //a slow writer is waited for however long it takes, only a dead one is replaced
+        if(stale_timer.elapsed() >= stale_lock_ms && processExited(owner))
+        {
+            if(entry->owner_pid.compare_exchange_strong(owner, pid, std::memory_order_acquire))
+            {
+                break;
+            }
+            continue;
+        }
+        waitForWriter(stale_timer);
+    }
+    quint32 sequence = entry->sequence.load(std::memory_order_relaxed);
+    if(sequence & 1)
+    {
+        //taken over from a writer that died inside the block, the block is left as it was
+        return sequence;
+    }
+    entry->sequence.store(sequence + 1, std::memory_order_relaxed);
+    //the odd sequence must be visible before any of the new values
+    std::atomic_thread_fence(std::memory_order_release);
+    return sequence + 1;
+}
+
+void ModbusSharedImage::unlockBlock(Entry *entry, quint32 held) const
+{
+    entry->sequence.store(held + 1, std::memory_order_release);
+    entry->owner_pid.store(0, std::memory_order_release);
+}
@@ -0,0 +1,118 @@
+#ifndef MODBUSSHAREDIMAGE_H
+#define MODBUSSHAREDIMAGE_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <atomic>
+
+//a register block as it is listed in the image
+struct ModbusImageBlock
+{
+    quint8 id{0};
+    quint8 function{0};
+    quint16 reg_addr{0};
+    quint16 quantity{0};
+};
+
+/*
+ * The register blocks of a slave route in a memory mapped file, so that test scripts and
+ * models in other processes read and write the values the slave serves without going through
+ * a master. Every number is in the host's byte order, little endian on the platforms the tool
+ * is built for.
+ *
+ * Header, 32 bytes at offset 0:
+ *   0  char[4]  "MBRI"
+ *   4  u16      format version, 2
+ *   6  u16      size of a directory entry, 20
+ *   8  u32      layout sequence, odd while the directory is rewritten
+ *   12 u32      number of blocks
+ *   16 u32      change sequence, moves on after every write to any block
+ *   20 u32[3]   reserved
+ * Directory, one entry per block right after the header:
+ *   0  u8       unit id
+ *   1  u8       function, 1 coils, 2 discrete inputs, 3 holding registers, 4 input registers
+ *   2  u16      start address
+ *   4  u16      quantity
+ *   6  u16      reserved
+ *   8  u32      offset of the block's values from the start of the file
+ *   12 u32      block sequence, odd while a writer is in the block
+ *   16 u32      process id of the writer holding the block, 0 when it is free
+ * Values: one u16 per register or coil, a coil is 0 or 1.
+ *
+ * A reader reads the layout sequence and the block sequence, waits while either is odd, copies
+ * the values and reads them again if either has moved meanwhile. A writer reads the layout
+ * sequence, waits while it is odd, looks the block up in the directory, takes it by swapping the
+ * writer process id from 0 to its own and moves the block sequence from even to odd. It then
+ * reads the layout sequence again: if it is not the even value read before, the block found may
+ * no longer be the one wanted, so the writer moves the block sequence on to the next even number,
+ * clears the process id and looks the block up again without having written. Otherwise it writes,
+ * moves the block sequence on to the next even number, clears the process id and then increments
+ * the change sequence. The directory is only ever rewritten by the slave, with every block taken, when a
+ * block is added, changed or removed; a block that stays moves its sequence on by 2, a new one
+ * starts above every sequence the directory had, so a sequence seen before never comes back.
+ * A process that sees the layout sequence move reads the directory again, and maps the file
+ * again if it has grown. A block is only taken over from a writer whose process has exited.
+ */
+
+class ModbusSharedImage
+{
+public:
+    ModbusSharedImage();
+    ~ModbusSharedImage();
+    //an existing image is kept, a file that is something else is refused
+    bool open(const QString &file_name, QString &error);
+    void close();
+    bool isOpen() const;
+    QString fileName() const;
+    //kept tells which blocks were already in the image, their values are left as they are
+    bool setLayout(const QList<ModbusImageBlock> &blocks, QList<bool> &kept, QString &error);
+    //sequence is the block's sequence the caller last saw, it is moved on past this write
+    //unless someone else wrote to the block in between
+    void write(int index, int offset, const quint16 *values, int count, quint32 &sequence);
+    //returns the block sequence the values were read at
+    quint32 read(int index, int offset, quint16 *values, int count) const;
+    quint32 sequence(int index) const;
+    quint32 changeSequence() const;
+
+private:
+    struct Header
+    {
+        char magic[4];
+        quint16 format_version;
+        quint16 entry_size;
+        std::atomic<quint32> layout_sequence;
+        quint32 block_count;
+        std::atomic<quint32> change_sequence;
+        quint32 reserved[3];
+    };
+
+    struct Entry
+    {
+        quint8 id;
+        quint8 function;
+        quint16 reg_addr;
+        quint16 quantity;
+        quint16 reserved;
+        quint32 data_offset;
+        std::atomic<quint32> sequence;
+        std::atomic<quint32> owner_pid;
+    };
+
+private:
+    bool map(qint64 size, QString &error);
+    Header *header() const;
+    Entry *entry(int index) const;
+    std::atomic<quint16> *values(const Entry *entry) const;
+    //returns the odd sequence the block is held at
+    quint32 lockBlock(Entry *entry) const;
+    //moves the sequence on from held and lets the block go
+    void unlockBlock(Entry *entry, quint32 held) const;
+
+private:
+    QFile m_file;
+    uchar *m_data;
+    qint64 m_size;
+};
+
+#endif // MODBUSSHAREDIMAGE_H
@@ -0,0 +1,155 @@
+#include "modbusvaluecodec.h"
+#include <QtEndian>
+#include <QtMath>
+#include <cmath>
+#include "utils.h"
+
+namespace {
+const double two_to_63 = 9223372036854775808.0;
+const double two_to_64 = 18446744073709551616.0;
+}
+
+int ModbusValueCodec::valueWidth(int format)
+{
+    return format >= Format_64_Bit_Signed_Big_Endian ? 4 : format >= Format_32_Bit_Signed_Big_Endian ? 2 : 1;
+}
+
+double ModbusValueCodec::decodeValue(int format, const quint16 *values)
+{
+    switch(format)
+    {
+    case Format_Signed:
+        return qint16(values[0]);
+    case Format_32_Bit_Signed_Big_Endian:
+        return qFromBigEndian<qint32>(values);
+    case Format_32_Bit_Signed_Little_Endian:
+        return qFromLittleEndian<qint32>(values);
+    case Format_32_Bit_Signed_Big_Endian_Byte_Swap:
+        return myFromBigEndianByteSwap<qint32>(values);
+    case Format_32_Bit_Signed_Little_Endian_Byte_Swap:
+        return myFromLittleEndianByteSwap<qint32>(values);
+    case Format_32_Bit_Unsigned_Big_Endian:
+        return qFromBigEndian<quint32>(values);
+    case Format_32_Bit_Unsigned_Little_Endian:
+        return qFromLittleEndian<quint32>(values);
+    case Format_32_Bit_Unsigned_Big_Endian_Byte_Swap:
+        return myFromBigEndianByteSwap<quint32>(values);
+    case Format_32_Bit_Unsigned_Little_Endian_Byte_Swap:
+        return myFromLittleEndianByteSwap<quint32>(values);
+    case Format_64_Bit_Signed_Big_Endian:
+        return qFromBigEndian<qint64>(values);
+    case Format_64_Bit_Signed_Little_Endian:
+        return qFromLittleEndian<qint64>(values);
+    case Format_64_Bit_Signed_Big_Endian_Byte_Swap:
+        return myFromBigEndianByteSwap<qint64>(values);
+    case Format_64_Bit_Signed_Little_Endian_Byte_Swap:
+        return myFromLittleEndianByteSwap<qint64>(values);
+    case Format_64_Bit_Unsigned_Big_Endian:
+        return qFromBigEndian<quint64>(values);
+    case Format_64_Bit_Unsigned_Little_Endian:
+        return qFromLittleEndian<quint64>(values);
+    case Format_64_Bit_Unsigned_Big_Endian_Byte_Swap:
+        return myFromBigEndianByteSwap<quint64>(values);
+    case Format_64_Bit_Unsigned_Little_Endian_Byte_Swap:
+        return myFromLittleEndianByteSwap<quint64>(values);
+    case Format_32_Bit_Float_Big_Endian:
+        return myFromBigEndianByteSwap<float>(values);
+    case Format_32_Bit_Float_Little_Endian:
+        return myFromLittleEndianByteSwap<float>(values);
+    case Format_32_Bit_Float_Big_Endian_Byte_Swap:
+        return qFromBigEndian<float>(values);
+    case Format_32_Bit_Float_Little_Endian_Byte_Swap:
+        return qFromLittleEndian<float>(values);
+    case Format_64_Bit_Float_Big_Endian:
+        return myFromBigEndianByteSwap<double>(values);
+    case Format_64_Bit_Float_Little_Endian:
+        return myFromLittleEndianByteSwap<double>(values);
+    case Format_64_Bit_Float_Big_Endian_Byte_Swap:
+        return qFromBigEndian<double>(values);
+    case Format_64_Bit_Float_Little_Endian_Byte_Swap:
+        return qFromLittleEndian<double>(values);
+    default:
+        return quint16(values[0]);
+    }
+}
+
+void ModbusValueCodec::encodeValue(int format, double value, quint16 *values)
+{
+    if(!std::isfinite(value))
+    {
+        value = 0;
+    }
+    //the rounded value modulo 2^64, narrowing it further keeps the low registers as a wrap would
+    double wrapped = std::fmod(std::round(value), two_to_64);
+    if(wrapped < 0)
+    {
+        wrapped += two_to_64;
+    }
+    quint64 bits = wrapped >= two_to_63 ? quint64(wrapped - two_to_63) | quint64(1) << 63 : quint64(wrapped);
+    switch(format)
+    {
+    case Format_Coil:
+        //a coil follows the lowest bit, a counter toggles it and a square wave sets it
+        values[0] = bits & 1;
+        break;
+    case Format_32_Bit_Signed_Big_Endian:
+    case Format_32_Bit_Unsigned_Big_Endian:
+        qToBigEndian<quint32>(quint32(bits), values);
+        break;
+    case Format_32_Bit_Signed_Little_Endian:
+    case Format_32_Bit_Unsigned_Little_Endian:
+        qToLittleEndian<quint32>(quint32(bits), values);
+        break;
+    case Format_32_Bit_Signed_Big_Endian_Byte_Swap:
+    case Format_32_Bit_Unsigned_Big_Endian_Byte_Swap:
+        myToBigEndianByteSwap<quint32>(quint32(bits), values);
+        break;
+    case Format_32_Bit_Signed_Little_Endian_Byte_Swap:
+    case Format_32_Bit_Unsigned_Little_Endian_Byte_Swap:
+        myToLittleEndianByteSwap<quint32>(quint32(bits), values);
+        break;
+    case Format_64_Bit_Signed_Big_Endian:
+    case Format_64_Bit_Unsigned_Big_Endian:
+        qToBigEndian<quint64>(bits, values);
+        break;
+    case Format_64_Bit_Signed_Little_Endian:
+    case Format_64_Bit_Unsigned_Little_Endian:
+        qToLittleEndian<quint64>(bits, values);
+        break;
+    case Format_64_Bit_Signed_Big_Endian_Byte_Swap:
+    case Format_64_Bit_Unsigned_Big_Endian_Byte_Swap:
+        myToBigEndianByteSwap<quint64>(bits, values);
+        break;
+    case Format_64_Bit_Signed_Little_Endian_Byte_Swap:
+    case Format_64_Bit_Unsigned_Little_Endian_Byte_Swap:
+        myToLittleEndianByteSwap<quint64>(bits, values);
+        break;
+    case Format_32_Bit_Float_Big_Endian:
+        myToBigEndianByteSwap<float>(float(value), values);
+        break;
+    case Format_32_Bit_Float_Little_Endian:
+        myToLittleEndianByteSwap<float>(float(value), values);
+        break;
+    case Format_32_Bit_Float_Big_Endian_Byte_Swap:
+        qToBigEndian<float>(float(value), values);
+        break;
+    case Format_32_Bit_Float_Little_Endian_Byte_Swap:
+        qToLittleEndian<float>(float(value), values);
+        break;
+    case Format_64_Bit_Float_Big_Endian:
+        myToBigEndianByteSwap<double>(value, values);
+        break;
+    case Format_64_Bit_Float_Little_Endian:
+        myToLittleEndianByteSwap<double>(value, values);
+        break;
+    case Format_64_Bit_Float_Big_Endian_Byte_Swap:
+        qToBigEndian<double>(value, values);
+        break;
+    case Format_64_Bit_Float_Little_Endian_Byte_Swap:
+        qToLittleEndian<double>(value, values);
+        break;
+    default:
+        values[0] = quint16(bits);
+        break;
+    }
+}
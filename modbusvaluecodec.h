@@ -0,0 +1,58 @@
+#ifndef MODBUSVALUECODEC_H
+#define MODBUSVALUECODEC_H
+
+#include <QtGlobal>
+
+//how the registers of a value are read, 32 and 64 bit formats span 2 and 4 registers
+enum ModbusValueFormat{
+    Format_None = 0,
+    Format_Coil,
+    Format_Signed,
+    Format_Unsigned,
+    Format_Hex,
+    Format_Ascii_Hex,
+    Format_Binary,
+    Format_32_Bit_Signed_Big_Endian = 32,
+    Format_32_Bit_Signed_Little_Endian,
+    Format_32_Bit_Signed_Big_Endian_Byte_Swap,
+    Format_32_Bit_Signed_Little_Endian_Byte_Swap,
+    Format_32_Bit_Unsigned_Big_Endian,
+    Format_32_Bit_Unsigned_Little_Endian,
+    Format_32_Bit_Unsigned_Big_Endian_Byte_Swap,
+    Format_32_Bit_Unsigned_Little_Endian_Byte_Swap,
+    Format_32_Bit_Float_Big_Endian,
+    Format_32_Bit_Float_Little_Endian,
+    Format_32_Bit_Float_Big_Endian_Byte_Swap,
+    Format_32_Bit_Float_Little_Endian_Byte_Swap,
+    Format_64_Bit_Signed_Big_Endian = 64,
+    Format_64_Bit_Signed_Little_Endian,
+    Format_64_Bit_Signed_Big_Endian_Byte_Swap,
+    Format_64_Bit_Signed_Little_Endian_Byte_Swap,
+    Format_64_Bit_Unsigned_Big_Endian,
+    Format_64_Bit_Unsigned_Little_Endian,
+    Format_64_Bit_Unsigned_Big_Endian_Byte_Swap,
+    Format_64_Bit_Unsigned_Little_Endian_Byte_Swap,
+    Format_64_Bit_Float_Big_Endian,
+    Format_64_Bit_Float_Little_Endian,
+    Format_64_Bit_Float_Big_Endian_Byte_Swap,
+    Format_64_Bit_Float_Little_Endian_Byte_Swap,
+};
+
+/*
+ * Turns the registers of a value into a number and back, for the views as well as for the
+ * generators and deadbands that run on the engine's thread without any of the GUI.
+ */
+
+class ModbusValueCodec
+{
+public:
+    //the number of registers a value of this format spans
+    static int valueWidth(int format);
+    //the value a cell of this format shows for the registers starting at values
+    static double decodeValue(int format, const quint16 *values);
+    //the opposite of decodeValue, integers are rounded and wrap around at the width of the
+    //format the way a register of that width would
+    static void encodeValue(int format, double value, quint16 *values);
+};
+
+#endif // MODBUSVALUECODEC_H
@@ -0,0 +1,82 @@
+#include "modbusvaluegenerator.h"
+#include <QtMath>
+#include <QRandomGenerator>
+#include <cstring>
+#include "modbusvaluecodec.h"
+
+void ModbusValueGenerator::setGenerators(const QList<ModbusGenerator> &generators, qint64 now_ms)
+{
+    m_start_ms = now_ms;
+    //derived values go last, they read what the others wrote
+    m_generators.clear();
+    for(const auto &x : generators)
+    {
+        if(x.type != Generator_Derived)
+        {
+            m_generators.append(x);
+        }
+    }
+    for(const auto &x : generators)
+    {
+        if(x.type == Generator_Derived)
+        {
+            m_generators.append(x);
+        }
+    }
+}
+
+bool ModbusValueGenerator::isEmpty() const
+{
+    return m_generators.isEmpty();
+}
+
+bool ModbusValueGenerator::evaluate(qint64 now_ms, quint16 *values, int size, int first, int count)
+{
+    bool changed{false};
+    for(const auto &x : m_generators)
+    {
+        int width = ModbusValueCodec::valueWidth(x.format);
+        if(x.offset + width > size || x.offset + width <= first || x.offset >= first + count)
+        {
+            continue;
+        }
+        int source_width = ModbusValueCodec::valueWidth(x.source_format);
+        if(x.type == Generator_Derived && x.source + source_width > size)
+        {
+            continue;
+        }
+        quint16 cell[4];
+        ModbusValueCodec::encodeValue(x.format, generate(x, now_ms, values), cell);
+        if(memcmp(&values[x.offset], cell, width * sizeof(quint16)) != 0)
+        {
+            memcpy(&values[x.offset], cell, width * sizeof(quint16));
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+double ModbusValueGenerator::generate(const ModbusGenerator &generator, qint64 now_ms, const quint16 *values) const
+{
+    double period = qMax(1.0, generator.period_ms);
+    //a counter starts at its base when it is set up, the encoding wraps it at the width of its cell
+    qint64 elapsed_ms = qMax<qint64>(0, now_ms - m_start_ms);
+    double phase = std::fmod(elapsed_ms, period) / period;
+    switch(generator.type)
+    {
+    case Generator_Counter:
+        return generator.base + qFloor(elapsed_ms / period) * generator.amplitude;
+    case Generator_Ramp:
+        return generator.base + phase * generator.amplitude;
+    case Generator_Sine:
+        return generator.base + generator.amplitude * qSin(2 * M_PI * phase);
+    case Generator_Square:
+        return generator.base + (phase < 0.5 ? generator.amplitude : 0);
+    case Generator_Random:
+        return generator.base + generator.amplitude * (QRandomGenerator::global()->generateDouble() * 2 - 1);
+    case Generator_Derived:
+        return generator.base + generator.amplitude * ModbusValueCodec::decodeValue(generator.source_format, &values[generator.source]);
+    default:
+        return generator.base;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef MODBUSVALUEGENERATOR_H
+#define MODBUSVALUEGENERATOR_H
+
+#include <QList>
+#include <QVector>
+
+//a simulated value on one cell of a slave block, format is a ModbusValueFormat
+struct ModbusGenerator
+{
+    quint16 offset{0};
+    int format{0};
+    int type{0};
+    double base{0};
+    //the swing of a waveform, the step of a counter or the factor of a derived value
+    double amplitude{1};
+    double period_ms{1000};
+    //the cell a derived value follows, read in its own format
+    quint16 source{0};
+    int source_format{0};
+};
+
+/*
+ * The simulated values of one slave register block. Nothing runs on a timer, a value is worked
+ * out from the time only when a master reads the registers holding it, so a large simulated
+ * plant costs nothing while it is not polled. Derived values are worked out last and see the
+ * values generated in the same read.
+ */
+
+class ModbusValueGenerator
+{
+public:
+    enum GeneratorType{
+        Generator_Counter,
+        Generator_Ramp,
+        Generator_Sine,
+        Generator_Square,
+        Generator_Random,
+        Generator_Derived,
+    };
+
+public:
+    //the waveforms and counters start over from now_ms
+    void setGenerators(const QList<ModbusGenerator> &generators, qint64 now_ms);
+    bool isEmpty() const;
+    //fills the generated cells overlapping the registers read, true when a register changed
+    bool evaluate(qint64 now_ms, quint16 *values, int size, int first, int count);
+
+private:
+    double generate(const ModbusGenerator &generator, qint64 now_ms, const quint16 *values) const;
+
+private:
+    QList<ModbusGenerator> m_generators;
+    qint64 m_start_ms{0};
+};
+
+#endif // MODBUSVALUEGENERATOR_H
@@ -10,8 +10,10 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QMessageBox>
+#include <QFileDialog>
 #include <QMdiArea>
 #include <QMdiSubWindow>
+#include <QThread>
 #include <QIcon>
 #include "modbus_ascii.h"
 #include "modbus_rtu.h"
@@ -23,8 +25,11 @@
 #include "openroutedialog.h"
 #include "utils.h"
 #include "errorcounterdialog.h"
-
-#define PRINT_TRAFFIC 0
+#include "modbusscandialog.h"
+#include "schedulersettingdialog.h"
+#include "modbusmasterengine.h"
+#include "busbudgetdialog.h"
+#include "faultinjectiondialog.h"
 
 const QMap<ModbusErrorCode, QString> ModbusWidget::modbus_error_code_map = {
     {ModbusErrorCode_Timeout, tr("Timeout Error")},
@@ -55,13 +60,15 @@ const QMap<ModbusErrorCode, QString> ModbusWidget::modbus_error_code_comment_map
 
 ModbusWidget::ModbusWidget(bool is_master, QIODevice *com, int protocol, QWidget *parent)
     : ProtocolWidget(com, protocol, parent)
-    , ui(new Ui::ModbusWidget), m_is_master(is_master), m_function05_dialog(nullptr)
+    , ui(new Ui::ModbusWidget), m_is_master(is_master), m_engine_stopped(false), m_next_def_handle(1)
+    , m_scheduler_settings(ModbusScheduler().settings()), m_has_line_settings(false), m_function05_dialog(nullptr)
     , m_function06_dialog(nullptr), m_function15_dialog(nullptr), m_function16_dialog(nullptr)
-    , m_trans_id(0)
+    , m_discovering(false)
 {
     ui->setupUi(this);
 
     m_recv_timeout_ms = 300;
+    m_has_line_settings = ModbusBusBudget::lineSettings(com, m_line_settings);
 
     QVBoxLayout *v_layout = new QVBoxLayout(this);
     setLayout(v_layout);
@@ -86,9 +93,21 @@ ModbusWidget::ModbusWidget(bool is_master, QIODevice *com, int protocol, QWidget
     {
         QAction *error_counter_action = tool_menu->addAction(tr("Error Counter"));
         connect(error_counter_action, &QAction::triggered, this, &ModbusWidget::actionErrorCounterTriggered);
+        QAction *discover_action = tool_menu->addAction(tr("Discover Devices"));
+        connect(discover_action, &QAction::triggered, this, &ModbusWidget::actionDiscoverTriggered);
         QMenu *setting_menu = menu_bar->addMenu(tr("Settings"));
         QAction *timeout_setting_action = setting_menu->addAction(tr("Timeout Setting"));
         connect(timeout_setting_action, &QAction::triggered, this, &ModbusWidget::actionSetRecvTimeoutTriggered);
+        QAction *scheduler_setting_action = setting_menu->addAction(tr("Scheduler Setting"));
+        connect(scheduler_setting_action, &QAction::triggered, this, &ModbusWidget::actionSchedulerSettingTriggered);
+        QAction *synchronized_scans_action = setting_menu->addAction(tr("Synchronized Scans"));
+        synchronized_scans_action->setCheckable(true);
+        connect(synchronized_scans_action, &QAction::toggled, this, &ModbusWidget::actionSynchronizedScansToggled);
+        if(m_has_line_settings)
+        {
+            QAction *bus_budget_action = setting_menu->addAction(tr("Bus Budget"));
+            connect(bus_budget_action, &QAction::triggered, this, &ModbusWidget::actionBusBudgetTriggered);
+        }
         QMenu *functions_menu = menu_bar->addMenu(tr("Functions"));
         QAction *function_05_action = functions_menu->addAction(tr("05:Write Single Coil"));
         connect(function_05_action, &QAction::triggered, this, &ModbusWidget::actionFunction05Triggered);
@@ -101,9 +120,16 @@ ModbusWidget::ModbusWidget(bool is_master, QIODevice *com, int protocol, QWidget
 
         m_error_counter_dialog = new ErrorCounterDialog(this);
         m_error_counter_dialog->hide();
+        m_shared_image_action = nullptr;
     }
     else
     {
+        QMenu *setting_menu = menu_bar->addMenu(tr("Settings"));
+        QAction *fault_injection_action = setting_menu->addAction(tr("Fault Injection"));
+        connect(fault_injection_action, &QAction::triggered, this, &ModbusWidget::actionFaultInjectionTriggered);
+        m_shared_image_action = setting_menu->addAction(tr("Shared Register Image"));
+        m_shared_image_action->setCheckable(true);
+        connect(m_shared_image_action, &QAction::toggled, this, &ModbusWidget::actionSharedImageToggled);
         m_error_counter_dialog = nullptr;
     }
 
@@ -115,39 +141,142 @@ ModbusWidget::ModbusWidget(bool is_master, QIODevice *com, int protocol, QWidget
 
     m_traffic_displayer = new DisplayCommunication(this);
 
-    if(is_master)
-    {
-        m_scan_timer = new QTimer(this);
-        connect(m_scan_timer, &QTimer::timeout, this, &ModbusWidget::scanTimerTimeoutSlot);
-        m_scan_timer->start(1);
-        m_send_timer = new QTimer(this);
-        connect(m_send_timer, &QTimer::timeout, this, &ModbusWidget::sendTimerTimeoutSlot);
-        m_send_timer->start(1);
-        m_recv_timer = new QTimer(this);
-        connect(m_recv_timer, &QTimer::timeout, this, &ModbusWidget::recvTimerTimeoutSlot);
-    }
-    else
-    {
-        connect(m_com, &QIODevice::readyRead, this, &ModbusWidget::comSlaveReadyReadSlot);
-    }
+    m_engine_thread = ModbusMasterEngine::instance()->engineThread();
+    m_engine = new ModbusEngine(m_is_master, m_protocol);
+    m_engine->moveToThread(m_engine_thread);
+    connect(m_engine, &ModbusEngine::updatesReady, this, &ModbusWidget::engineUpdatesReady);
+    connect(m_engine, &ModbusEngine::sharedImageFailed, this, &ModbusWidget::sharedImageFailed);
+    postToEngine([](ModbusEngine *engine){
+        engine->start();
+    });
+    //the engine owns the connection from here on, the base class must not delete it
+    m_com = nullptr;
+    addChannel(com);
 }
 
 ModbusWidget::~ModbusWidget()
 {
+    shutdownEngine();
+    //the thread is shared by every route, the engine is deleted there after its shutdown ran
+    m_engine->deleteLater();
     delete ui;
 }
 
+void ModbusWidget::addChannel(QIODevice *com)
+{
+    //tcp and udp sockets were put on the engine thread before their io started, only connections
+    //driven by this thread's notifiers are left to move; a socket handed out by a local server is
+    //its child, only a parentless object can change threads
+    if(com->thread() != m_engine_thread)
+    {
+        com->setParent(nullptr);
+        com->moveToThread(m_engine_thread);
+    }
+    m_coms.append(com);
+    connect(com, &QObject::destroyed, this, [this, com](){
+        m_coms.removeOne(com);
+    });
+    postToEngine([com](ModbusEngine *engine){
+        engine->addChannel(com);
+    });
+}
+
+void ModbusWidget::setChannelDispatch(int dispatch)
+{
+    postToEngine([dispatch](ModbusEngine *engine){
+        engine->setChannelDispatch(dispatch);
+    });
+}
+
+void ModbusWidget::closeEvent(QCloseEvent *event)
+{
+    shutdownEngine();
+    ProtocolWidget::closeEvent(event);
+}
+
+void ModbusWidget::postToEngine(const std::function<void(ModbusEngine*)> &call)
+{
+    ModbusEngine *engine = m_engine;
+    QMetaObject::invokeMethod(engine, [engine, call](){
+        call(engine);
+    }, Qt::QueuedConnection);
+}
+
+void ModbusWidget::shutdownEngine()
+{
+    if(m_engine_stopped)
+    {
+        return;
+    }
+    m_engine_stopped = true;
+    postToEngine([](ModbusEngine *engine){
+        engine->shutdown();
+    });
+}
+
 void ModbusWidget::RegsViewWidgetClosed(ModbusRegReadDefinitions *reg_defines)
 {
+    quint32 def_handle = m_reg_def_handle_map.value(reg_defines);
+    postToEngine([def_handle](ModbusEngine *engine){
+        engine->removeDefinition(def_handle);
+    });
+    m_handle_widget_map.remove(def_handle);
+    m_reg_def_handle_map.remove(reg_defines);
     m_reg_defines.removeOne(reg_defines);
-    m_last_scan_timestamp_map.remove(reg_defines);
     m_reg_def_widget_map.remove(reg_defines);
     delete reg_defines;
 }
 
+void ModbusWidget::deadbandsChanged(ModbusRegReadDefinitions *reg_defines)
+{
+    RegsViewWidget *regs_view_widget = m_reg_def_widget_map.value(reg_defines);
+    if(!regs_view_widget)
+    {
+        return;
+    }
+    QList<ModbusDeadband> deadbands = regs_view_widget->deadbands();
+    quint32 def_handle = m_reg_def_handle_map.value(reg_defines);
+    postToEngine([def_handle, deadbands](ModbusEngine *engine){
+        engine->setDeadbands(def_handle, deadbands);
+    });
+}
+
+void ModbusWidget::generatorsChanged(ModbusRegReadDefinitions *reg_defines)
+{
+    RegsViewWidget *regs_view_widget = m_reg_def_widget_map.value(reg_defines);
+    if(!regs_view_widget)
+    {
+        return;
+    }
+    QList<ModbusGenerator> generators = regs_view_widget->generators();
+    quint32 def_handle = m_reg_def_handle_map.value(reg_defines);
+    postToEngine([def_handle, generators](ModbusEngine *engine){
+        engine->setGenerators(def_handle, generators);
+    });
+}
+
+void ModbusWidget::registerValuesEdited(ModbusRegReadDefinitions *reg_defines, int offset, int width)
+{
+    RegsViewWidget *regs_view_widget = m_reg_def_widget_map.value(reg_defines);
+    if(!regs_view_widget || offset < 0 || width <= 0 || offset + width > reg_defines->quantity)
+    {
+        return;
+    }
+    //only the edited value is written, the rest of the view may be older than what a master,
+    //a generator or the shared image put into the block since
+    QVector<quint16> values(width, 0);
+    regs_view_widget->getRegisterValues(values.data(), reg_defines->reg_addr + offset, width);
+    quint32 def_handle = m_reg_def_handle_map.value(reg_defines);
+    postToEngine([def_handle, offset, values](ModbusEngine *engine){
+        engine->writeValues(def_handle, offset, values);
+    });
+}
+
 void ModbusWidget::writeFunctionTriggered(QByteArray pack)
 {
-    m_manual_list.append(pack);
+    postToEngine([pack](ModbusEngine *engine){
+        engine->write(pack);
+    });
 }
 
 void ModbusWidget::writeFrameTriggered(const ModbusFrameInfo &frame_info)
@@ -172,7 +301,7 @@ void ModbusWidget::writeFrameTriggered(const ModbusFrameInfo &frame_info)
         break;
     }
     }
-    m_manual_list.append(write_pack);
+    writeFunctionTriggered(write_pack);
 }
 
 void ModbusWidget::actionFunction05Triggered()
@@ -276,277 +405,194 @@ void ModbusWidget::actionSetRecvTimeoutTriggered()
     if(input_ok)
     {
         m_recv_timeout_ms = recv_timeout;
+        postToEngine([recv_timeout](ModbusEngine *engine){
+            engine->setRecvTimeout(recv_timeout);
+        });
     }
 }
 
-void ModbusWidget::actionDisplayTrafficTriggered()
+void ModbusWidget::actionSchedulerSettingTriggered()
 {
-    m_traffic_displayer->show();
+    SchedulerSettingDialog *scheduler_setting_dialog = new SchedulerSettingDialog(m_scheduler_settings, this);
+    connect(scheduler_setting_dialog, &SchedulerSettingDialog::schedulerSettingsChanged, this, &ModbusWidget::schedulerSettingsChanged);
+    scheduler_setting_dialog->show();
 }
 
-void ModbusWidget::actionErrorCounterTriggered()
+void ModbusWidget::schedulerSettingsChanged(const ModbusSchedulerSettings &settings)
 {
-    if(m_error_counter_dialog)
-    {
-        m_error_counter_dialog->show();
-    }
+    m_scheduler_settings = settings;
+    postToEngine([settings](ModbusEngine *engine){
+        engine->setSchedulerSettings(settings);
+    });
 }
 
-void ModbusWidget::actionCascadeWindowTriggered()
+void ModbusWidget::actionFaultInjectionTriggered()
 {
-    m_regs_area->cascadeSubWindows();
+    FaultInjectionDialog *fault_injection_dialog = new FaultInjectionDialog(m_fault_settings, this);
+    connect(fault_injection_dialog, &FaultInjectionDialog::faultSettingsChanged, this, &ModbusWidget::faultSettingsChanged);
+    fault_injection_dialog->show();
 }
 
-void ModbusWidget::actionTileWindowTriggered()
+void ModbusWidget::faultSettingsChanged(const ModbusFaultSettings &settings)
 {
-    m_regs_area->tileSubWindows();
+    m_fault_settings = settings;
+    postToEngine([settings](ModbusEngine *engine){
+        engine->setFaultSettings(settings);
+    });
 }
 
-void ModbusWidget::regDefinitionsCreated(ModbusRegReadDefinitions *reg_defines)
+void ModbusWidget::actionSharedImageToggled(bool checked)
 {
-    if(validRegsDefinition(reg_defines))
+    QString file_name;
+    if(checked)
     {
-        m_reg_defines.append(reg_defines);
-        RegsViewWidget *regs_view_widget = new RegsViewWidget(reg_defines,this);
-        connect(regs_view_widget, &RegsViewWidget::writeFunctionTriggered, this, &ModbusWidget::writeFrameTriggered);
-        connect(regs_view_widget, &RegsViewWidget::closed, this, &ModbusWidget::RegsViewWidgetClosed);
-        regs_view_widget->setWindowTitle(QString("ID:%1 - Registers : %2").arg(reg_defines->id).arg(reg_defines->reg_addr));
-        m_last_scan_timestamp_map[reg_defines] = 0;
-        m_reg_def_widget_map[reg_defines] = regs_view_widget;
-        m_regs_area->addSubWindow(regs_view_widget);
-        regs_view_widget->show();
-    }
-    else
-    {
-        FloatBox::message("Illegal Registers Deinition", 3000, geometry());
-        delete reg_defines;
+        //an existing image is opened as it is, its values are served
+        file_name = QFileDialog::getSaveFileName(this, tr("Shared Register Image"), QString(), tr("Register Image (*.mbri);;All Files (*)"),
+                                                 nullptr, QFileDialog::DontConfirmOverwrite);
+        if(file_name.isEmpty())
+        {
+            QSignalBlocker blocker(m_shared_image_action);
+            m_shared_image_action->setChecked(false);
+            return;
+        }
     }
-
+    m_shared_image_action->setToolTip(file_name);
+    postToEngine([file_name](ModbusEngine *engine){
+        engine->setSharedImage(file_name);
+    });
 }
 
-void ModbusWidget::scanTimerTimeoutSlot()
+void ModbusWidget::sharedImageFailed(const QString &error)
 {
-    if(!m_cycle_list.isEmpty())
+    if(m_shared_image_action)
     {
-        return;
-    }
-    quint64 now_timestamp = QDateTime::currentMSecsSinceEpoch();
-    for(auto &x : m_reg_defines)
-    {
-        if(now_timestamp - m_last_scan_timestamp_map[x] >= x->scan_rate)
-        {
-            m_cycle_list.append(x->packet);
-            m_cycle_widget_list.append(m_reg_def_widget_map[x]);
-            m_last_scan_timestamp_map[x] = now_timestamp;
-        }
+        QSignalBlocker blocker(m_shared_image_action);
+        m_shared_image_action->setChecked(false);
     }
+    QMessageBox::warning(this, tr("Shared Register Image"), error);
 }
 
-void ModbusWidget::sendTimerTimeoutSlot()
+void ModbusWidget::actionBusBudgetTriggered()
 {
-    bool has_pack{false};
-    if(!m_manual_list.isEmpty())
-    {
-        has_pack = true;
-        m_master_last_send_pack = m_manual_list.first();
-    }
-    else if(!m_cycle_list.isEmpty())
+    QList<ModbusRegReadDefinitions> reg_defs;
+    for(auto x : m_reg_defines)
     {
-        has_pack = true;
-        m_master_last_send_pack = m_cycle_list.first();
-        RegsViewWidget *regs_view_widget = m_cycle_widget_list.first();
-        regs_view_widget->increaseSendCount();
+        reg_defs.append(*x);
     }
-    if(has_pack)
+    BusBudgetDialog *bus_budget_dialog = new BusBudgetDialog(ModbusBusBudget(m_protocol, m_line_settings), reg_defs, this);
+    connect(bus_budget_dialog, &BusBudgetDialog::scanRatesChanged, this, std::bind(&ModbusWidget::scanRatesChanged, this, m_reg_defines, std::placeholders::_1));
+    bus_budget_dialog->show();
+}
+
+void ModbusWidget::actionSynchronizedScansToggled(bool checked)
+{
+    //blocks with the same scan rate are read in one go instead of taking turns across the period
+    int phasing = checked ? ModbusEngine::Phasing_Synchronized : ModbusEngine::Phasing_Spread;
+    postToEngine([phasing](ModbusEngine *engine){
+        engine->setScanPhasing(phasing);
+    });
+}
+
+void ModbusWidget::scanRatesChanged(const QList<ModbusRegReadDefinitions*> &reg_defines, const QList<quint32> &scan_rates)
+{
+    for(int i = 0; i < reg_defines.size() && i < scan_rates.size(); ++i)
     {
-#if PRINT_TRAFFIC
-        qDebug()<<"Master Send: "<<m_master_last_send_pack.toHex(' ').toUpper();
-#endif
-        if(m_protocol == MODBUS_TCP || m_protocol == MODBUS_UDP)
+        //a view closed or modified while the dialog was open is left alone
+        ModbusRegReadDefinitions *reg_def = reg_defines[i];
+        if(!m_reg_defines.contains(reg_def) || reg_def->scan_rate == scan_rates[i])
         {
-            setModbusPacketTransID(m_master_last_send_pack, m_trans_id);
-            ++m_trans_id;
+            continue;
         }
-        m_com->write(m_master_last_send_pack);
-        connect(m_com, &QIODevice::readyRead, this, &ModbusWidget::comMasterReadyReadSlot);
-        if(m_traffic_displayer->isVisible())
-        {
-            m_traffic_displayer->appendPacket(QString("Tx: %1").arg(m_master_last_send_pack.toHex(' ').toUpper()), false);
-        }
-        m_send_timer->stop();
-        m_recv_timer->start(m_recv_timeout_ms);
+        reg_def->scan_rate = scan_rates[i];
+        quint32 def_handle = m_reg_def_handle_map.value(reg_def);
+        quint32 scan_rate = scan_rates[i];
+        postToEngine([def_handle, scan_rate](ModbusEngine *engine){
+            engine->setScanRate(def_handle, scan_rate);
+        });
     }
 }
 
-void ModbusWidget::recvTimerTimeoutSlot()
+void ModbusWidget::actionDisplayTrafficTriggered()
+{
+    m_traffic_displayer->show();
+    postToEngine([](ModbusEngine *engine){
+        engine->setTrafficEnabled(true);
+    });
+}
+
+void ModbusWidget::actionErrorCounterTriggered()
 {
-    m_recv_timer->stop();
-    RegsViewWidget *regs_view_widget {nullptr};
-    if(!m_manual_list.isEmpty())
-    {
-        m_manual_list.removeFirst();
-    }
-    else if(!m_cycle_list.isEmpty())
-    {
-        m_cycle_list.removeFirst();
-        regs_view_widget = m_cycle_widget_list.takeFirst();
-    }
-    m_master_last_send_frame = Modbus_RTU::slavePack2Frame(m_master_last_send_pack);
-    if(m_master_last_send_frame.function == ModbusWriteSingleCoil ||
-        m_master_last_send_frame.function == ModbusWriteMultipleCoils ||
-        m_master_last_send_frame.function == ModbusWriteSingleRegister ||
-        m_master_last_send_frame.function == ModbusWriteMultipleRegisters)
-    {
-        emit writeFunctionResponsed(ModbusErrorCode_Timeout);
-    }
-    if(!m_recv_buffer.isEmpty())
-    {
-        m_recv_buffer.clear();
-    }
     if(m_error_counter_dialog)
     {
-        m_error_counter_dialog->increaseErrorCount(ModbusErrorCode_Timeout);
-    }
-    if(regs_view_widget)
-    {
-        regs_view_widget->increaseErrorCount();
-        regs_view_widget->setErrorInfo(tr("Timeout Error"));
+        m_error_counter_dialog->show();
     }
-    disconnect(m_com, &QIODevice::readyRead, this, &ModbusWidget::comMasterReadyReadSlot);
-    m_send_timer->start();
 }
 
-void ModbusWidget::comMasterReadyReadSlot()
+void ModbusWidget::actionDiscoverTriggered()
 {
-    m_recv_buffer.append(m_com->readAll());
-    bool is_intact {false};
-    ModbusFrameInfo frame_info{};
-    switch(m_protocol)
+    if(m_discovering)
     {
-    case MODBUS_RTU:
-    {
-        is_intact = Modbus_RTU::validPack(m_recv_buffer);
-        if(is_intact)
-        {
-            frame_info = Modbus_RTU::masterPack2Frame(m_recv_buffer);
-            m_master_last_send_frame = Modbus_RTU::slavePack2Frame(m_master_last_send_pack);
-        }
-        break;
-    }
-    case MODBUS_ASCII:
-    {
-        is_intact = Modbus_ASCII::validPack(m_recv_buffer);
-        if(is_intact)
-        {
-            frame_info = Modbus_ASCII::masterPack2Frame(m_recv_buffer);
-            m_master_last_send_frame = Modbus_ASCII::slavePack2Frame(m_master_last_send_pack);
-        }
-        break;
-    }
-    case MODBUS_TCP:
-    case MODBUS_UDP:
-    {
-        is_intact = Modbus_TCP::validPack(m_recv_buffer);
-        if(is_intact)
-        {
-            frame_info = Modbus_TCP::masterPack2Frame(m_recv_buffer);
-            m_master_last_send_frame = Modbus_TCP::slavePack2Frame(m_master_last_send_pack);
-        }
-        break;
-    }
-    default:
-    {
-        break;
-    }
-    }
-    if(is_intact)
-    {
-#if PRINT_TRAFFIC
-        qDebug()<<"Master Recv: "<<m_recv_buffer.toHex(' ').toUpper();
-#endif
-        if(frame_info.id == m_master_last_send_frame.id)
-        {
-            if(((m_protocol == MODBUS_TCP || m_protocol == MODBUS_UDP) && frame_info.trans_id == m_master_last_send_frame.trans_id)
-                || (m_protocol != MODBUS_TCP && m_protocol != MODBUS_UDP))
-            {
-                if(m_traffic_displayer->isVisible())
-                {
-                    m_traffic_displayer->appendPacket(QString("Rx: %1").arg(m_recv_buffer.toHex(' ').toUpper()), frame_info.function > ModbusFunctionError);
-                }
-                m_recv_timer->stop();
-                processModbusFrame(frame_info);
-                disconnect(m_com, &QIODevice::readyRead, this, &ModbusWidget::comMasterReadyReadSlot);
-                m_send_timer->start();
-            }
-        }
-        m_recv_buffer.clear();
+        return;
     }
+    m_discovering = true;
+    postToEngine([](ModbusEngine *engine){
+        engine->pause();
+    });
+    //the scanner runs next to the engine, on the thread the connections belong to
+    ModbusScanDialog *scan_dialog = new ModbusScanDialog(m_coms, m_protocol, m_engine_thread, this);
+    scan_dialog->setAttribute(Qt::WA_DeleteOnClose);
+    connect(scan_dialog, &ModbusScanDialog::readDefinitionsCreated, this, &ModbusWidget::regDefinitionsCreated);
+    connect(scan_dialog, &QObject::destroyed, this, &ModbusWidget::discoverFinished);
+    scan_dialog->show();
 }
 
-void ModbusWidget::comSlaveReadyReadSlot()
+void ModbusWidget::discoverFinished()
 {
-    m_recv_buffer.append(m_com->readAll());
+    m_discovering = false;
+    postToEngine([](ModbusEngine *engine){
+        engine->resume();
+    });
+}
 
-    bool is_intact {false};
-    ModbusFrameInfo frame_info{};
-    switch(m_protocol)
-    {
-    case MODBUS_RTU:
-    {
-        is_intact = Modbus_RTU::validPack(m_recv_buffer);
-        if(is_intact)
-        {
-            frame_info = Modbus_RTU::slavePack2Frame(m_recv_buffer);
-        }
-        break;
-    }
-    case MODBUS_ASCII:
-    {
-        is_intact = Modbus_ASCII::validPack(m_recv_buffer);
-        if(is_intact)
-        {
-            frame_info = Modbus_ASCII::slavePack2Frame(m_recv_buffer);
-        }
-        break;
-    }
-    case MODBUS_TCP:
-    case MODBUS_UDP:
-    {
-        is_intact = Modbus_TCP::validPack(m_recv_buffer);
-        if(is_intact)
-        {
-            frame_info = Modbus_TCP::slavePack2Frame(m_recv_buffer);
-        }
-        break;
-    }
-    default:
+void ModbusWidget::actionCascadeWindowTriggered()
+{
+    m_regs_area->cascadeSubWindows();
+}
+
+void ModbusWidget::actionTileWindowTriggered()
+{
+    m_regs_area->tileSubWindows();
+}
+
+void ModbusWidget::regDefinitionsCreated(ModbusRegReadDefinitions *reg_defines)
+{
+    if(validRegsDefinition(reg_defines))
     {
-        break;
-    }
+        m_reg_defines.append(reg_defines);
+        RegsViewWidget *regs_view_widget = new RegsViewWidget(reg_defines,this);
+        connect(regs_view_widget, &RegsViewWidget::writeFunctionTriggered, this, &ModbusWidget::writeFrameTriggered);
+        connect(regs_view_widget, &RegsViewWidget::registerValuesEdited, this, &ModbusWidget::registerValuesEdited);
+        connect(regs_view_widget, &RegsViewWidget::deadbandsChanged, this, &ModbusWidget::deadbandsChanged);
+        connect(regs_view_widget, &RegsViewWidget::generatorsChanged, this, &ModbusWidget::generatorsChanged);
+        connect(regs_view_widget, &RegsViewWidget::closed, this, &ModbusWidget::RegsViewWidgetClosed);
+        regs_view_widget->setWindowTitle(QString("ID:%1 - Registers : %2").arg(reg_defines->id).arg(reg_defines->reg_addr));
+        quint32 def_handle = m_next_def_handle++;
+        m_reg_def_widget_map[reg_defines] = regs_view_widget;
+        m_reg_def_handle_map[reg_defines] = def_handle;
+        m_handle_widget_map[def_handle] = regs_view_widget;
+        ModbusRegReadDefinitions reg_def = *reg_defines;
+        postToEngine([def_handle, reg_def](ModbusEngine *engine){
+            engine->addDefinition(def_handle, reg_def);
+        });
+        m_regs_area->addSubWindow(regs_view_widget);
+        regs_view_widget->show();
     }
-    if(is_intact)
+    else
     {
-#if PRINT_TRAFFIC
-        qDebug()<<"Slave Recv: "<<m_recv_buffer.toHex(' ').toUpper();
-#endif
-        bool has_id{false};
-        for(auto &x : m_reg_defines)
-        {
-            if(x->id == frame_info.id)
-            {
-                has_id = true;
-            }
-        }
-        if(has_id)
-        {
-            if(m_traffic_displayer->isVisible())
-            {
-                m_traffic_displayer->appendPacket(QString("Rx: %1").arg(m_recv_buffer.toHex(' ').toUpper()), false);
-            }
-            processModbusFrame(frame_info);
-        }
-        m_recv_buffer.clear();
+        FloatBox::message("Illegal Registers Deinition", 3000, geometry());
+        delete reg_defines;
     }
+
 }
 
 void ModbusWidget::modifyReadDefFinished(RegsViewWidget *regs_view_widget, ModbusRegReadDefinitions *old_def, ModbusRegReadDefinitions *new_def)
@@ -556,13 +602,16 @@ void ModbusWidget::modifyReadDefFinished(RegsViewWidget *regs_view_widget, Modbu
     {
         m_reg_defines.removeOne(old_def);
         m_reg_defines.append(new_def);
-        quint64 last_scan_timestamp = m_last_scan_timestamp_map[old_def];
-        m_last_scan_timestamp_map.remove(old_def);
-        m_last_scan_timestamp_map[new_def] = last_scan_timestamp;
         m_reg_def_widget_map.remove(old_def);
         m_reg_def_widget_map[new_def] = regs_view_widget;
+        quint32 def_handle = m_reg_def_handle_map.take(old_def);
+        m_reg_def_handle_map[new_def] = def_handle;
         delete old_def;
         regs_view_widget->setRegDef(new_def);
+        ModbusRegReadDefinitions reg_def = *new_def;
+        postToEngine([def_handle, reg_def](ModbusEngine *engine){
+            engine->modifyDefinition(def_handle, reg_def);
+        });
     }
     else
     {
@@ -595,207 +644,58 @@ bool ModbusWidget::validRegsDefinition(ModbusRegReadDefinitions *reg_def)
     return true;
 }
 
-ModbusRegReadDefinitions *ModbusWidget::getSlaveReadDefinitions(int id, int function, int reg_addr, int quantity, ModbusErrorCode &error_code)
-{
-    bool found_id {false};
-    for(auto &x : m_reg_defines)
-    {
-        if(x->id == id)
-        {
-            found_id = true;
-            if(reg_addr >= x->reg_addr)
-            {
-                if(reg_addr + quantity <= x->reg_addr + x->quantity)
-                {
-                    if(x->function == function ||
-                        ((function == ModbusWriteSingleCoil || function == ModbusWriteMultipleCoils) && x->function == ModbusCoilStatus) ||
-                        ((function == ModbusWriteSingleRegister || function ==ModbusWriteMultipleRegisters) && x->function == ModbusHoldingRegisters))
-                    {
-                        error_code = ModbusErrorCode_OK;
-                        return x;
-                    }
-                    else
-                    {
-                        error_code = ModbusErrorCode_Illegal_Function;
-                        return nullptr;
-                    }
-                }
-            }
-        }
-    }
-    if(found_id)
-    {
-        error_code = ModbusErrorCode_Illegal_Data_Address;
-    }
-    else
-    {
-        error_code = ModbusErrorCode_OK;
-    }
-    return nullptr;
-}
-
-void ModbusWidget::processModbusFrame(const ModbusFrameInfo &frame_info)
+void ModbusWidget::engineUpdatesReady(const ModbusEngineUpdates &updates)
 {
-    if(m_is_master)
+    for(const auto &x : updates.views)
     {
-        RegsViewWidget *regs_view_widget{nullptr};
-        if(!m_manual_list.isEmpty())
-        {
-            m_manual_list.removeFirst();
-        }
-        else if(!m_cycle_list.isEmpty())
-        {
-            m_cycle_list.removeFirst();
-            regs_view_widget = m_cycle_widget_list.takeFirst();
-        }
-        if(frame_info.function > ModbusFunctionError)
+        RegsViewWidget *regs_view_widget = m_handle_widget_map.value(x.def_handle);
+        if(!regs_view_widget)
         {
-            ModbusErrorCode error_code = (ModbusErrorCode)(frame_info.reg_values[0]);
-            int func_code = frame_info.function - ModbusFunctionError;
-            if(func_code == ModbusWriteSingleCoil ||
-                func_code == ModbusWriteMultipleCoils ||
-                func_code == ModbusWriteSingleRegister ||
-                func_code == ModbusWriteMultipleRegisters)
-            {
-                emit writeFunctionResponsed(error_code);
-            }
-            if(m_error_counter_dialog)
-            {
-                m_error_counter_dialog->increaseErrorCount(error_code);
-            }
-            if(regs_view_widget)
-            {
-                regs_view_widget->increaseErrorCount();
-                regs_view_widget->setErrorInfo(modbus_error_code_map[error_code]);
-            }
+            //the view was closed while the batch was on its way
+            continue;
         }
-        else if(frame_info.function == ModbusReadCoils ||
-                 frame_info.function == ModbusReadDescreteInputs)
+        ModbusRegReadDefinitions *reg_def = getKeyByValue(m_reg_def_widget_map, regs_view_widget);
+        if(x.has_values && reg_def)
         {
-            if(regs_view_widget)
+            for(const auto &change : x.changes)
             {
-                quint8 *coils = (quint8*)frame_info.reg_values;
-                for(int i = 0; i < m_master_last_send_frame.quantity; ++i)
-                {
-                    int byte_index = i / 8;
-                    int bit_index = i % 8;
-                    regs_view_widget->setCoilValue(m_master_last_send_frame.reg_addr + i, getBit(coils[byte_index], bit_index));
-                }
-                regs_view_widget->setErrorInfo("");
+                regs_view_widget->setRegisterValues(change.values.constData(), reg_def->reg_addr + change.offset, change.values.size());
             }
         }
-        else if(frame_info.function == ModbusReadHoldingRegisters ||
-                   frame_info.function == ModbusReadInputRegisters)
+        if(x.send_count || x.error_count)
         {
-            if(regs_view_widget)
-            {
-                regs_view_widget->setRegisterValues(frame_info.reg_values, m_master_last_send_frame.reg_addr, frame_info.quantity);
-                regs_view_widget->setErrorInfo("");
-            }
+            regs_view_widget->increaseCounts(x.send_count, x.error_count);
         }
-        else if(m_master_last_send_frame.function == ModbusWriteSingleCoil ||
-                   m_master_last_send_frame.function == ModbusWriteMultipleCoils ||
-                   m_master_last_send_frame.function == ModbusWriteSingleRegister ||
-                   m_master_last_send_frame.function == ModbusWriteMultipleRegisters)
+        if(x.has_error)
         {
-            emit writeFunctionResponsed(ModbusErrorCode_OK);
-            if(regs_view_widget)
-            {
-                regs_view_widget->setErrorInfo("");
-            }
+            regs_view_widget->setErrorInfo(x.error_code == ModbusErrorCode_OK ? QString() : modbus_error_code_map[(ModbusErrorCode)x.error_code]);
         }
-        else
+    }
+    for(auto x : updates.write_results)
+    {
+        emit writeFunctionResponsed(x);
+    }
+    if(m_error_counter_dialog)
+    {
+        for(auto x : updates.error_codes)
         {
-            qDebug()<<"Unkown Modbus Function Code : "<<frame_info.function <<frame_info.id <<frame_info.reg_addr<<frame_info.quantity;
+            m_error_counter_dialog->increaseErrorCount(x);
         }
     }
-    else
+    if(!updates.traffic.isEmpty())
     {
-        ModbusErrorCode error_code{ModbusErrorCode_OK};
-        ModbusRegReadDefinitions *reg_def = getSlaveReadDefinitions(frame_info.id, frame_info.function, frame_info.reg_addr,frame_info.quantity,error_code);
-        ModbusFrameInfo reply_frame{};
-        reply_frame.id = frame_info.id;
-        reply_frame.trans_id = frame_info.trans_id;
-        if(reg_def)
+        if(m_traffic_displayer->isVisible())
         {
-            reply_frame.function = frame_info.function;
-            reply_frame.reg_addr = frame_info.reg_addr;
-            reply_frame.quantity = frame_info.quantity;
-            RegsViewWidget *regs_view_widget = m_reg_def_widget_map[reg_def];
-            if(frame_info.function == ModbusReadHoldingRegisters || frame_info.function == ModbusReadInputRegisters)
-            {
-                regs_view_widget->getRegisterValues(reply_frame.reg_values,reply_frame.reg_addr,reply_frame.quantity);
-            }
-            else if(frame_info.function == ModbusReadCoils || frame_info.function == ModbusReadDescreteInputs)
+            for(const auto &x : updates.traffic)
             {
-                quint8 *coils = (quint8*)reply_frame.reg_values;
-                for(int i = 0;i < reply_frame.quantity;++i)
-                {
-                    quint16 value {0};
-                    regs_view_widget->getCoilValue(reply_frame.reg_addr + i,&value);
-                    int byte_index = i / 8;
-                    int bit_index = i % 8;
-                    setBit(coils[byte_index], bit_index, value);
-                }
-            }
-            else if(frame_info.function == ModbusWriteSingleCoil)
-            {
-
-                reply_frame.reg_values[0] = frame_info.reg_values[0];
-                regs_view_widget->setCoilValue(frame_info.reg_addr, frame_info.reg_values[0] >> 8 & 0xFF ? 1 : 0);
-            }
-            else if(frame_info.function == ModbusWriteMultipleCoils)
-            {
-                for(int i = 0;i < frame_info.quantity;++i)
-                {
-                    regs_view_widget->setCoilValue(frame_info.reg_addr + i, getBit(frame_info.reg_values[i / 16], i % 16));
-                }
-            }
-            else if(frame_info.function == ModbusWriteSingleRegister)
-            {
-                reply_frame.reg_values[0] = frame_info.reg_values[0];
-                regs_view_widget->setRegisterValues(frame_info.reg_values, frame_info.reg_addr, 1);
-            }
-            else if(frame_info.function == ModbusWriteMultipleRegisters)
-            {
-                regs_view_widget->setRegisterValues(frame_info.reg_values, frame_info.reg_addr, frame_info.quantity);
+                m_traffic_displayer->appendPacket(x.first, x.second);
             }
         }
         else
         {
-            reply_frame.function = frame_info.function + ModbusFunctionError;
-            reply_frame.reg_values[0] = error_code;
-        }
-        QByteArray reply_pack;
-        switch(m_protocol)
-        {
-        case MODBUS_RTU:
-        {
-            reply_pack = Modbus_RTU::slaveFrame2Pack(reply_frame);
-            break;
-        }
-        case MODBUS_ASCII:
-        {
-            reply_pack = Modbus_ASCII::slaveFrame2Pack(reply_frame);
-            break;
-        }
-        case MODBUS_TCP:
-        case MODBUS_UDP:
-        {
-            reply_pack = Modbus_TCP::slaveFrame2Pack(reply_frame);
-            break;
-        }
-        default:
-            break;
-        }
-#if PRINT_TRAFFIC
-        qDebug()<<"Slave Send: "<<reply_pack.toHex(' ').toUpper();
-#endif
-        m_com->write(reply_pack);
-        if(m_traffic_displayer->isVisible())
-        {
-            m_traffic_displayer->appendPacket(QString("Tx: %1").arg(reply_pack.toHex(' ').toUpper()), reply_frame.function > ModbusFunctionError);
+            postToEngine([](ModbusEngine *engine){
+                engine->setTrafficEnabled(false);
+            });
         }
     }
 }
-
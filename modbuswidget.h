@@ -4,17 +4,21 @@
 #include "protocolwidget.h"
 #include <QMdiArea>
 #include <QList>
+#include <functional>
 #include "ModbusFrameInfo.h"
+#include "modbusengine.h"
+#include "modbusbusbudget.h"
 #include "modbuswritesinglecoildialog.h"
 #include "modbuswritesingleregisterdialog.h"
 #include "modbuswritemultiplecoilsdialog.h"
 #include "modbuswritemultipleregistersdialog.h"
 
 struct ModbusRegReadDefinitions;
-class QTimer;
+class QThread;
 class RegsViewWidget;
 class DisplayCommunication;
 class ErrorCounterDialog;
+class QAction;
 
 namespace Ui {
 class ModbusWidget;
@@ -27,12 +31,17 @@ class ModbusWidget : public ProtocolWidget
 public:
     explicit ModbusWidget(bool is_master, QIODevice *com, int protocol, QWidget *parent = nullptr);
     ~ModbusWidget();
+    void addChannel(QIODevice *com);
+    void setChannelDispatch(int dispatch);
 
 signals:
     void writeFunctionResponsed(int error_code);
 
 private slots:
     void RegsViewWidgetClosed(ModbusRegReadDefinitions *reg_defines);
+    void registerValuesEdited(ModbusRegReadDefinitions *reg_defines, int offset, int width);
+    void deadbandsChanged(ModbusRegReadDefinitions *reg_defines);
+    void generatorsChanged(ModbusRegReadDefinitions *reg_defines);
     void writeFunctionTriggered(QByteArray pack);
     void writeFrameTriggered(const ModbusFrameInfo &frame_info);
     void actionFunction05Triggered();
@@ -42,46 +51,62 @@ private slots:
     void actionModifyRegDefTriggered();
     void actionAddRegTriggered();
     void actionSetRecvTimeoutTriggered();
+    void actionSchedulerSettingTriggered();
+    void schedulerSettingsChanged(const ModbusSchedulerSettings &settings);
+    void actionBusBudgetTriggered();
+    void actionSynchronizedScansToggled(bool checked);
+    void actionFaultInjectionTriggered();
+    void faultSettingsChanged(const ModbusFaultSettings &settings);
+    void actionSharedImageToggled(bool checked);
+    void sharedImageFailed(const QString &error);
+    void scanRatesChanged(const QList<ModbusRegReadDefinitions*> &reg_defines, const QList<quint32> &scan_rates);
     void actionDisplayTrafficTriggered();
     void actionErrorCounterTriggered();
+    void actionDiscoverTriggered();
+    void discoverFinished();
     void actionCascadeWindowTriggered();
     void actionTileWindowTriggered();
     void regDefinitionsCreated(ModbusRegReadDefinitions *reg_defines);
-    void scanTimerTimeoutSlot();
-    void sendTimerTimeoutSlot();
-    void recvTimerTimeoutSlot();
-    void comMasterReadyReadSlot();
-    void comSlaveReadyReadSlot();
     void modifyReadDefFinished(RegsViewWidget *regs_view_widget, ModbusRegReadDefinitions *old_def, ModbusRegReadDefinitions *new_def);
+    void engineUpdatesReady(const ModbusEngineUpdates &updates);
+
+protected:
+    void closeEvent(QCloseEvent *event) override;
 
 private:
     bool validRegsDefinition(ModbusRegReadDefinitions *reg_def);
-    ModbusRegReadDefinitions *getSlaveReadDefinitions(int id, int function, int reg_addr, int quantity, ModbusErrorCode &error_code);
-    void processModbusFrame(const ModbusFrameInfo &frame_info);
+    //runs a call on the engine's thread, the widget never touches the engine directly
+    void postToEngine(const std::function<void(ModbusEngine*)> &call);
+    void shutdownEngine();
 
 private:
     Ui::ModbusWidget *ui;
     QMdiArea *m_regs_area;
     bool m_is_master;
-    QTimer *m_scan_timer;
-    QTimer *m_send_timer;
-    QTimer *m_recv_timer;
-    QByteArray m_recv_buffer;
-    QByteArray m_master_last_send_pack;
-    ModbusFrameInfo m_master_last_send_frame;
+    //the protocol engine and the connections it owns live on the master engine's thread
+    QThread *m_engine_thread;
+    ModbusEngine *m_engine;
+    bool m_engine_stopped;
+    QList<QIODevice*> m_coms;
     QList<ModbusRegReadDefinitions*> m_reg_defines;
-    QMap<ModbusRegReadDefinitions*,quint64> m_last_scan_timestamp_map;
     QMap<ModbusRegReadDefinitions*,RegsViewWidget*> m_reg_def_widget_map;
-    QList<QByteArray> m_cycle_list;
-    QList<RegsViewWidget*> m_cycle_widget_list;
-    QList<QByteArray> m_manual_list;
+    QMap<ModbusRegReadDefinitions*,quint32> m_reg_def_handle_map;
+    QMap<quint32,RegsViewWidget*> m_handle_widget_map;
+    quint32 m_next_def_handle;
+    ModbusSchedulerSettings m_scheduler_settings;
+    //the framing of the serial line the route was opened on, for the bus budget
+    bool m_has_line_settings;
+    ModbusLineSettings m_line_settings;
+    ModbusFaultSettings m_fault_settings;
+    QAction *m_shared_image_action;
     quint32 m_recv_timeout_ms;
     DisplayCommunication *m_traffic_displayer;
     ModbusWriteSingleCoilDialog *m_function05_dialog;
     ModbusWriteSingleRegisterDialog *m_function06_dialog;
     ModbusWriteMultipleCoilsDialog *m_function15_dialog;
     ModbusWriteMultipleRegistersDialog *m_function16_dialog;
-    quint16 m_trans_id;
+    //the discovery scanner owns the connections while it runs, polling is held back
+    bool m_discovering;
     ErrorCounterDialog *m_error_counter_dialog;
 
 public:
@@ -0,0 +1,126 @@
+#include "modbuswritecombiner.h"
+#include "utils.h"
+
+bool ModbusWriteCombiner::add(const QByteArray &pack, const ModbusFrameInfo &frame_info)
+{
+    if(frame_info.function != ModbusWriteSingleCoil && frame_info.function != ModbusWriteMultipleCoils &&
+        frame_info.function != ModbusWriteSingleRegister && frame_info.function != ModbusWriteMultipleRegisters)
+    {
+        return false;
+    }
+    HeldWrite held_write;
+    held_write.pack = pack;
+    held_write.id = frame_info.id;
+    held_write.is_coil = frame_info.function == ModbusWriteSingleCoil || frame_info.function == ModbusWriteMultipleCoils;
+    held_write.reg_addr = frame_info.reg_addr;
+    switch(frame_info.function)
+    {
+    case ModbusWriteSingleCoil:
+    {
+        held_write.values.append(frame_info.reg_values[0] ? 1 : 0);
+        break;
+    }
+    case ModbusWriteMultipleCoils:
+    {
+        const quint8 *coils = (const quint8 *)frame_info.reg_values;
+        for(int i = 0; i < frame_info.quantity; ++i)
+        {
+            held_write.values.append(getBit(coils[i / 8], i % 8));
+        }
+        break;
+    }
+    case ModbusWriteSingleRegister:
+    {
+        held_write.values.append(frame_info.reg_values[0]);
+        break;
+    }
+    default:
+    {
+        for(int i = 0; i < frame_info.quantity; ++i)
+        {
+            held_write.values.append(frame_info.reg_values[i]);
+        }
+        break;
+    }
+    }
+    //only the very last held write may take it in, merging into an older one would move it ahead
+    //of the writes held after that one, the unit's own and those of other units alike
+    if(!m_writes.isEmpty() && m_writes.last().id == held_write.id)
+    {
+        HeldWrite &latest = m_writes.last();
+        //the most one request can carry
+        const int max_quantity = held_write.is_coil ? 1968 : 123;
+        int begin = qMin(latest.reg_addr, held_write.reg_addr);
+        int end = qMax(latest.reg_addr + latest.values.size(), held_write.reg_addr + held_write.values.size());
+        if(latest.is_coil == held_write.is_coil && held_write.reg_addr <= latest.reg_addr + latest.values.size() &&
+            held_write.reg_addr + held_write.values.size() >= latest.reg_addr && end - begin <= max_quantity)
+        {
+            QVector<quint16> values(end - begin);
+            for(int j = 0; j < latest.values.size(); ++j)
+            {
+                values[latest.reg_addr - begin + j] = latest.values[j];
+            }
+            for(int j = 0; j < held_write.values.size(); ++j)
+            {
+                values[held_write.reg_addr - begin + j] = held_write.values[j];
+            }
+            latest.pack.clear();
+            latest.reg_addr = begin;
+            latest.values = values;
+            return true;
+        }
+    }
+    m_writes.append(held_write);
+    return true;
+}
+
+bool ModbusWriteCombiner::isEmpty() const
+{
+    return m_writes.isEmpty();
+}
+
+QList<ModbusWriteCombiner::Write> ModbusWriteCombiner::take()
+{
+    QList<Write> writes;
+    for(const auto &x : m_writes)
+    {
+        Write write;
+        write.pack = x.pack;
+        write.frame_info = frameInfo(x);
+        writes.append(write);
+    }
+    m_writes.clear();
+    return writes;
+}
+
+ModbusFrameInfo ModbusWriteCombiner::frameInfo(const HeldWrite &held_write)
+{
+    ModbusFrameInfo frame_info{};
+    frame_info.id = held_write.id;
+    frame_info.reg_addr = held_write.reg_addr;
+    frame_info.quantity = held_write.values.size();
+    if(held_write.values.size() == 1)
+    {
+        frame_info.function = held_write.is_coil ? ModbusWriteSingleCoil : ModbusWriteSingleRegister;
+        quint16 value = held_write.values[0];
+        frame_info.reg_values[0] = held_write.is_coil ? (value ? 0xFF00 : 0) : value;
+    }
+    else if(held_write.is_coil)
+    {
+        frame_info.function = ModbusWriteMultipleCoils;
+        quint8 *coils = (quint8 *)frame_info.reg_values;
+        for(int i = 0; i < held_write.values.size(); ++i)
+        {
+            setBit(coils[i / 8], i % 8, held_write.values[i]);
+        }
+    }
+    else
+    {
+        frame_info.function = ModbusWriteMultipleRegisters;
+        for(int i = 0; i < held_write.values.size(); ++i)
+        {
+            frame_info.reg_values[i] = held_write.values[i];
+        }
+    }
+    return frame_info;
+}
@@ -0,0 +1,53 @@
+#ifndef MODBUSWRITECOMBINER_H
+#define MODBUSWRITECOMBINER_H
+
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include "ModbusFrameInfo.h"
+
+/*
+ * Collects the single and block writes of a short window and turns them into as few requests
+ * as possible. A write is merged into the last held write when that one is to the same unit and
+ * table and their addresses overlap or touch, the later values win. A write to another unit in
+ * between keeps the two apart, so nothing is moved ahead of a write made before it. Everything
+ * else is held as it came, so the writes go out in the order they were made, and a write that
+ * was never merged goes out as the very request it arrived as.
+ */
+
+class ModbusWriteCombiner
+{
+public:
+    struct Write
+    {
+        //the request as it arrived, empty once other writes were merged into it
+        QByteArray pack;
+        ModbusFrameInfo frame_info;
+    };
+
+public:
+    //returns false for a request it does not combine, the caller sends that one as it is
+    bool add(const QByteArray &pack, const ModbusFrameInfo &frame_info);
+    bool isEmpty() const;
+    //the held writes in the order they were made
+    QList<Write> take();
+
+private:
+    struct HeldWrite
+    {
+        QByteArray pack;
+        int id;
+        bool is_coil;
+        int reg_addr;
+        //one entry per coil or register, a coil is 0 or 1
+        QVector<quint16> values;
+    };
+
+private:
+    static ModbusFrameInfo frameInfo(const HeldWrite &held_write);
+
+private:
+    QList<HeldWrite> m_writes;
+};
+
+#endif // MODBUSWRITECOMBINER_H
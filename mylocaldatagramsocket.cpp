@@ -0,0 +1,146 @@
+#include "mylocaldatagramsocket.h"
+#include "mytcpsocket.h"
+#include <boost/make_shared.hpp>
+#include <cstdio>
+
+using namespace boost::asio;
+
+MyLocalDatagramSocket::MyLocalDatagramSocket(quint64 read_buffer_size, QObject *parent)
+    : QIODevice{parent}, m_read_buffer_size(read_buffer_size)
+{
+    m_asio_socket = boost::make_shared<local::datagram_protocol::socket>(*MyTcpSocket::my_tcp_context::getTcpContext());
+    m_asio_read_buf = new char[m_read_buffer_size];
+}
+
+MyLocalDatagramSocket::~MyLocalDatagramSocket()
+{
+    close();
+    delete []m_asio_read_buf;
+}
+
+bool MyLocalDatagramSocket::bind(const QString &local_path, const QString &peer_path)
+{
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    try
+    {
+        //a path left over by a crashed run would make bind fail
+        std::remove(local_path.toStdString().c_str());
+        m_local_ep = local::datagram_protocol::endpoint(local_path.toStdString());
+        m_peer_ep = local::datagram_protocol::endpoint(peer_path.toStdString());
+        m_asio_socket->open();
+        m_asio_socket->bind(m_local_ep);
+    }
+    catch(boost::wrapexcept<boost::system::system_error> error)
+    {
+        if(m_asio_socket->is_open())
+        {
+            m_asio_socket->close();
+        }
+        emit socketErrorOccurred(error.code());
+        return false;
+    }
+    m_asio_socket->async_receive(buffer(m_asio_read_buf, m_read_buffer_size), std::bind(&MyLocalDatagramSocket::asyncReceiveCallback, this, std::placeholders::_1, std::placeholders::_2));
+    QIODevice::open(QIODevice::ReadWrite);
+    return true;
+}
+
+QString MyLocalDatagramSocket::localPath() const
+{
+    return QString::fromStdString(m_local_ep.path());
+}
+
+QString MyLocalDatagramSocket::peerPath() const
+{
+    return QString::fromStdString(m_peer_ep.path());
+}
+
+bool MyLocalDatagramSocket::isSequential() const
+{
+    return true;
+}
+
+void MyLocalDatagramSocket::close()
+{
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    if(m_asio_socket->is_open())
+    {
+        boost::system::error_code ec;
+        m_asio_socket->close(ec);
+        std::remove(m_local_ep.path().c_str());
+    }
+    QIODevice::close();
+}
+
+qint64 MyLocalDatagramSocket::bytesAvailable() const
+{
+    return m_recv_buffer.size() + QIODevice::bytesAvailable();
+}
+
+qint64 MyLocalDatagramSocket::bytesToWrite() const
+{
+    return 0;
+}
+
+qint64 MyLocalDatagramSocket::readData(char *data, qint64 maxlen)
+{
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    int read_size = m_recv_buffer.size() <= maxlen ? m_recv_buffer.size() : maxlen;
+    memcpy(data, m_recv_buffer.data(), read_size);
+    m_recv_buffer.remove(0, read_size);
+
+    return read_size;
+}
+
+qint64 MyLocalDatagramSocket::writeData(const char *data, qint64 len)
+{
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    //a local datagram is queued by the kernel at once, so the send is done synchronously
+    boost::system::error_code ec;
+    m_asio_socket->send_to(const_buffer(data, len), m_peer_ep, 0, ec);
+    if(ec)
+    {
+        lock.unlock();
+        emit socketErrorOccurred(ec);
+        return -1;
+    }
+
+    return len;
+}
+
+void MyLocalDatagramSocket::asyncReceiveCallback(const boost::system::error_code &ec, int size)
+{
+    if(ec)
+    {
+        if(ec != boost::asio::error::operation_aborted)
+        {
+            emit socketErrorOccurred(ec);
+        }
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_recv_buffer.append(m_asio_read_buf, size);
+    m_asio_socket->async_receive(buffer(m_asio_read_buf, m_read_buffer_size), std::bind(&MyLocalDatagramSocket::asyncReceiveCallback, this, std::placeholders::_1, std::placeholders::_2));
+    lock.unlock();
+    notifyReadyRead();
+}
+
+void MyLocalDatagramSocket::notifyReadyRead()
+{
+    //at most one wakeup is queued per socket, it is re-armed once the owner thread picks it up
+    if(m_ready_read_pending.exchange(true))
+    {
+        return;
+    }
+    QMetaObject::invokeMethod(this, [this](){
+        m_ready_read_pending = false;
+        bool has_data {false};
+        {
+            std::unique_lock<std::mutex> lock(m_socket_mutex);
+            has_data = !m_recv_buffer.isEmpty();
+        }
+        if(has_data)
+        {
+            emit readyRead();
+        }
+    }, Qt::QueuedConnection);
+}
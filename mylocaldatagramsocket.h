@@ -0,0 +1,58 @@
+#ifndef MYLOCALDATAGRAMSOCKET_H
+#define MYLOCALDATAGRAMSOCKET_H
+
+#include <QIODevice>
+#include <boost/asio.hpp>
+#include <mutex>
+#include <atomic>
+#include <QByteArray>
+#include <QString>
+
+/*
+ * Unix domain datagram socket, each datagram carries one adu and is delivered
+ * without the loopback ip stack. Both ends bind their own path and send to the peer path.
+ */
+
+class MyLocalDatagramSocket : public QIODevice
+{
+    Q_OBJECT
+
+    typedef boost::shared_ptr<boost::asio::local::datagram_protocol::socket> socket_ptr;
+
+public:
+    explicit MyLocalDatagramSocket(quint64 read_buffer_size = 64 * 1024, QObject *parent = nullptr);
+    ~MyLocalDatagramSocket();
+    bool bind(const QString &local_path, const QString &peer_path);
+    QString localPath() const;
+    QString peerPath() const;
+
+signals:
+    void socketErrorOccurred(const std::error_code &ec);
+
+    // QIODevice interface
+public:
+    bool isSequential() const override;
+    void close() override;
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    void asyncReceiveCallback(const boost::system::error_code &ec, int size);
+    void notifyReadyRead();
+
+private:
+    socket_ptr m_asio_socket;
+    QByteArray m_recv_buffer;
+    std::mutex m_socket_mutex;
+    char *m_asio_read_buf;
+    quint64 m_read_buffer_size;
+    std::atomic_bool m_ready_read_pending{false};
+    boost::asio::local::datagram_protocol::endpoint m_local_ep;
+    boost::asio::local::datagram_protocol::endpoint m_peer_ep;
+};
+
+#endif // MYLOCALDATAGRAMSOCKET_H
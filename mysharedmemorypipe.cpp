@@ -0,0 +1,189 @@
+#include "mysharedmemorypipe.h"
+#include <new>
+
+MySharedMemoryPipe::MySharedMemoryPipe(QObject *parent)
+    : QIODevice{parent}, m_tx_ring(nullptr), m_rx_ring(nullptr)
+{
+
+}
+
+MySharedMemoryPipe::~MySharedMemoryPipe()
+{
+    close();
+}
+
+bool MySharedMemoryPipe::open(const QString &key, bool create)
+{
+    m_shared_memory.setKey(key);
+    if(create)
+    {
+        if(!m_shared_memory.create(sizeof(Segment)))
+        {
+            setErrorString(m_shared_memory.errorString());
+            return false;
+        }
+        Segment *segment = static_cast<Segment*>(m_shared_memory.data());
+        for(auto &x : segment->rings)
+        {
+            new (&x.head) std::atomic<quint32>(0);
+            new (&x.tail) std::atomic<quint32>(0);
+            new (&x.wake_pending) std::atomic<quint32>(0);
+        }
+    }
+    else if(!m_shared_memory.attach())
+    {
+        setErrorString(m_shared_memory.errorString());
+        return false;
+    }
+    Segment *segment = static_cast<Segment*>(m_shared_memory.data());
+    m_tx_ring = &segment->rings[create ? 0 : 1];
+    m_rx_ring = &segment->rings[create ? 1 : 0];
+    //one semaphore per ring, the creator starts them from zero, a stale count of an earlier run is dropped
+    QSystemSemaphore::AccessMode mode = create ? QSystemSemaphore::Create : QSystemSemaphore::Open;
+    m_tx_semaphore.reset(new QSystemSemaphore(QString("%1_wake%2").arg(key).arg(create ? 0 : 1), 0, mode));
+    m_rx_semaphore.reset(new QSystemSemaphore(QString("%1_wake%2").arg(key).arg(create ? 1 : 0), 0, mode));
+    if(m_tx_semaphore->error() != QSystemSemaphore::NoError || m_rx_semaphore->error() != QSystemSemaphore::NoError)
+    {
+        setErrorString(m_tx_semaphore->error() != QSystemSemaphore::NoError ? m_tx_semaphore->errorString() : m_rx_semaphore->errorString());
+        m_tx_semaphore.reset();
+        m_rx_semaphore.reset();
+        m_shared_memory.detach();
+        m_tx_ring = m_rx_ring = nullptr;
+        return false;
+    }
+    m_stopping = false;
+    m_wake_thread = std::thread([this](){
+        while(m_rx_semaphore->acquire() && !m_stopping)
+        {
+            //wakeups arriving while a drain is queued are covered by it
+            if(!m_drain_queued.exchange(true))
+            {
+                QMetaObject::invokeMethod(this, [this](){
+                    m_drain_queued = false;
+                    drainRing();
+                }, Qt::QueuedConnection);
+            }
+        }
+    });
+    //whatever the other side wrote before this end was open is picked up once the caller is connected
+    QMetaObject::invokeMethod(this, [this](){
+        drainRing();
+    }, Qt::QueuedConnection);
+    return QIODevice::open(QIODevice::ReadWrite);
+}
+
+QString MySharedMemoryPipe::key() const
+{
+    return m_shared_memory.key();
+}
+
+bool MySharedMemoryPipe::isSequential() const
+{
+    return true;
+}
+
+void MySharedMemoryPipe::close()
+{
+    if(m_wake_thread.joinable())
+    {
+        m_stopping = true;
+        m_rx_semaphore->release();
+        m_wake_thread.join();
+    }
+    m_tx_semaphore.reset();
+    m_rx_semaphore.reset();
+    if(m_shared_memory.isAttached())
+    {
+        m_shared_memory.detach();
+    }
+    m_tx_ring = m_rx_ring = nullptr;
+    QIODevice::close();
+}
+
+qint64 MySharedMemoryPipe::bytesAvailable() const
+{
+    return m_recv_buffer.size() + QIODevice::bytesAvailable();
+}
+
+qint64 MySharedMemoryPipe::readData(char *data, qint64 maxlen)
+{
+    int read_size = m_recv_buffer.size() <= maxlen ? m_recv_buffer.size() : maxlen;
+    memcpy(data, m_recv_buffer.data(), read_size);
+    m_recv_buffer.remove(0, read_size);
+
+    return read_size;
+}
+
+qint64 MySharedMemoryPipe::writeData(const char *data, qint64 len)
+{
+    if(!m_tx_ring)
+    {
+        return -1;
+    }
+    quint32 head = m_tx_ring->head.load(std::memory_order_relaxed);
+    quint32 tail = m_tx_ring->tail.load(std::memory_order_acquire);
+    quint32 free_size = ring_size - (head - tail);
+    if(len > 0xFFFF || free_size < len + 2)
+    {
+        setErrorString(tr("Shared memory ring is full"));
+        return -1;
+    }
+    char record_len[2] = {char(len & 0xFF), char(len >> 8 & 0xFF)};
+    copyIn(m_tx_ring, head, record_len, 2);
+    copyIn(m_tx_ring, head + 2, data, len);
+    m_tx_ring->head.store(head + 2 + len, std::memory_order_release);
+    //the new head must be visible before the reader can be seen awake, or it could go back to sleep on it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!m_tx_ring->wake_pending.exchange(1, std::memory_order_relaxed))
+    {
+        m_tx_semaphore->release();
+    }
+
+    return len;
+}
+
+void MySharedMemoryPipe::drainRing()
+{
+    if(!m_rx_ring)
+    {
+        return;
+    }
+    //a record written from here on wakes this side again
+    m_rx_ring->wake_pending.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    quint32 tail = m_rx_ring->tail.load(std::memory_order_relaxed);
+    quint32 head = m_rx_ring->head.load(std::memory_order_acquire);
+    if(head == tail)
+    {
+        return;
+    }
+    while(tail != head)
+    {
+        char record_len[2];
+        copyOut(m_rx_ring, tail, record_len, 2);
+        quint32 len = quint8(record_len[0]) | quint8(record_len[1]) << 8;
+        int offset = m_recv_buffer.size();
+        m_recv_buffer.resize(offset + len);
+        copyOut(m_rx_ring, tail + 2, m_recv_buffer.data() + offset, len);
+        tail += 2 + len;
+    }
+    m_rx_ring->tail.store(tail, std::memory_order_release);
+    emit readyRead();
+}
+
+void MySharedMemoryPipe::copyIn(Ring *ring, quint32 pos, const char *data, quint32 len)
+{
+    //positions run freely and wrap at 2^32, ring_size divides that so the modulo stays valid
+    quint32 offset = pos % ring_size;
+    quint32 first = qMin(len, ring_size - offset);
+    memcpy(ring->data + offset, data, first);
+    memcpy(ring->data, data + first, len - first);
+}
+
+void MySharedMemoryPipe::copyOut(Ring *ring, quint32 pos, char *data, quint32 len)
+{
+    quint32 offset = pos % ring_size;
+    quint32 first = qMin(len, ring_size - offset);
+    memcpy(data, ring->data + offset, first);
+    memcpy(data + first, ring->data, len - first);
+}
@@ -0,0 +1,75 @@
+#ifndef MYSHAREDMEMORYPIPE_H
+#define MYSHAREDMEMORYPIPE_H
+
+#include <QIODevice>
+#include <QSharedMemory>
+#include <QSystemSemaphore>
+#include <QByteArray>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/*
+ * Two single-producer single-consumer rings in one shared memory segment, one per direction.
+ * Every write is stored as one length-prefixed record, so a reader always sees whole adus.
+ * The side that creates the segment writes the first ring, the side that attaches writes the second.
+ * A reader sleeps on a system semaphore of its ring instead of polling, the writer releases it
+ * once per batch of records the reader has not picked up yet.
+ */
+
+class MySharedMemoryPipe : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit MySharedMemoryPipe(QObject *parent = nullptr);
+    ~MySharedMemoryPipe();
+    bool open(const QString &key, bool create);
+    QString key() const;
+
+    // QIODevice interface
+public:
+    bool isSequential() const override;
+    void close() override;
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    static const quint32 ring_size = 64 * 1024;
+
+    struct Ring
+    {
+        std::atomic<quint32> head;
+        std::atomic<quint32> tail;
+        //set by the writer when it wakes the reader, cleared by the reader before it drains the ring
+        std::atomic<quint32> wake_pending;
+        char data[ring_size];
+    };
+
+    struct Segment
+    {
+        Ring rings[2];
+    };
+
+private:
+    void drainRing();
+    void copyIn(Ring *ring, quint32 pos, const char *data, quint32 len);
+    void copyOut(Ring *ring, quint32 pos, char *data, quint32 len);
+
+private:
+    QSharedMemory m_shared_memory;
+    Ring *m_tx_ring;
+    Ring *m_rx_ring;
+    std::unique_ptr<QSystemSemaphore> m_tx_semaphore;
+    std::unique_ptr<QSystemSemaphore> m_rx_semaphore;
+    //blocks on the receive semaphore and hands the drain over to the pipe's thread
+    std::thread m_wake_thread;
+    std::atomic_bool m_stopping{false};
+    std::atomic_bool m_drain_queued{false};
+    QByteArray m_recv_buffer;
+};
+
+#endif // MYSHAREDMEMORYPIPE_H
@@ -1,6 +1,7 @@
 #include "mytcpsocket.h"
 #include <QEventLoop>
 #include <QTimer>
+#include <QThread>
 #include <QHostAddress>
 #include <QMap>
 #include <QDebug>
@@ -11,15 +12,34 @@ using namespace boost::asio;
 io_context *MyTcpSocket::my_tcp_context::tcp_context = nullptr;
 std::thread *MyTcpSocket::my_tcp_context::tcp_thread = nullptr;
 std::mutex MyTcpSocket::my_tcp_context::tcp_mutex;
+std::multimap<quint64, char*> MyTcpSocket::my_buffer_pool::free_buffers;
+std::mutex MyTcpSocket::my_buffer_pool::pool_mutex;
+
+namespace {
+const int min_accept_delay_ms = 50;
+const int max_accept_delay_ms = 2000;
+const int max_frame_buffer_size = 64 * 1024;
+}
 
 MyTcpSocket::MyTcpSocket(socket_ptr sock_ptr, quint64 read_buffer_size) : QIODevice(nullptr)
 {
     m_asio_socket  = sock_ptr;
     m_asio_acceptor = boost::make_shared<ip::tcp::acceptor>(*my_tcp_context::getTcpContext());
     m_asio_read_buf = nullptr;
+    m_connect_timer = boost::make_shared<steady_timer>(*my_tcp_context::getTcpContext());
+    m_reconnect_timer = boost::make_shared<steady_timer>(*my_tcp_context::getTcpContext());
+    m_accept_timer = boost::make_shared<steady_timer>(*my_tcp_context::getTcpContext());
+    m_deferred_accepts = 0;
+    m_accept_delay_ms = min_accept_delay_ms;
+    m_connect_timeout_ms = 0;
+    m_connect_attempt = 0;
+    m_connecting = false;
+    m_auto_reconnect = false;
+    m_closing = false;
+    m_connection_thread = nullptr;
+    m_min_reconnect_delay_ms = m_max_reconnect_delay_ms = m_reconnect_delay_ms = 0;
     setReadBufferSize(read_buffer_size);
     QIODevice::open(QIODevice::ReadWrite);
-    m_asio_socket->async_read_some(buffer(m_asio_read_buf,m_read_buffer_size),std::bind(&MyTcpSocket::asyncReadCallback,this,std::placeholders::_1,std::placeholders::_2));
 }
 
 MyTcpSocket::MyTcpSocket(quint64 read_buffer_size, QObject *parent)
@@ -28,19 +48,35 @@ MyTcpSocket::MyTcpSocket(quint64 read_buffer_size, QObject *parent)
     m_asio_socket = boost::make_shared<ip::tcp::socket>(*my_tcp_context::getTcpContext());
     m_asio_acceptor = boost::make_shared<ip::tcp::acceptor>(*my_tcp_context::getTcpContext());
     m_asio_read_buf = nullptr;
+    m_connect_timer = boost::make_shared<steady_timer>(*my_tcp_context::getTcpContext());
+    m_reconnect_timer = boost::make_shared<steady_timer>(*my_tcp_context::getTcpContext());
+    m_accept_timer = boost::make_shared<steady_timer>(*my_tcp_context::getTcpContext());
+    m_deferred_accepts = 0;
+    m_accept_delay_ms = min_accept_delay_ms;
+    m_connect_timeout_ms = 0;
+    m_connect_attempt = 0;
+    m_connecting = false;
+    m_auto_reconnect = false;
+    m_closing = false;
+    m_connection_thread = nullptr;
+    m_min_reconnect_delay_ms = m_max_reconnect_delay_ms = m_reconnect_delay_ms = 0;
     setReadBufferSize(read_buffer_size);
 }
 
 MyTcpSocket::~MyTcpSocket()
 {
     std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_closing = true;
+    m_connect_timer->cancel();
+    m_reconnect_timer->cancel();
+    m_accept_timer->cancel();
     try
     {
         m_asio_socket->cancel();
     }
     catch(boost::wrapexcept<boost::system::system_error> &error)
     {
-        delete []m_asio_read_buf;
+        my_buffer_pool::release(m_asio_read_buf, m_read_buffer_size);
         return;
     }
     if(m_asio_socket->is_open())
@@ -51,7 +87,7 @@ MyTcpSocket::~MyTcpSocket()
         }
         catch (boost::wrapexcept<boost::system::system_error> error)
         {
-            delete[] m_asio_read_buf;
+            my_buffer_pool::release(m_asio_read_buf, m_read_buffer_size);
             return;
         }
 
@@ -61,7 +97,7 @@ MyTcpSocket::~MyTcpSocket()
     {
         m_asio_acceptor->close();
     }
-    delete[] m_asio_read_buf;
+    my_buffer_pool::release(m_asio_read_buf, m_read_buffer_size);
 }
 
 
@@ -74,6 +110,10 @@ void MyTcpSocket::close()
 {
 
     std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_closing = true;
+    m_connect_timer->cancel();
+    m_reconnect_timer->cancel();
+    m_accept_timer->cancel();
     if(m_asio_socket->is_open())
     {
         try
@@ -166,18 +206,38 @@ qint64 MyTcpSocket::writeData(const char *data, qint64 len)
     return len;
 }
 
-void MyTcpSocket::asyncConnectCallback(const std::error_code &ec)
+void MyTcpSocket::asyncConnectCallback(quint64 attempt, const std::error_code &ec)
 {
 
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    if(m_closing || attempt != m_connect_attempt)
+    {
+        return;
+    }
+    m_connecting = false;
+    m_connect_timer->cancel();
     if(ec)
     {
+        lock.unlock();
         emit socketErrorOccurred(ec);
         emit connectFinished(false);
+        lock.lock();
+        //every failed attempt is reported, the first one included, and tried again later
+        if(m_auto_reconnect && !m_closing)
+        {
+            scheduleReconnect();
+        }
     }
     else
     {
-        std::unique_lock<std::mutex> lock(m_socket_mutex);
-        QIODevice::open(QIODevice::ReadWrite);
+        m_reconnect_delay_ms = m_min_reconnect_delay_ms;
+        //what was left of the dropped link would be glued onto the start of the new stream
+        m_recv_buffer.clear();
+        m_frame_buffer.clear();
+        if(!isOpen())
+        {
+            QIODevice::open(QIODevice::ReadWrite);
+        }
         emit connectFinished(true);
         m_asio_socket->async_read_some(buffer(m_asio_read_buf,m_read_buffer_size),std::bind(&MyTcpSocket::asyncReadCallback,this,std::placeholders::_1,std::placeholders::_2));
     }
@@ -185,7 +245,7 @@ void MyTcpSocket::asyncConnectCallback(const std::error_code &ec)
 }
 
 
-bool MyTcpSocket::bind(const QHostAddress &address, quint16 port)
+bool MyTcpSocket::bind(const QHostAddress &address, quint16 port, int backlog, int pending_accepts)
 {
 
     std::unique_lock<std::mutex> lock(m_socket_mutex);
@@ -195,15 +255,18 @@ bool MyTcpSocket::bind(const QHostAddress &address, quint16 port)
         m_asio_acceptor->open(ep.protocol());
         m_asio_acceptor->set_option(ip::tcp::acceptor::reuse_address());
         m_asio_acceptor->bind(ep);
+        m_asio_acceptor->listen(backlog);
     }
     catch(boost::wrapexcept<boost::system::system_error> error)
     {
         emit socketErrorOccurred(error.code());
         return false;
     }
-    m_asio_acceptor->listen(0);
-    socket_ptr sock_(new ip::tcp::socket(*my_tcp_context::getTcpContext()));
-    m_asio_acceptor->async_accept(*sock_,std::bind(&MyTcpSocket::asyncAcceptCallback,this,sock_,std::placeholders::_1));
+    //keep several accepts outstanding so a burst of reconnecting clients is drained in one pass
+    for(int i = 0; i < pending_accepts; ++i)
+    {
+        startAccept();
+    }
 
     return true;
 }
@@ -212,12 +275,27 @@ void MyTcpSocket::setReadBufferSize(quint64 buf_size)
 {
 
     std::unique_lock<std::mutex> lock(m_socket_mutex);
+    my_buffer_pool::release(m_asio_read_buf, m_read_buffer_size);
     m_read_buffer_size = buf_size;
-    delete []m_asio_read_buf;
-    m_asio_read_buf = new char[buf_size];
+    m_asio_read_buf = my_buffer_pool::acquire(buf_size);
 
 }
 
+void MyTcpSocket::setFrameHandler(FrameSplitter splitter, FrameHandler handler)
+{
+
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_frame_splitter = splitter;
+    m_frame_handler = handler;
+
+}
+
+void MyTcpSocket::setConnectionThread(QThread *thread)
+{
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_connection_thread = thread;
+}
+
 QString MyTcpSocket::peerAddress() const
 {
     return QString::fromStdString(m_asio_socket->remote_endpoint().address().to_string());
@@ -238,23 +316,86 @@ quint16 MyTcpSocket::localPort() const
     return m_asio_socket->local_endpoint().port();
 }
 
-bool MyTcpSocket::connectToHost(const QString &hostName, quint16 port)
+bool MyTcpSocket::connectToHost(const QString &hostName, quint16 port, int timeout_ms)
 {
 
     std::unique_lock<std::mutex> lock(m_socket_mutex);
     try
     {
-        ip::tcp::endpoint host(ip::address::from_string(hostName.toStdString()),port);
-        m_asio_socket->async_connect(host,std::bind(&MyTcpSocket::asyncConnectCallback,this,std::placeholders::_1));
+        m_host = ip::tcp::endpoint(ip::address::from_string(hostName.toStdString()),port);
     }
     catch(boost::wrapexcept<boost::system::system_error> error)
     {
         emit socketErrorOccurred(error.code());
         return false;
     }
+    m_connect_timeout_ms = timeout_ms;
+    m_closing = false;
+    startConnect();
     return true;
 }
 
+void MyTcpSocket::setAutoReconnect(bool enabled, int min_delay_ms, int max_delay_ms)
+{
+
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_auto_reconnect = enabled;
+    m_min_reconnect_delay_ms = min_delay_ms;
+    m_max_reconnect_delay_ms = max_delay_ms;
+    m_reconnect_delay_ms = min_delay_ms;
+}
+
+bool MyTcpSocket::autoReconnect() const
+{
+    return m_auto_reconnect;
+}
+
+void MyTcpSocket::startConnect()
+{
+    boost::system::error_code ignored_ec;
+    m_asio_socket->close(ignored_ec);
+    quint64 attempt = ++m_connect_attempt;
+    m_connecting = true;
+    m_asio_socket->async_connect(m_host,std::bind(&MyTcpSocket::asyncConnectCallback,this,attempt,std::placeholders::_1));
+    if(m_connect_timeout_ms > 0)
+    {
+        m_connect_timer->expires_after(std::chrono::milliseconds(m_connect_timeout_ms));
+        m_connect_timer->async_wait([this, attempt](const boost::system::error_code &ec){
+            if(ec == boost::asio::error::operation_aborted)
+            {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(m_socket_mutex);
+            //the connect may have completed while the expiry was waiting for the lock
+            if(!m_connecting || attempt != m_connect_attempt)
+            {
+                return;
+            }
+            boost::system::error_code ignored_ec;
+            m_asio_socket->close(ignored_ec);
+        });
+    }
+}
+
+void MyTcpSocket::scheduleReconnect()
+{
+    boost::system::error_code ignored_ec;
+    m_asio_socket->close(ignored_ec);
+    m_reconnect_timer->expires_after(std::chrono::milliseconds(m_reconnect_delay_ms));
+    m_reconnect_timer->async_wait([this](const boost::system::error_code &ec){
+        if(ec == boost::asio::error::operation_aborted)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_socket_mutex);
+        if(!m_closing)
+        {
+            startConnect();
+        }
+    });
+    m_reconnect_delay_ms = std::min(m_reconnect_delay_ms * 2, m_max_reconnect_delay_ms);
+}
+
 void MyTcpSocket::disconnectFromHost()
 {
 
@@ -269,18 +410,92 @@ void MyTcpSocket::asyncReadCallback(const std::error_code &ec, size_t size)
     if(!ec)
     {
         std::unique_lock<std::mutex> lock(m_socket_mutex);
-        m_recv_buffer.append(m_asio_read_buf,size);
-        emit readyRead();
+        bool buffered {true};
+        if(m_frame_handler)
+        {
+            FrameSplitter splitter = m_frame_splitter;
+            FrameHandler handler = m_frame_handler;
+            lock.unlock();
+            deliverFrames(size, splitter, handler);
+            lock.lock();
+            buffered = false;
+        }
+        else
+        {
+            m_recv_buffer.append(m_asio_read_buf,size);
+        }
         m_asio_socket->async_read_some(buffer(m_asio_read_buf,m_read_buffer_size),std::bind(&MyTcpSocket::asyncReadCallback,this,std::placeholders::_1,std::placeholders::_2));
+        lock.unlock();
+        if(buffered)
+        {
+            notifyReadyRead();
+        }
     }
     else
     {
+        std::unique_lock<std::mutex> lock(m_socket_mutex);
+        if(m_closing)
+        {
+            return;
+        }
+        lock.unlock();
         emit socketErrorOccurred(ec);
         emit disconnectedFromHost();
+        lock.lock();
+        if(m_auto_reconnect)
+        {
+            scheduleReconnect();
+        }
     }
 
 }
 
+void MyTcpSocket::deliverFrames(size_t size, const FrameSplitter &splitter, const FrameHandler &handler)
+{
+    //frames are handed out straight from the asio buffer, only a trailing partial frame is copied
+    const char *data = m_asio_read_buf;
+    qint64 data_size = size;
+    if(!m_frame_buffer.isEmpty())
+    {
+        m_frame_buffer.append(m_asio_read_buf, size);
+        data = m_frame_buffer.constData();
+        data_size = m_frame_buffer.size();
+    }
+    qint64 offset = 0;
+    while(offset < data_size)
+    {
+        qint64 frame_size = splitter ? splitter(data + offset, data_size - offset) : data_size - offset;
+        if(frame_size < 0)
+        {
+            //bytes that do not start a frame are dropped until one does
+            offset += std::min(-frame_size, data_size - offset);
+            continue;
+        }
+        if(frame_size == 0)
+        {
+            break;
+        }
+        handler(data + offset, frame_size);
+        offset += frame_size;
+    }
+    if(data == m_asio_read_buf)
+    {
+        if(offset < data_size)
+        {
+            m_frame_buffer.append(data + offset, data_size - offset);
+        }
+    }
+    else
+    {
+        m_frame_buffer.remove(0, offset);
+    }
+    //a splitter that keeps asking for more is not given more than this
+    if(m_frame_buffer.size() > max_frame_buffer_size)
+    {
+        m_frame_buffer.clear();
+    }
+}
+
 void MyTcpSocket::asyncWriteCallback(const std::error_code &ec, size_t size)
 {
     if(ec)
@@ -289,20 +504,101 @@ void MyTcpSocket::asyncWriteCallback(const std::error_code &ec, size_t size)
     }
 }
 
-void MyTcpSocket::asyncAcceptCallback(socket_ptr sock,const std::error_code &ec)
+void MyTcpSocket::asyncAcceptCallback(socket_ptr sock,const boost::system::error_code &ec)
 {
-    if(!ec)
+    if(ec == boost::asio::error::operation_aborted)
     {
-        std::unique_lock<std::mutex> lock(m_socket_mutex);
-        MyTcpSocket *new_con = new MyTcpSocket(sock);
-        emit newConnectionIncoming(new_con);
-        socket_ptr sock_(new ip::tcp::socket(*my_tcp_context::getTcpContext()));
-        m_asio_acceptor->async_accept(*sock_,std::bind(&MyTcpSocket::asyncAcceptCallback,this,sock_,std::placeholders::_1));
+        //the listener was closed, every outstanding accept ends this way
+        return;
     }
-    else
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    if(m_closing || !m_asio_acceptor->is_open())
     {
-        emit socketErrorOccurred(ec);
+        return;
+    }
+    if(ec)
+    {
+        //running out of descriptors fails every accept at once, they are tried again later
+        bool first_failure = m_deferred_accepts == 0;
+        deferAccept();
+        lock.unlock();
+        if(first_failure)
+        {
+            emit socketErrorOccurred(ec);
+        }
+        return;
+    }
+    m_accept_delay_ms = min_accept_delay_ms;
+    startAccept();
+    QThread *connection_thread = m_connection_thread ? m_connection_thread : thread();
+    lock.unlock();
+    //accepted connections read into buffers of the listener's size, nothing is read before the
+    //connection is on its thread, so no read callback ever races the move
+    MyTcpSocket *new_con = new MyTcpSocket(sock, m_read_buffer_size);
+    new_con->moveToThread(connection_thread);
+    new_con->startRead();
+    emit newConnectionIncoming(new_con);
+}
+
+void MyTcpSocket::startRead()
+{
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_asio_socket->async_read_some(buffer(m_asio_read_buf,m_read_buffer_size),std::bind(&MyTcpSocket::asyncReadCallback,this,std::placeholders::_1,std::placeholders::_2));
+}
+
+void MyTcpSocket::startAccept()
+{
+    socket_ptr sock_ = boost::make_shared<ip::tcp::socket>(*my_tcp_context::getTcpContext());
+    m_asio_acceptor->async_accept(*sock_,std::bind(&MyTcpSocket::asyncAcceptCallback,this,sock_,std::placeholders::_1));
+}
+
+void MyTcpSocket::deferAccept()
+{
+    if(m_deferred_accepts++ > 0)
+    {
+        //the timer is already running for an earlier failure
+        return;
+    }
+    m_accept_timer->expires_after(std::chrono::milliseconds(m_accept_delay_ms));
+    m_accept_timer->async_wait([this](const boost::system::error_code &ec){
+        if(ec == boost::asio::error::operation_aborted)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_socket_mutex);
+        int deferred_accepts = m_deferred_accepts;
+        m_deferred_accepts = 0;
+        if(m_closing || !m_asio_acceptor->is_open())
+        {
+            return;
+        }
+        for(int i = 0; i < deferred_accepts; ++i)
+        {
+            startAccept();
+        }
+    });
+    m_accept_delay_ms = std::min(m_accept_delay_ms * 2, max_accept_delay_ms);
+}
+
+void MyTcpSocket::notifyReadyRead()
+{
+    //at most one wakeup is queued per socket, it is re-armed once the owner thread picks it up
+    if(m_ready_read_pending.exchange(true))
+    {
+        return;
     }
+    QMetaObject::invokeMethod(this, [this](){
+        m_ready_read_pending = false;
+        bool has_data {false};
+        {
+            std::unique_lock<std::mutex> lock(m_socket_mutex);
+            has_data = !m_recv_buffer.isEmpty();
+        }
+        if(has_data)
+        {
+            emit readyRead();
+        }
+    }, Qt::QueuedConnection);
 }
 
 boost::asio::io_context *MyTcpSocket::my_tcp_context::getTcpContext()
@@ -319,3 +615,35 @@ boost::asio::io_context *MyTcpSocket::my_tcp_context::getTcpContext()
     }
     return tcp_context;
 }
+
+char *MyTcpSocket::my_buffer_pool::acquire(quint64 size)
+{
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        auto it = free_buffers.find(size);
+        if(it != free_buffers.end())
+        {
+            char *buf = it->second;
+            free_buffers.erase(it);
+            return buf;
+        }
+    }
+    return new char[size];
+}
+
+void MyTcpSocket::my_buffer_pool::release(char *buf, quint64 size)
+{
+    if(buf == nullptr)
+    {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        if(free_buffers.size() < max_free_buffers)
+        {
+            free_buffers.emplace(size, buf);
+            return;
+        }
+    }
+    delete []buf;
+}
@@ -5,30 +5,47 @@
 #include <boost/asio.hpp>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <map>
 #include <QVariant>
 #include <QByteArray>
 #include <QHostAddress>
 
 class MyUdpSocket;
+class QThread;
 
 class MyTcpSocket : public QIODevice
 {
 
     friend class MyUdpSocket;
+    friend class MyLocalDatagramSocket;
     typedef boost::shared_ptr<boost::asio::ip::tcp::socket> socket_ptr;
     typedef boost::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor_ptr;
+    typedef boost::shared_ptr<boost::asio::steady_timer> timer_ptr;
 
     Q_OBJECT
     Q_DISABLE_COPY(MyTcpSocket)
 private:
     explicit MyTcpSocket(socket_ptr sock_ptr, quint64 read_buffer_size = 1024*1024);
 public:
+    //returns the size of the complete frame at the head of data, 0 when more bytes are needed,
+    //minus the number of bytes to drop when data does not start with a frame
+    typedef std::function<qint64(const char *data, qint64 size)> FrameSplitter;
+    //runs on the io thread, data is only valid during the call
+    typedef std::function<void(const char *data, qint64 size)> FrameHandler;
+
     explicit MyTcpSocket(quint64 read_buffer_size = 1024*1024, QObject *parent = nullptr);
     virtual ~MyTcpSocket();
     void disconnectFromHost();
-    bool connectToHost(const QString &hostName, quint16 port);
-    bool bind(const QHostAddress &address, quint16 port);
+    bool connectToHost(const QString &hostName, quint16 port, int timeout_ms = 0);
+    void setAutoReconnect(bool enabled, int min_delay_ms = 100, int max_delay_ms = 10000);
+    bool autoReconnect() const;
+    bool bind(const QHostAddress &address, quint16 port, int backlog = boost::asio::socket_base::max_listen_connections, int pending_accepts = 8);
     void setReadBufferSize(quint64 buf_size);
+    void setFrameHandler(FrameSplitter splitter, FrameHandler handler);
+    //accepted connections are moved to this thread before their first read, by default the listener's own
+    void setConnectionThread(QThread *thread);
 
     QString peerAddress() const;
     quint16 peerPort() const;
@@ -59,10 +76,17 @@ protected:
 
 
 private:
-    void asyncConnectCallback(const std::error_code &ec);
+    void asyncConnectCallback(quint64 attempt, const std::error_code &ec);
     void asyncReadCallback(const std::error_code &ec, size_t size);
     void asyncWriteCallback(const std::error_code &ec, size_t size);
-    void asyncAcceptCallback(socket_ptr sock,const std::error_code &ec);
+    void asyncAcceptCallback(socket_ptr sock,const boost::system::error_code &ec);
+    void startAccept();
+    void startRead();
+    void deferAccept();
+    void startConnect();
+    void scheduleReconnect();
+    void deliverFrames(size_t size, const FrameSplitter &splitter, const FrameHandler &handler);
+    void notifyReadyRead();
 
 protected:
     socket_ptr m_asio_socket;
@@ -71,6 +95,28 @@ protected:
     std::mutex m_socket_mutex;
     char *m_asio_read_buf;
     quint64 m_read_buffer_size;
+    timer_ptr m_connect_timer;
+    timer_ptr m_reconnect_timer;
+    //accepts that failed are started again once this runs out, a full fd table does not spin the io thread
+    timer_ptr m_accept_timer;
+    int m_deferred_accepts;
+    int m_accept_delay_ms;
+    boost::asio::ip::tcp::endpoint m_host;
+    int m_connect_timeout_ms;
+    //completions and timeouts of an earlier attempt are told apart from the current one by this
+    quint64 m_connect_attempt;
+    bool m_connecting;
+    bool m_auto_reconnect;
+    bool m_closing;
+    QThread *m_connection_thread;
+    int m_min_reconnect_delay_ms;
+    int m_max_reconnect_delay_ms;
+    int m_reconnect_delay_ms;
+    std::atomic_bool m_ready_read_pending{false};
+    FrameSplitter m_frame_splitter;
+    FrameHandler m_frame_handler;
+    //partial frame kept between reads, only touched by the io thread
+    QByteArray m_frame_buffer;
 private:
     class my_tcp_context
     {
@@ -82,6 +128,18 @@ private:
     public:
         static boost::asio::io_context *getTcpContext();
     };
+    //read buffers of closed sockets are kept for the next connection instead of going back to the heap
+    class my_buffer_pool
+    {
+    private:
+        my_buffer_pool(){}
+        static std::multimap<quint64, char*> free_buffers;
+        static std::mutex pool_mutex;
+        static const size_t max_free_buffers = 256;
+    public:
+        static char *acquire(quint64 size);
+        static void release(char *buf, quint64 size);
+    };
 };
 
 #endif // MYTCPSOCKET_H
@@ -33,6 +33,13 @@ bool MyUdpSocket::connectTo(QHostAddress host, quint16 port)
     return true;
 }
 
+void MyUdpSocket::setFrameHandler(FrameSplitter splitter, FrameHandler handler)
+{
+    std::unique_lock<std::mutex> lock(m_socket_mutex);
+    m_frame_splitter = splitter;
+    m_frame_handler = handler;
+}
+
 
 bool MyUdpSocket::isSequential() const
 {
@@ -132,8 +139,62 @@ void MyUdpSocket::asyncReceiveCallback(const std::error_code &ec, int size)
     else
     {
         std::unique_lock<std::mutex> lock(m_socket_mutex);
-        m_recv_buffer.append(m_asio_read_buf, size);
-        emit readyRead();
+        bool buffered {true};
+        if(m_frame_handler)
+        {
+            //a datagram never carries half a frame, whatever the splitter leaves over is dropped
+            FrameSplitter splitter = m_frame_splitter;
+            FrameHandler handler = m_frame_handler;
+            lock.unlock();
+            int offset = 0;
+            while(offset < size)
+            {
+                qint64 frame_size = splitter ? splitter(m_asio_read_buf + offset, size - offset) : size - offset;
+                if(frame_size < 0)
+                {
+                    offset += std::min<qint64>(-frame_size, size - offset);
+                    continue;
+                }
+                if(frame_size == 0)
+                {
+                    break;
+                }
+                handler(m_asio_read_buf + offset, frame_size);
+                offset += frame_size;
+            }
+            lock.lock();
+            buffered = false;
+        }
+        else
+        {
+            m_recv_buffer.append(m_asio_read_buf, size);
+        }
         m_asio_socket->async_receive_from(buffer(m_asio_read_buf,m_read_buffer_size), m_remote_ep, std::bind(&MyUdpSocket::asyncReceiveCallback,this,std::placeholders::_1,std::placeholders::_2));
+        lock.unlock();
+        if(buffered)
+        {
+            notifyReadyRead();
+        }
     }
 }
+
+void MyUdpSocket::notifyReadyRead()
+{
+    //at most one wakeup is queued per socket, it is re-armed once the owner thread picks it up
+    if(m_ready_read_pending.exchange(true))
+    {
+        return;
+    }
+    QMetaObject::invokeMethod(this, [this](){
+        m_ready_read_pending = false;
+        bool has_data {false};
+        {
+            std::unique_lock<std::mutex> lock(m_socket_mutex);
+            has_data = !m_recv_buffer.isEmpty();
+        }
+        if(has_data)
+        {
+            emit readyRead();
+        }
+    }, Qt::QueuedConnection);
+}
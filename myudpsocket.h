@@ -4,6 +4,8 @@
 #include <QIODevice>
 #include <boost/asio.hpp>
 #include <mutex>
+#include <atomic>
+#include <functional>
 #include <QByteArray>
 #include <QHostAddress>
 
@@ -15,9 +17,16 @@ class MyUdpSocket : public QIODevice
     typedef boost::shared_ptr<boost::asio::ip::udp::resolver> acceptor_ptr;
 
 public:
+    //returns the size of the complete frame at the head of data, 0 when the rest of the datagram is not a frame,
+    //minus the number of bytes to skip when data does not start with a frame
+    typedef std::function<qint64(const char *data, qint64 size)> FrameSplitter;
+    //runs on the io thread, data is only valid during the call
+    typedef std::function<void(const char *data, qint64 size)> FrameHandler;
+
     explicit MyUdpSocket(quint64 read_buffer_size = 1024 * 1024, QObject *parent = nullptr);
     void setReadBufferSize(quint64 buf_size);
     bool connectTo(QHostAddress host, quint16 port);
+    void setFrameHandler(FrameSplitter splitter, FrameHandler handler);
 
 signals:
     void socketErrorOccurred(const std::error_code &ec);
@@ -38,6 +47,7 @@ protected:
 private:
     void asyncSendCallback(const std::error_code &ec, int size);
     void asyncReceiveCallback(const std::error_code &ec, int size);
+    void notifyReadyRead();
 
 protected:
     socket_ptr m_asio_socket;
@@ -45,7 +55,10 @@ protected:
     std::mutex m_socket_mutex;
     char *m_asio_read_buf;
     quint64 m_read_buffer_size;
+    std::atomic_bool m_ready_read_pending{false};
     boost::asio::ip::udp::endpoint m_remote_ep;
+    FrameSplitter m_frame_splitter;
+    FrameHandler m_frame_handler;
 };
 
 #endif // MYUDPSOCKET_H
@@ -4,9 +4,25 @@
 #include <QNetworkInterface>
 #include <QSerialPortInfo>
 #include <QMainWindow>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDir>
 #include "floatbox.h"
 #include "mytcpsocket.h"
 #include "myudpsocket.h"
+#include "mylocaldatagramsocket.h"
+#include "mysharedmemorypipe.h"
+#include "ptypair.h"
+#include "bulklistener.h"
+#include "modbusmasterengine.h"
+
+namespace {
+//a modbus route runs on the engine thread, its sockets are put there before any io is started on them
+QThread *routeThread(const QString &protocol)
+{
+    return protocol.contains("Modbus") ? ModbusMasterEngine::instance()->engineThread() : nullptr;
+}
+}
 
 const QMap<QString, QSerialPort::BaudRate> OpenRouteDialog::baud_map = {
     {"1200", QSerialPort::Baud1200},
@@ -50,7 +66,8 @@ const QMap<QString, QList<QString> > OpenRouteDialog::protocol_map = {
     {tr("Serial Port"), {"Modbus-RTU", "Modbus-ASCII"}},
     {tr("TCP-Server"), {"Modbus-TCP", "Modbus-RTU", "Modbus-ASCII"}},
     {tr("TCP-Client"), {"Modbus-TCP", "Modbus-RTU", "Modbus-ASCII"}},
-    {"UDP", {"Modbus-UDP","Modbus-RTU","Modbus-ASCII"}}
+    {"UDP", {"Modbus-UDP","Modbus-RTU","Modbus-ASCII"}},
+    {tr("Local"), {"Modbus-TCP", "Modbus-RTU", "Modbus-ASCII"}}
 };
 
 const QMap<QString, int> OpenRouteDialog::protocol_enum_map = {
@@ -61,7 +78,7 @@ const QMap<QString, int> OpenRouteDialog::protocol_enum_map = {
 
 OpenRouteDialog::OpenRouteDialog(QWidget *parent)
     : QDialog(parent)
-    , ui(new Ui::OpenRouteDialog), m_connecting_client{nullptr}, m_parent_window(parent)
+    , ui(new Ui::OpenRouteDialog), m_connecting_client{nullptr}, m_pooled_pending{0}, m_pooled_failed{false}, m_parent_window(parent)
 {
     ui->setupUi(this);
     setWindowModality(Qt::WindowModal);
@@ -76,6 +93,7 @@ OpenRouteDialog::OpenRouteDialog(QWidget *parent)
     ui->box_stop_bits->addItems(stop_bits_map.keys());
     ui->box_flow_control->addItems(flow_control_map.keys());
     ui->box_protocol_serial_port->addItems(protocol_map[tr("Serial Port")]);
+    on_box_identity_serial_port_currentTextChanged(ui->box_identity_serial_port->currentText());
 
     QList<QHostAddress> hosts = QNetworkInterface::allAddresses();
     bool cvt_ok{ false };
@@ -94,6 +112,9 @@ OpenRouteDialog::OpenRouteDialog(QWidget *parent)
     ui->box_tcp_client_protocol->addItems(protocol_map[tr("TCP-Client")]);
 
     ui->box_udp_protocol->addItems(protocol_map[("UDP")]);
+
+    ui->box_local_protocol->addItems(protocol_map[tr("Local")]);
+    on_box_local_transport_currentTextChanged(ui->box_local_transport->currentText());
 }
 
 OpenRouteDialog::~OpenRouteDialog()
@@ -101,27 +122,64 @@ OpenRouteDialog::~OpenRouteDialog()
     delete ui;
 }
 
-void OpenRouteDialog::tcpSocketDisconnectedFromHost()
+void OpenRouteDialog::clientConnectFinished(bool connected)
 {
-    MyTcpSocket *socket = dynamic_cast<MyTcpSocket*>(sender());
-    if(socket)
+    MyTcpSocket *client = m_connecting_client;
+    if(!client || sender() != client)
+    {
+        return;
+    }
+    //a reconnecting client reports every attempt, only the first one decides about the route
+    disconnect(client, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::clientConnectFinished);
+    m_connecting_client = nullptr;
+    //a client that keeps trying gets its route anyway, it comes up whenever the server does
+    if(connected || client->autoReconnect())
     {
-        socket->deleteLater();
+        emit createdRoute(client, QString("%1:%2 - %3").arg(ui->edit_tcp_remote_server_addr->text()).arg(ui->box_tcp_remote_server_port->value()).arg(ui->box_tcp_client_protocol->currentText()),protocol_enum_map[ui->box_tcp_client_protocol->currentText()], ui->box_identity_tcp_client->currentText() == tr("Master"));
+        hide();
+    }
+    else
+    {
+        client->deleteLater();
     }
 }
 
-void OpenRouteDialog::clientConnectFinished(bool connected)
+void OpenRouteDialog::pooledClientConnectFinished(bool connected)
 {
-    if(connected)
+    MyTcpSocket *client = qobject_cast<MyTcpSocket*>(sender());
+    if(!client || !m_pooled_clients.contains(client))
     {
-        connect(m_connecting_client, &MyTcpSocket::disconnectedFromHost, this, &OpenRouteDialog::tcpSocketDisconnectedFromHost);
-        emit createdRoute(m_connecting_client, QString("%1:%2 - %3").arg(m_connecting_client->peerAddress()).arg(m_connecting_client->peerPort()).arg(ui->box_tcp_client_protocol->currentText()),protocol_enum_map[ui->box_tcp_client_protocol->currentText()], ui->box_identity_tcp_client->currentText() == tr("Master"));
-        hide();
+        return;
+    }
+    disconnect(client, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::pooledClientConnectFinished);
+    //a connection that keeps trying joins the pool down, the engine uses it once it is up
+    if(!connected && !client->autoReconnect())
+    {
+        m_pooled_failed = true;
+    }
+    if(--m_pooled_pending > 0)
+    {
+        return;
+    }
+    //the route is only created once every connection of the pool made its first attempt
+    if(m_pooled_failed)
+    {
+        for(auto x : m_pooled_clients)
+        {
+            x->deleteLater();
+        }
     }
     else
     {
-        m_connecting_client->deleteLater();
+        QList<QIODevice*> coms;
+        for(auto x : m_pooled_clients)
+        {
+            coms.append(x);
+        }
+        emit createdPooledRoute(coms, QString("%1:%2 x%3 - %4").arg(ui->edit_tcp_remote_server_addr->text()).arg(ui->box_tcp_remote_server_port->value()).arg(coms.size()).arg(ui->box_tcp_client_protocol->currentText()), protocol_enum_map[ui->box_tcp_client_protocol->currentText()], ui->box_dispatch->currentIndex());
+        hide();
     }
+    m_pooled_clients.clear();
 }
 
 void OpenRouteDialog::socketErrorOccurred(const std::error_code &ec)
@@ -134,11 +192,19 @@ void OpenRouteDialog::newTcpConnectionIncoming(MyTcpSocket *sock_ptr)
     MyTcpSocket *server = dynamic_cast<MyTcpSocket*>(sender());
     if(server)
     {
-        connect(sock_ptr, &MyTcpSocket::disconnectedFromHost, this, &OpenRouteDialog::tcpSocketDisconnectedFromHost);
         emit createdRoute(sock_ptr,QString("%1:%2 - %3").arg(sock_ptr->peerAddress()).arg(sock_ptr->peerPort()).arg(m_server_protocol_map[server]),protocol_enum_map[m_server_protocol_map[server]], m_server_identity_map[server]);
     }
 }
 
+void OpenRouteDialog::newBulkConnectionIncoming(MyTcpSocket *sock_ptr, QString endpoint)
+{
+    BulkListener *listener = qobject_cast<BulkListener*>(sender());
+    if(listener)
+    {
+        emit createdEndpointRoute(sock_ptr, endpoint, listener->protocol(), listener->isMaster());
+    }
+}
+
 void OpenRouteDialog::on_button_open_serial_port_clicked()
 {
     QSerialPort *serial_port = new QSerialPort(ui->box_port_name->currentText());
@@ -147,7 +213,28 @@ void OpenRouteDialog::on_button_open_serial_port_clicked()
     serial_port->setStopBits(stop_bits_map[ui->box_stop_bits->currentText()]);
     serial_port->setParity(parity_map[ui->box_parity->currentText()]);
     serial_port->setFlowControl(flow_control_map[ui->box_flow_control->currentText()]);
-    if(serial_port->open(QIODevice::ReadWrite))
+    if(ui->box_identity_serial_port->currentText() == tr("Gateway") && protocol_enum_map[ui->box_protocol_serial_port->currentText()] != MODBUS_RTU)
+    {
+        FloatBox::message(tr("The gateway bridges onto a Modbus-RTU bus only"), 3000, m_parent_window->geometry());
+        delete serial_port;
+        return;
+    }
+    if(serial_port->open(QIODevice::ReadWrite) && ui->box_identity_serial_port->currentText() == tr("Gateway"))
+    {
+        MyTcpSocket *server = new MyTcpSocket();
+        connect(server, &MyTcpSocket::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
+        if(server->bind(QHostAddress(QHostAddress::AnyIPv4), ui->box_gateway_port->value()))
+        {
+            emit createdGatewayRoute(server, serial_port, QString("%1 <- :%2").arg(serial_port->portName()).arg(ui->box_gateway_port->value()));
+            hide();
+        }
+        else
+        {
+            server->deleteLater();
+            delete serial_port;
+        }
+    }
+    else if(serial_port->isOpen())
     {
         emit createdRoute(serial_port, serial_port->portName(), protocol_enum_map[ui->box_protocol_serial_port->currentText()], ui->box_identity_serial_port->currentText() == tr("Master"));
         hide();
@@ -159,10 +246,48 @@ void OpenRouteDialog::on_button_open_serial_port_clicked()
 }
 
 
+void OpenRouteDialog::on_button_create_pty_pair_clicked()
+{
+    PtyPair *pty_pair = new PtyPair(this);
+    if(!pty_pair->open(ui->box_pty_baud->value()))
+    {
+        FloatBox::message(pty_pair->errorString(), 3000, m_parent_window->geometry());
+        delete pty_pair;
+        return;
+    }
+    m_pty_pairs.append(pty_pair);
+    //the pair lives as long as the dialog, open one end here for each route
+    ui->box_port_name->addItem(pty_pair->portName(0));
+    ui->box_port_name->addItem(pty_pair->portName(1));
+    ui->box_port_name->setCurrentText(pty_pair->portName(0));
+    FloatBox::message(QString("%1 : %2 <-> %3").arg(tr("PTY Pair"), pty_pair->portName(0), pty_pair->portName(1)), 3000, m_parent_window->geometry());
+}
+
+
 void OpenRouteDialog::on_button_listen_clicked()
 {
+    int endpoint_count = ui->box_tcp_server_addr_count->value() * ui->box_tcp_server_port_count->value();
+    if(endpoint_count > 1)
+    {
+        BulkListener *listener = new BulkListener(protocol_enum_map[ui->box_tcp_server_protocol->currentText()], ui->box_identity_tcp_server->currentText() == tr("Master"), this);
+        listener->setConnectionThread(routeThread(ui->box_tcp_server_protocol->currentText()));
+        int listening = listener->bind(QHostAddress(ui->box_tcp_server_addr->currentText()), ui->box_tcp_server_addr_count->value(), ui->box_tcp_server_port->value(), ui->box_tcp_server_port_count->value());
+        FloatBox::message(QString("%1 : %2/%3").arg(tr("Listening")).arg(listening).arg(endpoint_count), 3000, m_parent_window->geometry());
+        if(listening == 0)
+        {
+            delete listener;
+            return;
+        }
+        //bind errors are summed up above, only errors of running endpoints are shown one by one
+        connect(listener, &BulkListener::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
+        connect(listener, &BulkListener::newConnectionIncoming, this, &OpenRouteDialog::newBulkConnectionIncoming);
+        m_bulk_listeners.append(listener);
+        hide();
+        return;
+    }
     MyTcpSocket *server = new MyTcpSocket();
     connect(server, &MyTcpSocket::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
+    server->setConnectionThread(routeThread(ui->box_tcp_server_protocol->currentText()));
     if(server->bind(QHostAddress(ui->box_tcp_server_addr->currentText()),ui->box_tcp_server_port->value()))
     {
         connect(server, &MyTcpSocket::newConnectionIncoming, this, &OpenRouteDialog::newTcpConnectionIncoming);
@@ -181,15 +306,67 @@ void OpenRouteDialog::on_button_listen_clicked()
 
 void OpenRouteDialog::on_button_connect_clicked()
 {
+    if(ui->box_connections->value() > 1 && ui->box_tcp_client_protocol->currentText().contains("Modbus") && ui->box_identity_tcp_client->currentText() == tr("Master"))
+    {
+        if(m_pooled_pending > 0)
+        {
+            //connections still retrying from the last click are given up, the pool starts over
+            for(auto x : m_pooled_clients)
+            {
+                disconnect(x, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::pooledClientConnectFinished);
+                x->deleteLater();
+            }
+            m_pooled_clients.clear();
+        }
+        m_pooled_failed = false;
+        m_pooled_pending = ui->box_connections->value();
+        for(int i = 0; i < ui->box_connections->value(); ++i)
+        {
+            MyTcpSocket *client = new MyTcpSocket();
+            //a pool is always a modbus route
+            client->moveToThread(ModbusMasterEngine::instance()->engineThread());
+            connect(client, &MyTcpSocket::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
+            connect(client, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::pooledClientConnectFinished);
+            client->setAutoReconnect(ui->box_auto_reconnect->isChecked());
+            m_pooled_clients.append(client);
+            if(!client->connectToHost(ui->edit_tcp_remote_server_addr->text(), ui->box_tcp_remote_server_port->value(), ui->box_connect_timeout->value()))
+            {
+                //the address is the same for every connection, the rest would fail alike
+                disconnect(client, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::pooledClientConnectFinished);
+                m_pooled_failed = true;
+                m_pooled_pending -= ui->box_connections->value() - i;
+                break;
+            }
+        }
+        if(m_pooled_pending == 0)
+        {
+            for(auto x : m_pooled_clients)
+            {
+                x->deleteLater();
+            }
+            m_pooled_clients.clear();
+        }
+        return;
+    }
+    if(m_connecting_client)
+    {
+        //a client still retrying from the last click is given up
+        disconnect(m_connecting_client, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::clientConnectFinished);
+        m_connecting_client->deleteLater();
+    }
     MyTcpSocket *client = new MyTcpSocket();
-    connect(client, &MyTcpSocket::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
-    m_connecting_client = client;
-    if(client->connectToHost(ui->edit_tcp_remote_server_addr->text(), ui->box_tcp_remote_server_port->value()))
+    QThread *route_thread = routeThread(ui->box_tcp_client_protocol->currentText());
+    if(route_thread)
     {
-        connect(client, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::clientConnectFinished);
+        client->moveToThread(route_thread);
     }
-    else
+    connect(client, &MyTcpSocket::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
+    m_connecting_client = client;
+    connect(client, &MyTcpSocket::connectFinished, this, &OpenRouteDialog::clientConnectFinished);
+    client->setAutoReconnect(ui->box_auto_reconnect->isChecked());
+    if(!client->connectToHost(ui->edit_tcp_remote_server_addr->text(), ui->box_tcp_remote_server_port->value(), ui->box_connect_timeout->value()))
     {
+        m_connecting_client = nullptr;
         client->deleteLater();
     }
 }
@@ -210,6 +387,21 @@ void OpenRouteDialog::on_box_protocol_serial_port_currentTextChanged(const QStri
 }
 
 
+void OpenRouteDialog::on_box_identity_serial_port_currentTextChanged(const QString &arg1)
+{
+    if(arg1 == tr("Gateway"))
+    {
+        ui->box_gateway_port->show();
+        ui->label_gateway_port->show();
+    }
+    else
+    {
+        ui->box_gateway_port->hide();
+        ui->label_gateway_port->hide();
+    }
+}
+
+
 void OpenRouteDialog::on_box_tcp_server_protocol_currentTextChanged(const QString &arg1)
 {
     if(arg1.contains("Modbus"))
@@ -231,11 +423,19 @@ void OpenRouteDialog::on_box_tcp_client_protocol_currentTextChanged(const QStrin
     {
         ui->box_identity_tcp_client->show();
         ui->label_identity_tcp_client->show();
+        ui->box_connections->show();
+        ui->label_connections->show();
+        ui->box_dispatch->show();
+        ui->label_dispatch->show();
     }
     else
     {
         ui->box_identity_tcp_client->hide();
         ui->label_identity_tcp_client->hide();
+        ui->box_connections->hide();
+        ui->label_connections->hide();
+        ui->box_dispatch->hide();
+        ui->label_dispatch->hide();
     }
 }
 
@@ -258,6 +458,11 @@ void OpenRouteDialog::on_box_udp_protocol_currentTextChanged(const QString &arg1
 void OpenRouteDialog::on_button_connect_udp_clicked()
 {
     MyUdpSocket *udp_socket = new MyUdpSocket();
+    QThread *route_thread = routeThread(ui->box_udp_protocol->currentText());
+    if(route_thread)
+    {
+        udp_socket->moveToThread(route_thread);
+    }
     connect(udp_socket, &MyUdpSocket::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
     if(udp_socket->connectTo(QHostAddress(ui->edit_udp_remote_server_addr->text()), ui->box_udp_remote_server_port->value()))
     {
@@ -270,3 +475,108 @@ void OpenRouteDialog::on_button_connect_udp_clicked()
     }
 }
 
+void OpenRouteDialog::newLocalConnectionIncoming()
+{
+    QLocalServer *server = qobject_cast<QLocalServer*>(sender());
+    while(server && server->hasPendingConnections())
+    {
+        QLocalSocket *socket = server->nextPendingConnection();
+        emit createdRoute(socket, QString("%1 - %2").arg(server->serverName(), m_local_server_protocol_map[server]), protocol_enum_map[m_local_server_protocol_map[server]], m_local_server_identity_map[server]);
+    }
+}
+
+void OpenRouteDialog::on_button_open_local_clicked()
+{
+    QString name = ui->edit_local_name->text();
+    QString protocol = ui->box_local_protocol->currentText();
+    bool is_master = ui->box_identity_local->currentText() == tr("Master");
+    bool is_server = ui->box_local_side->currentText() == tr("Server");
+    if(ui->box_local_transport->currentText() == tr("Unix Stream"))
+    {
+        if(is_server)
+        {
+            QLocalServer *server = new QLocalServer(this);
+            QLocalServer::removeServer(name);
+            if(!server->listen(name))
+            {
+                FloatBox::message(server->errorString(), 3000, m_parent_window->geometry());
+                delete server;
+                return;
+            }
+            connect(server, &QLocalServer::newConnection, this, &OpenRouteDialog::newLocalConnectionIncoming);
+            m_local_server_protocol_map[server] = protocol;
+            m_local_server_identity_map[server] = is_master;
+            m_local_servers.append(server);
+            FloatBox::message(QString("%1 : %2").arg(tr("Listening"), server->serverName()), 3000, m_parent_window->geometry());
+        }
+        else
+        {
+            QLocalSocket *socket = new QLocalSocket();
+            socket->connectToServer(name);
+            //a local connect is answered by the kernel right away, there is no handshake to wait for
+            if(!socket->waitForConnected(1000))
+            {
+                FloatBox::message(socket->errorString(), 3000, m_parent_window->geometry());
+                delete socket;
+                return;
+            }
+            emit createdRoute(socket, QString("%1 - %2").arg(name, protocol), protocol_enum_map[protocol], is_master);
+        }
+    }
+    else if(ui->box_local_transport->currentText() == tr("Unix Datagram"))
+    {
+        MyLocalDatagramSocket *socket = new MyLocalDatagramSocket();
+        connect(socket, &MyLocalDatagramSocket::socketErrorOccurred, this, &OpenRouteDialog::socketErrorOccurred);
+        QString dir = QDir::tempPath();
+        if(!socket->bind(QString("%1/%2.sock").arg(dir, name), QString("%1/%2.sock").arg(dir, ui->edit_local_peer->text())))
+        {
+            socket->deleteLater();
+            return;
+        }
+        emit createdRoute(socket, QString("%1 -> %2 - %3").arg(name, ui->edit_local_peer->text(), protocol), protocol_enum_map[protocol], is_master);
+    }
+    else
+    {
+        MySharedMemoryPipe *pipe = new MySharedMemoryPipe();
+        if(!pipe->open(name, is_server))
+        {
+            FloatBox::message(pipe->errorString(), 3000, m_parent_window->geometry());
+            delete pipe;
+            return;
+        }
+        emit createdRoute(pipe, QString("%1 - %2").arg(name, protocol), protocol_enum_map[protocol], is_master);
+    }
+    hide();
+}
+
+void OpenRouteDialog::on_box_local_transport_currentTextChanged(const QString &arg1)
+{
+    if(arg1 == tr("Unix Datagram"))
+    {
+        ui->box_local_side->hide();
+        ui->label_local_side->hide();
+        ui->edit_local_peer->show();
+        ui->label_local_peer->show();
+    }
+    else
+    {
+        ui->box_local_side->show();
+        ui->label_local_side->show();
+        ui->edit_local_peer->hide();
+        ui->label_local_peer->hide();
+    }
+}
+
+void OpenRouteDialog::on_box_local_protocol_currentTextChanged(const QString &arg1)
+{
+    if(arg1.contains("Modbus"))
+    {
+        ui->box_identity_local->show();
+        ui->label_identity_local->show();
+    }
+    else
+    {
+        ui->box_identity_local->hide();
+        ui->label_identity_local->hide();
+    }
+}
@@ -12,6 +12,9 @@ class OpenRouteDialog;
 
 class MyTcpSocket;
 class MyUdpSocket;
+class QLocalServer;
+class PtyPair;
+class BulkListener;
 
 enum Protocols{
     MODBUS_RTU,
@@ -30,25 +33,35 @@ public:
 
 signals:
     void createdRoute(QIODevice *com, QString name, int protocol, bool is_master);
+    void createdPooledRoute(QList<QIODevice*> coms, QString name, int protocol, int dispatch);
+    void createdGatewayRoute(MyTcpSocket *server, QIODevice *com, QString name);
+    void createdEndpointRoute(QIODevice *com, QString endpoint, int protocol, bool is_master);
 
 private slots:
 
-    void tcpSocketDisconnectedFromHost();
 
     void clientConnectFinished(bool connected);
 
+    void pooledClientConnectFinished(bool connected);
+
     void socketErrorOccurred(const std::error_code &ec);
 
     void newTcpConnectionIncoming(MyTcpSocket *sock_ptr);
 
+    void newBulkConnectionIncoming(MyTcpSocket *sock_ptr, QString endpoint);
+
     void on_button_open_serial_port_clicked();
 
+    void on_button_create_pty_pair_clicked();
+
     void on_button_listen_clicked();
 
     void on_button_connect_clicked();
 
     void on_box_protocol_serial_port_currentTextChanged(const QString &arg1);
 
+    void on_box_identity_serial_port_currentTextChanged(const QString &arg1);
+
     void on_box_tcp_server_protocol_currentTextChanged(const QString &arg1);
 
     void on_box_tcp_client_protocol_currentTextChanged(const QString &arg1);
@@ -57,6 +70,14 @@ private slots:
 
     void on_button_connect_udp_clicked();
 
+    void newLocalConnectionIncoming();
+
+    void on_button_open_local_clicked();
+
+    void on_box_local_transport_currentTextChanged(const QString &arg1);
+
+    void on_box_local_protocol_currentTextChanged(const QString &arg1);
+
 private:
     Ui::OpenRouteDialog *ui;
 
@@ -69,9 +90,17 @@ private:
     static const QMap<QString, int> protocol_enum_map;
 
     QList<MyTcpSocket*> m_listening_servers;
+    QList<BulkListener*> m_bulk_listeners;
     QMap<MyTcpSocket*, QString> m_server_protocol_map;
     QMap<MyTcpSocket*, bool> m_server_identity_map;
     MyTcpSocket *m_connecting_client;
+    QList<QLocalServer*> m_local_servers;
+    QList<PtyPair*> m_pty_pairs;
+    QMap<QLocalServer*, QString> m_local_server_protocol_map;
+    QMap<QLocalServer*, bool> m_local_server_identity_map;
+    QList<MyTcpSocket*> m_pooled_clients;
+    int m_pooled_pending;
+    bool m_pooled_failed;
 
     QWidget *m_parent_window;
 };
@@ -0,0 +1,213 @@
+#include "ptypair.h"
+#include <QSocketNotifier>
+#include <QTimer>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#endif
+
+namespace {
+//a side that reads nothing holds the other one back once this much waits for it
+const int max_pending_size = 64 * 1024;
+}
+
+PtyPair::PtyPair(QObject *parent)
+    : QObject{parent}, m_master_fd{-1, -1}, m_notifier{nullptr, nullptr}, m_write_notifier{nullptr, nullptr}, m_baud_rate(0), m_byte_budget{0, 0}
+{
+    m_pace_timer = new QTimer(this);
+    m_pace_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_pace_timer, &QTimer::timeout, this, &PtyPair::paceTimerTimeoutSlot);
+}
+
+PtyPair::~PtyPair()
+{
+    close();
+}
+
+bool PtyPair::open(int baud_rate)
+{
+#ifdef Q_OS_UNIX
+    m_baud_rate = baud_rate;
+    for(int i = 0; i < 2; ++i)
+    {
+        if(!openMaster(i))
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(baud_rate);
+    m_error_string = tr("Pseudo terminals are not supported on this platform");
+    return false;
+#endif
+}
+
+void PtyPair::close()
+{
+    m_pace_timer->stop();
+    for(int i = 0; i < 2; ++i)
+    {
+        delete m_notifier[i];
+        m_notifier[i] = nullptr;
+        delete m_write_notifier[i];
+        m_write_notifier[i] = nullptr;
+#ifdef Q_OS_UNIX
+        if(m_master_fd[i] >= 0)
+        {
+            ::close(m_master_fd[i]);
+        }
+#endif
+        m_master_fd[i] = -1;
+        m_pending[i].clear();
+    }
+}
+
+QString PtyPair::portName(int side) const
+{
+    return m_port_name[side];
+}
+
+QString PtyPair::errorString() const
+{
+    return m_error_string;
+}
+
+bool PtyPair::openMaster(int side)
+{
+#ifdef Q_OS_UNIX
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+    {
+        m_error_string = QString::fromLocal8Bit(strerror(errno));
+        if(fd >= 0)
+        {
+            ::close(fd);
+        }
+        return false;
+    }
+    //the master side must pass bytes through untouched, the slave side is configured by whoever opens it
+    termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    m_master_fd[side] = fd;
+    m_port_name[side] = QString::fromLocal8Bit(ptsname(fd));
+    m_notifier[side] = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(m_notifier[side], &QSocketNotifier::activated, this, std::bind(&PtyPair::masterReadyRead, this, side));
+    m_write_notifier[side] = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+    m_write_notifier[side]->setEnabled(false);
+    connect(m_write_notifier[side], &QSocketNotifier::activated, this, std::bind(&PtyPair::forward, this, side));
+    return true;
+#else
+    Q_UNUSED(side);
+    return false;
+#endif
+}
+
+void PtyPair::masterReadyRead(int side)
+{
+#ifdef Q_OS_UNIX
+    char buf[4096];
+    ssize_t size = 0;
+    while(m_pending[1 - side].size() < max_pending_size && (size = ::read(m_master_fd[side], buf, sizeof(buf))) > 0)
+    {
+        m_pending[1 - side].append(buf, size);
+    }
+    if(m_pending[1 - side].size() >= max_pending_size)
+    {
+        //the other side is not reading, this one is left to fill its own terminal until it does
+        m_notifier[side]->setEnabled(false);
+    }
+    else if(size < 0 && errno == EIO)
+    {
+        //no one holds the slave end open, back off instead of spinning on the hang-up
+        m_notifier[side]->setEnabled(false);
+        QTimer::singleShot(100, this, [this, side](){
+            if(m_notifier[side])
+            {
+                m_notifier[side]->setEnabled(true);
+            }
+        });
+    }
+    if(m_baud_rate == 0)
+    {
+        forward(1 - side);
+    }
+    else if(!m_pace_timer->isActive() && !m_pending[1 - side].isEmpty())
+    {
+        //the line is idle until something waits, the budget starts from now
+        m_pace_clock.start();
+        m_pace_timer->start(1);
+    }
+#else
+    Q_UNUSED(side);
+#endif
+}
+
+void PtyPair::paceTimerTimeoutSlot()
+{
+    //one character is start bit, 8 data bits and stop bit on the line
+    double elapsed_s = m_pace_clock.nsecsElapsed() / 1e9;
+    m_pace_clock.restart();
+    for(int i = 0; i < 2; ++i)
+    {
+        if(m_pending[i].isEmpty())
+        {
+            m_byte_budget[i] = 0;
+            continue;
+        }
+        m_byte_budget[i] += elapsed_s * m_baud_rate / 10.0;
+        forward(i);
+    }
+    if(m_pending[0].isEmpty() && m_pending[1].isEmpty())
+    {
+        m_byte_budget[0] = m_byte_budget[1] = 0;
+        m_pace_timer->stop();
+    }
+}
+
+void PtyPair::forward(int to_side)
+{
+#ifdef Q_OS_UNIX
+    if(m_master_fd[to_side] < 0 || m_pending[to_side].isEmpty())
+    {
+        return;
+    }
+    qint64 size = m_pending[to_side].size();
+    if(m_baud_rate > 0)
+    {
+        size = qMin<qint64>(size, qint64(m_byte_budget[to_side]));
+        if(size <= 0)
+        {
+            return;
+        }
+    }
+    ssize_t written = ::write(m_master_fd[to_side], m_pending[to_side].constData(), size);
+    if(written > 0)
+    {
+        m_pending[to_side].remove(0, written);
+        if(m_baud_rate > 0)
+        {
+            m_byte_budget[to_side] -= written;
+        }
+        if(m_pending[to_side].size() < max_pending_size && m_notifier[1 - to_side] && !m_notifier[1 - to_side]->isEnabled())
+        {
+            m_notifier[1 - to_side]->setEnabled(true);
+        }
+    }
+    //unpaced bytes the terminal did not take are written as soon as it has room again
+    if(m_baud_rate == 0)
+    {
+        m_write_notifier[to_side]->setEnabled(!m_pending[to_side].isEmpty());
+    }
+#else
+    Q_UNUSED(to_side);
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef PTYPAIR_H
+#define PTYPAIR_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QElapsedTimer>
+
+class QSocketNotifier;
+class QTimer;
+
+/*
+ * A virtual null modem made of two pseudo terminals. Whatever is written to one slave
+ * end comes out of the other, so two serial routes can be wired together without hardware.
+ * With a baud rate set, bytes are released at the speed a real line would carry them.
+ */
+
+class PtyPair : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PtyPair(QObject *parent = nullptr);
+    ~PtyPair();
+    //baud_rate 0 forwards bytes as fast as they arrive
+    bool open(int baud_rate = 0);
+    void close();
+    QString portName(int side) const;
+    QString errorString() const;
+
+private slots:
+    void masterReadyRead(int side);
+    void paceTimerTimeoutSlot();
+
+private:
+    bool openMaster(int side);
+    void forward(int to_side);
+
+private:
+    int m_master_fd[2];
+    QString m_port_name[2];
+    QSocketNotifier *m_notifier[2];
+    //only enabled while bytes for that side wait on a full terminal
+    QSocketNotifier *m_write_notifier[2];
+    //bytes read from one side, waiting to be written to the other
+    QByteArray m_pending[2];
+    int m_baud_rate;
+    double m_byte_budget[2];
+    QElapsedTimer m_pace_clock;
+    QTimer *m_pace_timer;
+    QString m_error_string;
+};
+
+#endif // PTYPAIR_H
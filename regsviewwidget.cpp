@@ -6,9 +6,12 @@
 #include <QCursor>
 #include <QInputDialog>
 #include <QtEndian>
+#include <QtMath>
 #include <QClipboard>
 #include "ModbusFrameInfo.h"
 #include "utils.h"
+#include "deadbanddialog.h"
+#include "generatordialog.h"
 
 
 RegsViewWidget::RegsViewWidget(ModbusRegReadDefinitions *reg_def, QWidget *parent)
@@ -94,6 +97,8 @@ RegsViewWidget::RegsViewWidget(ModbusRegReadDefinitions *reg_def, QWidget *paren
     m_popup_menu->addSeparator();
     m_copy_action = m_popup_menu->addAction(tr("Copy"));
     m_select_all_action = m_popup_menu->addAction(tr("Select All"));
+    m_deadband_action = m_popup_menu->addAction(tr("Deadband..."));
+    m_generator_action = m_popup_menu->addAction(tr("Generator..."));
 
     m_format_map = {
         {m_format_signed_action, Format_Signed},
@@ -144,6 +149,11 @@ RegsViewWidget::RegsViewWidget(ModbusRegReadDefinitions *reg_def, QWidget *paren
     m_format_signed_action->setChecked(true);
     connect(m_copy_action, &QAction::triggered, this, &RegsViewWidget::copyActionTriggered);
     connect(m_select_all_action, &QAction::triggered, this, &RegsViewWidget::selectAllActionTriggered);
+    connect(m_deadband_action, &QAction::triggered, this, &RegsViewWidget::deadbandActionTriggered);
+    m_deadband_action->setVisible(m_reg_defines->is_master &&
+                                  (m_reg_defines->function == ModbusReadHoldingRegisters || m_reg_defines->function == ModbusReadInputRegisters));
+    connect(m_generator_action, &QAction::triggered, this, &RegsViewWidget::generatorActionTriggered);
+    m_generator_action->setVisible(!m_reg_defines->is_master);
     if(!m_reg_defines->is_master)
     {
         ui->info_label->setText(QString("ID=%1;F=%2").arg(m_reg_defines->id).arg(m_reg_defines->function,2,10,QChar('0')));
@@ -165,6 +175,11 @@ void RegsViewWidget::setRegDef(ModbusRegReadDefinitions *reg_defines)
     delete[] m_register_values;
     m_register_values = new quint16[reg_defines->quantity]{0};
     m_cell_formats.clear();
+    m_deadbands.clear();
+    m_generators.clear();
+    m_generator_action->setVisible(!reg_defines->is_master);
+    m_deadband_action->setVisible(reg_defines->is_master &&
+                                  (reg_defines->function == ModbusReadHoldingRegisters || reg_defines->function == ModbusReadInputRegisters));
     for(int i = 0;i < reg_defines->quantity;++i)
     {
         m_table_model->setItem(i, 0, new QStandardItem());
@@ -204,15 +219,10 @@ void RegsViewWidget::setRegDef(ModbusRegReadDefinitions *reg_defines)
     }
 }
 
-void RegsViewWidget::increaseErrorCount()
+void RegsViewWidget::increaseCounts(quint32 send_count, quint32 error_count)
 {
-    m_error_count++;
-    ui->info_label->setText(QString("Tx=%1;Err=%2;ID=%3;F=%4;SR=%5ms").arg(m_send_count).arg(m_error_count).arg(m_reg_defines->id).arg(m_reg_defines->function,2,10,QChar('0')).arg(m_reg_defines->scan_rate));
-}
-
-void RegsViewWidget::increaseSendCount()
-{
-    m_send_count++;
+    m_send_count += send_count;
+    m_error_count += error_count;
     ui->info_label->setText(QString("Tx=%1;Err=%2;ID=%3;F=%4;SR=%5ms").arg(m_send_count).arg(m_error_count).arg(m_reg_defines->id).arg(m_reg_defines->function,2,10,QChar('0')).arg(m_reg_defines->scan_rate));
 }
 
@@ -227,7 +237,7 @@ bool RegsViewWidget::setRegisterValues(const quint16 *reg_values, quint16 reg_ad
     {
         quint16 index = reg_addr - m_reg_defines->reg_addr;
         memcpy(&m_register_values[index], reg_values, quantity * 2);
-        updateRegisterValues();
+        updateRegisterValues(index, quantity);
     }
     else
     {
@@ -318,6 +328,14 @@ void RegsViewWidget::formatActionTriggered()
             }
         }
         updateRegisterValues();
+        if(!m_deadbands.isEmpty())
+        {
+            emit deadbandsChanged(m_reg_defines);
+        }
+        if(!m_generators.isEmpty())
+        {
+            emit generatorsChanged(m_reg_defines);
+        }
     }
 }
 
@@ -344,10 +362,13 @@ void RegsViewWidget::selectAllActionTriggered()
     ui->regs_table_view->selectColumn(2);
 }
 
-void RegsViewWidget::updateRegisterValues()
+void RegsViewWidget::updateRegisterValues(int first_row, int row_count)
 {
     QString cell_text;
-    for(int i = 0;i < m_reg_defines->quantity; ++i)
+    int end_row = row_count < 0 ? m_reg_defines->quantity : qMin(first_row + row_count, int(m_reg_defines->quantity));
+    //a wide value shown on an earlier row covers up to three rows after it
+    first_row = qMax(0, first_row - 3);
+    for(int i = first_row;i < end_row; ++i)
     {
         switch(m_cell_formats[i])
         {
@@ -541,6 +562,126 @@ void RegsViewWidget::updateRegisterValues()
     }
 }
 
+QList<ModbusDeadband> RegsViewWidget::deadbands() const
+{
+    QList<ModbusDeadband> deadbands;
+    for(auto it = m_deadbands.constBegin(); it != m_deadbands.constEnd(); ++it)
+    {
+        int row = it.key();
+        if(row >= m_cell_formats.size() || m_cell_formats[row] == Format_None || m_cell_formats[row] == Format_Coil)
+        {
+            continue;
+        }
+        ModbusDeadband deadband;
+        deadband.offset = row;
+        deadband.format = m_cell_formats[row];
+        deadband.absolute = it.value().first;
+        deadband.percent = it.value().second;
+        deadbands.append(deadband);
+    }
+    return deadbands;
+}
+
+QList<ModbusGenerator> RegsViewWidget::generators() const
+{
+    QList<ModbusGenerator> generators;
+    for(auto it = m_generators.constBegin(); it != m_generators.constEnd(); ++it)
+    {
+        int row = it.key();
+        if(row >= m_cell_formats.size() || m_cell_formats[row] == Format_None)
+        {
+            continue;
+        }
+        ModbusGenerator generator = it.value();
+        generator.offset = row;
+        generator.format = m_cell_formats[row];
+        generator.source_format = generator.source < m_cell_formats.size() ? m_cell_formats[generator.source] : Format_Signed;
+        generators.append(generator);
+    }
+    return generators;
+}
+
+void RegsViewWidget::deadbandActionTriggered()
+{
+    QModelIndexList selections = ui->regs_table_view->selectionModel()->selectedIndexes();
+    if(selections.isEmpty())
+    {
+        return;
+    }
+    QList<int> rows;
+    for(const auto &x : selections)
+    {
+        rows.append(x.row());
+    }
+    QPair<double, double> deadband = m_deadbands.value(rows.first());
+    DeadbandDialog *deadband_dialog = new DeadbandDialog(deadband.first, deadband.second, this);
+    connect(deadband_dialog, &DeadbandDialog::deadbandSet, this, [this, rows](double absolute, double percent){
+        setDeadband(rows, absolute, percent);
+    });
+    deadband_dialog->show();
+}
+
+void RegsViewWidget::setDeadband(const QList<int> &rows, double absolute, double percent)
+{
+    for(auto x : rows)
+    {
+        //the rows covered by a wide value follow the deadband of the row showing it
+        if(x >= m_cell_formats.size() || m_cell_formats[x] == Format_None)
+        {
+            continue;
+        }
+        if(absolute <= 0 && percent <= 0)
+        {
+            m_deadbands.remove(x);
+        }
+        else
+        {
+            m_deadbands.insert(x, qMakePair(absolute, percent));
+        }
+    }
+    emit deadbandsChanged(m_reg_defines);
+}
+
+void RegsViewWidget::generatorActionTriggered()
+{
+    QModelIndexList selections = ui->regs_table_view->selectionModel()->selectedIndexes();
+    if(selections.isEmpty())
+    {
+        return;
+    }
+    QList<int> rows;
+    for(const auto &x : selections)
+    {
+        rows.append(x.row());
+    }
+    bool enabled = m_generators.contains(rows.first());
+    GeneratorDialog *generator_dialog = new GeneratorDialog(m_generators.value(rows.first()), enabled, m_reg_defines->reg_addr, this);
+    connect(generator_dialog, &GeneratorDialog::generatorSet, this, [this, rows](const ModbusGenerator &generator, bool enabled){
+        setGenerator(rows, generator, enabled);
+    });
+    generator_dialog->show();
+}
+
+void RegsViewWidget::setGenerator(const QList<int> &rows, const ModbusGenerator &generator, bool enabled)
+{
+    for(auto x : rows)
+    {
+        if(x >= m_cell_formats.size() || m_cell_formats[x] == Format_None)
+        {
+            continue;
+        }
+        if(enabled)
+        {
+            m_generators.insert(x, generator);
+        }
+        else
+        {
+            m_generators.remove(x);
+        }
+    }
+    emit generatorsChanged(m_reg_defines);
+}
+
 void RegsViewWidget::on_regs_table_view_customContextMenuRequested(const QPoint &pos)
 {
     QModelIndex index = ui->regs_table_view->indexAt(pos);
@@ -983,6 +1124,7 @@ void RegsViewWidget::on_regs_table_view_doubleClicked(const QModelIndex &index)
             }
             }
             updateRegisterValues();
+            emit registerValuesEdited(m_reg_defines, index.row(), ModbusValueCodec::valueWidth(m_cell_formats[index.row()]));
         }
         else if(m_reg_defines->is_master
                 &&(m_reg_defines->function == ModbusReadCoils || m_reg_defines->function == ModbusReadHoldingRegisters))
@@ -1054,17 +1196,21 @@ void RegsViewWidget::on_regs_table_view_doubleClicked(const QModelIndex &index)
                 }
                 case Format_Binary:
                 {
-                    QString input_value = QInputDialog::getText(this, tr("Edit Binary Value"), tr("Value:"), QLineEdit::Normal, QString::number(*(quint16*)&m_register_values[index.row()], 2), &input_ok);
+                    quint16 old_value = m_register_values[index.row()];
+                    QString input_value = QInputDialog::getText(this, tr("Edit Binary Value"), tr("Value:"), QLineEdit::Normal, QString::number(old_value, 2), &input_ok);
                     if(input_ok)
                     {
                         quint16 value = input_value.toUShort(&cvt_ok, 2);
-                        if(cvt_ok)
+                        quint16 changed_bits = value ^ old_value;
+                        if(cvt_ok && changed_bits)
                         {
+                            //only the edited bits are sent, the device combines them with its current value,
+                            //bits changed there since the last poll are left alone
                             data_valid = true;
-                            frame_info.function = ModbusWriteSingleRegister;
+                            frame_info.function = ModbusMaskWriteRegister;
                             frame_info.quantity = 1;
-                            quint16 *reg_val = (quint16*)&frame_info.reg_values[0];
-                            *reg_val = value;
+                            frame_info.reg_values[0] = quint16(~changed_bits);
+                            frame_info.reg_values[1] = value & changed_bits;
                         }
                     }
                     break;
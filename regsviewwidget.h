@@ -4,6 +4,9 @@
 #include <QWidget>
 #include <QStandardItemModel>
 #include <QMap>
+#include "modbuschangedetector.h"
+#include "modbusvaluegenerator.h"
+#include "modbusvaluecodec.h"
 
 struct ModbusRegReadDefinitions;
 
@@ -20,60 +23,37 @@ class RegsViewWidget : public QWidget
     Q_OBJECT
 
 public:
-    enum CellFormat{
-        Format_None = 0,
-        Format_Coil,
-        Format_Signed,
-        Format_Unsigned,
-        Format_Hex,
-        Format_Ascii_Hex,
-        Format_Binary,
-        Format_32_Bit_Signed_Big_Endian = 32,
-        Format_32_Bit_Signed_Little_Endian,
-        Format_32_Bit_Signed_Big_Endian_Byte_Swap,
-        Format_32_Bit_Signed_Little_Endian_Byte_Swap,
-        Format_32_Bit_Unsigned_Big_Endian,
-        Format_32_Bit_Unsigned_Little_Endian,
-        Format_32_Bit_Unsigned_Big_Endian_Byte_Swap,
-        Format_32_Bit_Unsigned_Little_Endian_Byte_Swap,
-        Format_32_Bit_Float_Big_Endian,
-        Format_32_Bit_Float_Little_Endian,
-        Format_32_Bit_Float_Big_Endian_Byte_Swap,
-        Format_32_Bit_Float_Little_Endian_Byte_Swap,
-        Format_64_Bit_Signed_Big_Endian = 64,
-        Format_64_Bit_Signed_Little_Endian,
-        Format_64_Bit_Signed_Big_Endian_Byte_Swap,
-        Format_64_Bit_Signed_Little_Endian_Byte_Swap,
-        Format_64_Bit_Unsigned_Big_Endian,
-        Format_64_Bit_Unsigned_Little_Endian,
-        Format_64_Bit_Unsigned_Big_Endian_Byte_Swap,
-        Format_64_Bit_Unsigned_Little_Endian_Byte_Swap,
-        Format_64_Bit_Float_Big_Endian,
-        Format_64_Bit_Float_Little_Endian,
-        Format_64_Bit_Float_Big_Endian_Byte_Swap,
-        Format_64_Bit_Float_Little_Endian_Byte_Swap,
-    };
+    typedef ModbusValueFormat CellFormat;
 
 public:
     explicit RegsViewWidget(ModbusRegReadDefinitions *reg_defines, QWidget *parent = nullptr);
     ~RegsViewWidget();
     void setRegDef(ModbusRegReadDefinitions *reg_defines);
-    void increaseErrorCount();
-    void increaseSendCount();
+    void increaseCounts(quint32 send_count, quint32 error_count);
     void setErrorInfo(const QString &error_info);
     bool setRegisterValues(const quint16 *reg_values, quint16 reg_addr, quint16 quantity);
     bool getRegisterValues(quint16 *reg_values, quint16 reg_addr, quint16 quantity) const;
     bool setCoilValue(int coil_addr, quint16 value);
     bool getCoilValue(int coil_addr, quint16 *value) const;
+    //the deadbands set on the view, each judged on the value as it is formatted now
+    QList<ModbusDeadband> deadbands() const;
+    //the generators set on a slave view, each writing its value in the format the cell shows now
+    QList<ModbusGenerator> generators() const;
 
 signals:
     void writeFunctionTriggered(const ModbusFrameInfo &frame_info);
+    //offset and width of the one value that was edited, in registers from the start of the block
+    void registerValuesEdited(ModbusRegReadDefinitions *reg_defines, int offset, int width);
+    void deadbandsChanged(ModbusRegReadDefinitions *reg_defines);
+    void generatorsChanged(ModbusRegReadDefinitions *reg_defines);
     void closed(ModbusRegReadDefinitions *reg_defines);
 
 private slots:
     void formatActionTriggered();
     void copyActionTriggered();
     void selectAllActionTriggered();
+    void deadbandActionTriggered();
+    void generatorActionTriggered();
 
     void on_regs_table_view_customContextMenuRequested(const QPoint &pos);
 
@@ -95,6 +75,9 @@ private:
     QList<CellFormat> m_cell_formats;
     QMap<QAction *, CellFormat> m_format_map;
     QMenu *m_popup_menu;
+    //absolute and percent deadband by row
+    QMap<int, QPair<double, double> > m_deadbands;
+    QMap<int, ModbusGenerator> m_generators;
 
     QAction *m_format_signed_action;
     QAction *m_format_unsigned_action;
@@ -128,9 +111,13 @@ private:
 
     QAction *m_copy_action;
     QAction *m_select_all_action;
+    QAction *m_deadband_action;
+    QAction *m_generator_action;
     
 private:
-    void updateRegisterValues();
+    void updateRegisterValues(int first_row = 0, int row_count = -1);
+    void setDeadband(const QList<int> &rows, double absolute, double percent);
+    void setGenerator(const QList<int> &rows, const ModbusGenerator &generator, bool enabled);
 
 };
 
@@ -0,0 +1,43 @@
+#include "schedulersettingdialog.h"
+#include "ui_schedulersettingdialog.h"
+
+SchedulerSettingDialog::SchedulerSettingDialog(const ModbusSchedulerSettings &settings, QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::SchedulerSettingDialog)
+{
+    ui->setupUi(this);
+    QList<QSpinBox*> rate_boxes{ui->box_urgent_rate, ui->box_normal_rate, ui->box_fast_rate, ui->box_slow_rate};
+    QList<QSpinBox*> burst_boxes{ui->box_urgent_burst, ui->box_normal_burst, ui->box_fast_burst, ui->box_slow_burst};
+    for(int i = 0; i < rate_boxes.size() && i < settings.rates.size() && i < settings.bursts.size(); ++i)
+    {
+        rate_boxes[i]->setValue(settings.rates[i]);
+        burst_boxes[i]->setValue(settings.bursts[i]);
+    }
+    ui->box_fast_poll->setValue(settings.fast_poll_ms);
+    ui->box_write_combine->setValue(settings.write_combine_ms);
+    ui->box_broadcast_turnaround->setValue(settings.broadcast_turnaround_ms);
+    ui->box_fuse_read_write->setChecked(settings.fuse_read_write);
+}
+
+SchedulerSettingDialog::~SchedulerSettingDialog()
+{
+    delete ui;
+}
+
+void SchedulerSettingDialog::on_button_ok_clicked()
+{
+    ModbusSchedulerSettings settings;
+    settings.rates = {ui->box_urgent_rate->value(), ui->box_normal_rate->value(), ui->box_fast_rate->value(), ui->box_slow_rate->value()};
+    settings.bursts = {ui->box_urgent_burst->value(), ui->box_normal_burst->value(), ui->box_fast_burst->value(), ui->box_slow_burst->value()};
+    settings.fast_poll_ms = ui->box_fast_poll->value();
+    settings.write_combine_ms = ui->box_write_combine->value();
+    settings.broadcast_turnaround_ms = ui->box_broadcast_turnaround->value();
+    settings.fuse_read_write = ui->box_fuse_read_write->isChecked();
+    emit schedulerSettingsChanged(settings);
+    deleteLater();
+}
+
+void SchedulerSettingDialog::on_button_cancel_clicked()
+{
+    deleteLater();
+}
@@ -0,0 +1,31 @@
+#ifndef SCHEDULERSETTINGDIALOG_H
+#define SCHEDULERSETTINGDIALOG_H
+
+#include <QDialog>
+#include "modbusscheduler.h"
+
+namespace Ui {
+class SchedulerSettingDialog;
+}
+
+class SchedulerSettingDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SchedulerSettingDialog(const ModbusSchedulerSettings &settings, QWidget *parent = nullptr);
+    ~SchedulerSettingDialog();
+
+signals:
+    void schedulerSettingsChanged(const ModbusSchedulerSettings &settings);
+
+private slots:
+    void on_button_ok_clicked();
+
+    void on_button_cancel_clicked();
+
+private:
+    Ui::SchedulerSettingDialog *ui;
+};
+
+#endif // SCHEDULERSETTINGDIALOG_H